@@ -0,0 +1,106 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+
+constexpr unsigned int ADDITIVE_MAX_PARTIALS = 512;
+constexpr unsigned int ADDITIVE_PRESETS = 4;
+
+// Partial k sounds at ratios[k] times the note frequency, with peak amplitude amplitudes[k]
+struct AdditivePatch
+{
+    unsigned int partialCount; // Up to ADDITIVE_MAX_PARTIALS
+    float attackMs;            // Linear rise
+    float releaseMs;           // To fall 60 dB after note off
+    float ratios[ADDITIVE_MAX_PARTIALS];
+    float amplitudes[ADDITIVE_MAX_PARTIALS];
+};
+
+extern const char* const ADDITIVE_PRESET_NAMES[ADDITIVE_PRESETS];
+// At most partialCount partials of the preset's series
+AdditivePatch MakeAdditivePreset(unsigned int index,
+                                 unsigned int partialCount = ADDITIVE_MAX_PARTIALS);
+
+// Additive voices of up to ADDITIVE_MAX_PARTIALS sine partials each. Every partial is a
+// recursive quadrature oscillator, a complex rotation per sample rather than a sin call, and a
+// voice's partials are stored structure-of-arrays so a lane group of them rotates with one SIMD
+// instruction stream. Partials at or above Nyquist are culled when a voice is tuned, so the
+// cost follows the partials that can actually be heard. Amplitudes are read from the patch at
+// control rate, every CONTROL_INTERVAL samples, and ramp linearly in between.
+//
+// Output is frame-major across voices, as SvfBank expects: sample n of voice v lives at
+// n * MAX_VOICES + v.
+class AdditiveBank
+{
+public:
+    static constexpr unsigned int MAX_VOICES = 16;
+    static constexpr unsigned int CONTROL_INTERVAL = 32;
+
+    AdditiveBank();
+    AdditiveBank(const AdditiveBank&) = delete;
+    AdditiveBank& operator=(const AdditiveBank&) = delete;
+
+    // Restarts the voice's partials and attacks; a voice still releasing rises from its
+    // current level
+    void NoteOn(unsigned int voice, double freq);
+    void NoteOff(unsigned int voice);
+    void Silence(); // Every voice, immediately
+    // The patch's ratios or partial count may have changed: every voice is retuned at the next
+    // Render, keeping the phase and level of partials that survive the change
+    void PatchChanged();
+
+    bool IsSounding(unsigned int voice) const
+    {
+        return (m_soundingMask >> voice) & 1;
+    }
+    unsigned int GetSoundingMask() const
+    {
+        return m_soundingMask;
+    }
+    // Partials the voice rendered in the last block, after culling
+    unsigned int GetPartialCount(unsigned int voice) const;
+
+    // Overwrites the lanes of every sounding voice with nFrames of output, scaled by gain, and
+    // returns the mask of voices it wrote
+    unsigned int Render(const AdditivePatch& patch, float* pVoices, unsigned int nFrames,
+                        double sampleRate, float gain);
+
+private:
+    enum class Stage : uint8_t
+    {
+        Idle,
+        Attack,
+        Hold,
+        Release
+    };
+
+    // One voice's partials below Nyquist, packed to the front and padded with silent ones to a
+    // whole number of lane groups
+    struct alignas(32) Oscillators
+    {
+        float cos[ADDITIVE_MAX_PARTIALS];
+        float sin[ADDITIVE_MAX_PARTIALS]; // The output
+        float rotationCos[ADDITIVE_MAX_PARTIALS];
+        float rotationSin[ADDITIVE_MAX_PARTIALS];
+        float amplitude[ADDITIVE_MAX_PARTIALS]; // Patch amplitude times envelope and gain
+        uint16_t partial[ADDITIVE_MAX_PARTIALS]; // Index into the patch
+        unsigned int count;                      // Partials in use
+        unsigned int paddedCount;
+        bool stale;   // Retune before rendering
+        bool restart; // Retune from silence, at phase zero
+    };
+
+    // On the heap: 16 voices of oscillators are too big for an AudioManager on the stack
+    std::unique_ptr<Oscillators[]> m_oscillators;
+    double m_freq[MAX_VOICES] = {};
+    float m_envelope[MAX_VOICES] = {};
+    Stage m_stage[MAX_VOICES] = {};
+    unsigned int m_soundingMask = 0;
+    double m_sampleRate = 0.0; // Of the last Render; a change retunes every voice
+
+    void Tune(unsigned int voice, const AdditivePatch& patch, double sampleRate);
+    bool AdvanceEnvelope(unsigned int voice, const AdditivePatch& patch, double sampleRate,
+                         unsigned int nSamples);
+    void RenderVoice(unsigned int voice, const AdditivePatch& patch, float* pOut,
+                     unsigned int nFrames, double sampleRate, float gain);
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "FFT.h"
+
+#include <cstddef>
+#include <vector>
+
+// Reduces `count` samples to `columns` (min, max) pairs so a waveform of any length draws as
+// one vertical line per pixel column without losing peaks.
+void DecimateMinMax(const float* pIn, size_t count, unsigned int columns, float* pMin,
+                    float* pMax);
+
+// GUI-thread spectrum analyzer. Each Update runs a Hann-windowed FFT over the newest samples
+// and folds the bins into log-spaced columns with a peak-hold style fall-off.
+class SpectrumAnalyzer
+{
+public:
+    static constexpr float MIN_DB = -96.0f;
+
+    void Prepare(unsigned int fftSize, double sampleRate, unsigned int columns);
+    unsigned int GetSize() const
+    {
+        return m_fft.GetSize();
+    }
+
+    // GetSize() mono samples; `elapsedSeconds` since the last update sets the fall-off
+    void Update(const float* pIn, float elapsedSeconds);
+
+    const float* GetColumnsDb() const // dBFS per column, from MIN_FREQ to Nyquist
+    {
+        return m_columnsDb.data();
+    }
+    unsigned int GetColumnCount() const
+    {
+        return (unsigned int)m_columnsDb.size();
+    }
+    float GetColumnFrequency(unsigned int column) const;
+    bool IsSettled() const; // Every column has fallen to MIN_DB
+
+private:
+    static constexpr float MIN_FREQ = 20.0f;
+    static constexpr float FALL_DB_PER_SECOND = 60.0f;
+
+    FFT m_fft;
+    double m_sampleRate = 0.0;
+    std::vector<float> m_window;
+    std::vector<float> m_windowed;
+    std::vector<float> m_re;
+    std::vector<float> m_im;
+    std::vector<float> m_binDb;
+    std::vector<float> m_columnsDb;
+};
@@ -1,10 +1,22 @@
 #pragma once
 
+#include "AdditiveBank.h"
+#include "Analyzer.h"
+#include "EffectsChain.h"
+#include "FmBank.h"
+#include "PresetBank.h"
+#include "SpectralBank.h"
+
 #include <Windows.h>
+#include <chrono>
+#include <cstdint>
 #include <memory>
+#include <string>
+#include <vector>
 class GuiManager;
 class D3DManager;
 class AudioManager;
+class KeyboardInput;
 
 class App
 {
@@ -25,9 +37,79 @@ private:
     std::unique_ptr<D3DManager> m_d3dManager;
     std::unique_ptr<GuiManager> m_guiManager;
     std::unique_ptr<AudioManager> m_audioManager;
+    std::unique_ptr<KeyboardInput> m_keyboardInput; // Null when keys come from WndProc
+
+    int m_oversampling = 1;
+    float m_drive = 0.0f;
+    int m_filterMode = 0;
+    float m_filterCutoff = 2000.0f;
+    float m_filterResonance = 0.0f;
+    EffectsSettings m_effects;
+    int m_masterGraph = 0;
+    char m_irPath[260] = {};
+    bool m_irLoadFailed = false;
+    char m_samplePath[260] = {};
+    std::string m_sampleStatus;
+    int m_samplerInterpolation = 0;
+    float m_streamDiskDelayMs = 0.0f;
+    int m_fmPreset = 0;
+    FmPatch m_fmPatch = MakeFmPreset(0); // The engine starts on the same preset
+    int m_additivePreset = 0;
+    int m_additivePartials = ADDITIVE_MAX_PARTIALS;
+    AdditivePatch m_additivePatch = MakeAdditivePreset(0); // As is this one
+    int m_spectralPreset = 0;
+    int m_spectralPartials = SPECTRAL_MAX_PARTIALS;
+    SpectralPatch m_spectralPatch = MakeSpectralPreset(0); // And this one
+
+    PresetBank m_presets;
+    int m_preset = -1; // Last patch applied from m_presets
+    char m_presetTextPath[260] = "presets.txt";
+    std::string m_presetStatus;
+
+    char m_recordPath[260] = "recording.wav";
+    std::string m_recordStatus;
+    char m_historyPath[260] = "history.wav";
+    std::string m_historyStatus;
+    bool m_historySaving = false;
+    std::string m_traceStatus; // Trace builds only
+
+    SpectrumAnalyzer m_analyzer;
+    std::vector<float> m_scopeLeft;
+    std::vector<float> m_scopeRight;
+    std::vector<float> m_scopeMono;
+    std::vector<float> m_scopeMin;
+    std::vector<float> m_scopeMax;
+    bool m_scopeSettled = false; // Last analysed trace and spectrum were silent and fully decayed
+
+    // Frame pacing: the loop sleeps in MsgWaitForMultipleObjects unless something is dirty
+    bool m_idleWhenQuiet = true;
+    int m_maxFps = 60;
+    int m_uiFramesPending = 0; // Frames still to draw after the last window message
+    std::chrono::steady_clock::time_point m_cpuSampleStart;
+    uint64_t m_cpuSampleThreadTime = 0; // GUI thread user + kernel time, 100 ns units
+    unsigned int m_framesSinceSample = 0;
+    double m_guiCpuLoad = 0.0; // Fraction of one core used by the GUI thread
+    // The last whole sample's load with the idle mode off and on; negative until measured
+    double m_guiCpuLoadByMode[2] = {-1.0, -1.0};
+    bool m_cpuSampleMixed = false; // The idle mode was toggled during the current sample
+    double m_guiFps = 0.0;
 
     bool CreateAppWindow();
     void CleanupAppWindow();
+    void DrawControlPanel();
+    void DrawPresets();
+    void SelectPreset(int index);
+    bool RewriteBank(const std::vector<PresetPatch>& patches);
+    void DrawFmPatch();
+    void DrawAdditivePatch();
+    void DrawSpectralPatch();
+    void DrawRecorder();
+    void SyncControls();
+    void UpdateAnalyzer();
+    void DrawAnalyzer();
+    void DrawLatency();
+    bool HasScopeActivity() const;
+    void UpdateGuiCpuUsage();
 };
 
 // Global instance pointer for window procedure callback
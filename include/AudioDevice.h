@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// What the engine asks of its open output device, so that AudioManager.h builds without the
+// platform's audio API. NoiseMaker implements it over waveOut on Windows; elsewhere there is no
+// device and the engine only renders offline.
+class AudioDevice
+{
+public:
+    virtual ~AudioDevice() = default;
+
+    virtual unsigned int GetSampleRate() const = 0;
+    virtual unsigned int GetChannels() const = 0;
+    // Frames the device has played since the stream started, unwrapped against `nNearFrame`,
+    // any frame position within 2^31 of the true one
+    virtual bool GetPlayedFrames(uint64_t nNearFrame, uint64_t& nPlayed) = 0;
+    // Times the device ran dry: every queued block had played before the next was ready
+    virtual uint64_t GetUnderruns() const = 0;
+};
@@ -1,22 +1,68 @@
 #pragma once
 
-#include "noiseMaker.h"
+#include "AdditiveBank.h"
+#include "AudioDevice.h"
+#include "CaptureHistory.h"
+#include "ConvolutionReverb.h"
+#include "DspGraph.h"
+#include "EffectsChain.h"
+#include "FmBank.h"
+#include "LatencyTracer.h"
+#include "MetricsSegment.h"
+#include "Oversampler.h"
+#include "ParameterStore.h"
+#include "RenderExchange.h"
+#include "Resampler.h"
+#include "RenderStats.h"
+#include "Sampler.h"
+#include "ScopeRing.h"
+#include "ScratchArena.h"
+#include "SpectralBank.h"
+#include "SpscQueue.h"
+#include "SvfBank.h"
+#include "WavFile.h"
+#include "WavRecorder.h"
 
 #include <atomic>
+#include <cstdint>
+#include <filesystem>
 #include <functional>
 #include <memory>
-#include <mutex>
 #include <string>
-#include <unordered_map>
 #include <vector>
 
+struct PresetPatch;
+
 class AudioManager
 {
 public:
+    // A Win32 virtual-key code, as WM_KEYDOWN carries in its WPARAM
+    using KeyCode = uintptr_t;
+
     enum class WaveType
     {
         Sine,
-        Square
+        Square,
+        Sampler,  // Plays the loaded sample instrument; silent until one is loaded
+        Fm,       // Phase-modulation operators, set by SetFmPatch
+        Additive, // Sine partials, set by SetAdditivePatch
+        Spectral  // Thousands of sine partials by inverse FFT, set by SetSpectralPatch
+    };
+
+    enum class FilterMode
+    {
+        Off,
+        Lowpass,
+        Bandpass,
+        Highpass
+    };
+
+    // A key press or release in an offline note script
+    struct NoteEvent
+    {
+        double time; // Seconds from the start of the render
+        KeyCode key;
+        bool down;
     };
 
     AudioManager();
@@ -25,20 +71,205 @@ public:
     bool Initialize();
     void Shutdown();
 
-    void HandleKeyDown(WPARAM wParam);
-    void HandleKeyUp(WPARAM wParam);
+    // Prepares the engine without an output device, for RenderOffline. Given the same script
+    // and settings, the output is identical from run to run. A loaded impulse response is the
+    // one exception, because its tail is convolved on a free-running thread; streamed samples
+    // are waited for instead.
+    bool InitializeOffline(unsigned int blockSamples = 512);
+    void RenderOffline(const std::vector<NoteEvent>& script, double seconds, WavData& out);
+
+    // Queue a key for the render thread, stamped with LatencyTracer::Now() at the moment the
+    // input arrived; 0 stamps it on entry. One producer thread only: KeyboardInput's thread,
+    // or the GUI thread when Raw Input is unavailable.
+    void HandleKeyDown(KeyCode key, int64_t timestampNs = 0);
+    void HandleKeyUp(KeyCode key, int64_t timestampNs = 0);
+    // The setters below only write the parameter store and never block the render thread
+    void SetParameter(ParamId id, float value);
     void SetWaveType(WaveType type);
-    double MakeSineNoise(double dTime);
-    double MakeSquareNoise(double dTime);
+    void SetSamplerInterpolation(SamplerInterpolation interpolation);
+    // Operator settings are too many for the parameter store, so the patch is handed to the
+    // render thread whole and adopted at the next block boundary. Not saved in preset banks.
+    void SetFmPatch(const FmPatch& patch);
+    void SetAdditivePatch(const AdditivePatch& patch); // Handed over the same way
+    void SetSpectralPatch(const SpectralPatch& patch); // And again
+    void SetStereoSpread(float spread);
+    void SetOversampling(unsigned int factor); // 1, 2, 4 or 8
+    void SetDrive(float drive);                // 0 bypasses the saturator
+    void SetFilter(FilterMode mode, float cutoffHz, float resonance);
+    void SetEffects(const EffectsSettings& settings);
+    // Every parameter at once; the render thread picks the patch up whole at one block boundary
+    void ApplyPatch(const PresetPatch& patch);
+    bool SetMasterGraph(const DspGraph& graph, std::string* error = nullptr);
+    bool LoadImpulseResponse(const std::filesystem::path& path);
+    // Maps a directory of multisampled WAVs and hands it to the render thread; voices still
+    // playing the previous instrument go silent. GUI thread.
+    bool LoadSampleInstrument(const std::filesystem::path& directory,
+                              std::string* error = nullptr);
+    // Sleeps the sample streamer before each chunk it reads, to test behaviour on a slow disk
+    void SetStreamDiskDelay(double ms);
+    // Records what the device plays, at its rate and in its format, until StopRecording.
+    // Needs an open device. GUI thread.
+    bool StartRecording(const std::filesystem::path& path, std::string* error = nullptr);
+    bool StopRecording(std::string* error = nullptr);
+    // Writes the last two minutes of device output to a WAV file in the background
+    bool SaveCaptureHistory(const std::filesystem::path& path, std::string* error = nullptr);
+    void RenderBlock(float* const* ppChannels, unsigned int nChannels, unsigned int nFrames,
+                     double dTime);
+
+    const ParameterStore& GetParameters() const
+    {
+        return m_params;
+    }
+    const RenderStats& GetRenderStats() const
+    {
+        return m_renderStats;
+    }
+    const ScopeRing& GetScope() const
+    {
+        return m_scope;
+    }
+    const WavRecorder& GetRecorder() const
+    {
+        return m_recorder;
+    }
+    const CaptureHistory* GetCaptureHistory() const // Null without a device
+    {
+        return m_captureHistory.get();
+    }
+    const LatencyTracer& GetLatencyTracer() const
+    {
+        return m_latency;
+    }
+    void ResetLatencyTrace() // May drop a sample recorded at the same moment
+    {
+        m_latency.Reset();
+    }
+    unsigned int GetDroppedKeyEvents() const
+    {
+        return m_droppedKeyEvents.load(std::memory_order_relaxed);
+    }
+    double GetSampleRate() const;
+    // Rate the output device was opened at; blocks are resampled to it when it isn't
+    // GetSampleRate()
+    unsigned int GetDeviceSampleRate() const;
+    size_t GetScratchCapacity() const;
+    size_t GetScratchHighWater() const;
+    double GetDspLoad() const;
+    double GetConvolutionTailMs() const;
+    unsigned int GetConvolutionTailMisses() const;
+    size_t GetSampleZoneCount() const // GUI thread, like LoadSampleInstrument
+    {
+        return m_sampleZones;
+    }
+    size_t GetSampleBytes() const
+    {
+        return m_sampleBytes;
+    }
+    size_t GetStreamedZoneCount() const
+    {
+        return m_streamedZones;
+    }
+    // Statistics for streamed samples; null unless the last instrument loaded streams
+    SampleStreamer* GetSampleStreamer() const
+    {
+        return m_sampleStreamer;
+    }
 
 private:
-    std::unique_ptr<NoiseMaker<int>> m_sound;
-    std::unordered_map<WPARAM, double> m_activeNotes;
-    mutable std::mutex m_notesMutex; // Protects m_activeNotes
-    WaveType m_currentWaveType = WaveType::Sine;
-    static double StaticNoiseCallback(double dTime);
+    static constexpr unsigned int MAX_VOICES = SvfBank::MAX_VOICES;
+    static_assert(FmBank::MAX_VOICES == MAX_VOICES, "FM voices share the SvfBank lanes");
+    static_assert(AdditiveBank::MAX_VOICES == MAX_VOICES, "So do additive voices");
+    static_assert(SpectralBank::MAX_VOICES == MAX_VOICES, "And spectral voices");
+
+    struct Voice
+    {
+        KeyCode key;
+        double freq;
+        float pan; // -1 hard left, 0 centre, 1 hard right
+        bool active;
+        SamplerVoice sampler; // Zone picked at note on, when an instrument is loaded
+    };
+
+    std::unique_ptr<AudioDevice> m_sound; // NoiseMaker, on Windows
+    struct KeyEvent
+    {
+        KeyCode key;
+        bool down;
+        int64_t timestampNs;
+    };
+
+    Voice m_voices[MAX_VOICES] = {}; // Render thread only
+    SpscQueue<KeyEvent, 256> m_keyEvents;
+    std::atomic<unsigned int> m_droppedKeyEvents{0};
+    LatencyTracer m_latency;
+    ParameterStore m_params;
+    ParameterSnapshot m_blockParams;   // Render thread only, refreshed once per block
+    EffectsSettings m_effectsSettings; // Render thread only, built from m_blockParams
+    EffectsChain m_effectsChain;       // Render thread only; its tails outlive graph swaps
+    double m_timeStep = 0.0;
+    double m_blockDurationMs = 0.0;
+    ScratchArena* m_scratch = nullptr; // Owned by m_sound, or m_offlineScratch offline
+    ScratchArena m_offlineScratch;
+    unsigned int m_blockSamples = 0;
+    std::vector<Oversampler> m_oversamplers; // One per output channel
+    SvfBank m_filterBank;
+    FmBank m_fmBank; // Render thread only; notes keep sounding there through their release
+    WaveType m_blockWaveType = WaveType::Sine; // Of the last block, render thread only
+    RenderExchange<FmPatch> m_fmPatches;
+    const FmPatch* m_fmPatch = nullptr; // Render thread's current patch
+    AdditiveBank m_additiveBank;        // Render thread only, like m_fmBank
+    RenderExchange<AdditivePatch> m_additivePatches;
+    const AdditivePatch* m_additivePatch = nullptr;
+    SpectralBank m_spectralBank; // Render thread only, like m_fmBank
+    RenderExchange<SpectralPatch> m_spectralPatches;
+    const SpectralPatch* m_spectralPatch = nullptr;
+    GraphExchange m_masterGraph; // Master bus, compiled off the audio thread
+    RenderExchange<ConvolutionReverb> m_convolutions;
+    // The current engine's tail statistics, mirrored by the render thread for the GUI
+    std::atomic<double> m_convolutionTailMs{0.0};
+    std::atomic<unsigned int> m_convolutionTailMisses{0};
+    RenderExchange<SampleInstrument> m_instruments;
+    const SampleInstrument* m_instrument = nullptr; // Render thread's current instrument
+    size_t m_sampleZones = 0; // Of the last instrument loaded, for the GUI
+    size_t m_sampleBytes = 0;
+    size_t m_streamedZones = 0;
+    SampleStreamer* m_sampleStreamer = nullptr; // Owned by that instrument
+    double m_streamDiskDelayMs = 0.0;
+    // Device rate conversion, render thread only once the device has started
+    bool m_deviceResampling = false;
+    Resampler m_deviceResampler;
+    std::vector<float> m_deviceInputMemory;
+    std::vector<float*> m_deviceInput; // One block at SAMPLE_RATE per channel
+    double m_renderTime = 0.0;         // Of the next block rendered for the resampler
+    RenderStats m_renderStats;
+    ScopeRing m_scope;
+    WavRecorder m_recorder;
+    std::unique_ptr<CaptureHistory> m_captureHistory; // Written from the device's output tap
+    MetricsSegment m_metrics;                         // Published once per device block
+    EngineMetrics m_publishedMetrics = {};            // Render thread only
+    unsigned int m_keyQueueDepth = 0;                 // At the start of the newest block
+    bool PrepareEngine(unsigned int blockSamples, unsigned int channels, ScratchArena* pScratch);
+    static size_t GetScratchBytes(unsigned int blockSamples, unsigned int channels);
+    void RenderDeviceBlock(float* const* ppChannels, unsigned int nChannels, unsigned int nFrames,
+                           double dTime);
+    void PublishMetrics(unsigned int nFrames, double blockMs);
+    static void StaticBlockCallback(float* const* ppChannels, unsigned int nChannels,
+                                    unsigned int nFrames, double dTime);
+    static void StaticOutputCallback(const int32_t* pFrames, unsigned int nChannels,
+                                     unsigned int nFrames);
+    void ProcessKeyEvents(double dTime);
+    bool ApplyKeyEvent(const KeyEvent& event); // True if the event changed a voice
+    void StopSampler(SamplerVoice& sampler);   // Frees its stream slot, if it has one
+    void SilenceWaveBank(WaveType waveType);   // Of the wave types that render from a bank
+    void ProcessMasterBus(float* const* ppChannels, unsigned int nFrames);
+    void UpdateEffectsSettings();
+    void RenderVoices(float* const* ppChannels, unsigned int nChannels, unsigned int nFrames,
+                      double dTime, double timeStep);
+    void RenderVoice(Voice& voice, float* pOut, unsigned int stride, unsigned int nFrames,
+                     double dTime, double timeStep, float* pDecode);
+    void ApplyDrive(float* const* ppChannels, unsigned int nChannels, unsigned int nFrames) const;
     double SineSoundMaker(double freq, double dTime) const;
     double SquareSoundMaker(double freq, double dTime) const;
-    void MapNoteFrequency(WPARAM wParam);
+    double MapNoteFrequency(KeyCode key) const;
     static AudioManager* s_instance;
 };
\ No newline at end of file
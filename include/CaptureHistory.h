@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Always-on history of the last few minutes of device output, so a rare glitch can be saved
+// after it happened instead of recording to disk all the time. The render thread copies each
+// block into a fixed ring; a save snapshots the newest frames on a background thread, checks
+// as ScopeRing does that the writer didn't lap them, and writes them to WAV from there.
+class CaptureHistory
+{
+public:
+    enum class Format
+    {
+        Int16, // Top 16 bits of each device sample, half the memory
+        Int32  // The device format itself, one memcpy per block
+    };
+
+    // Holds `seconds` of interleaved frames at the device's rate and channel count, plus a
+    // second of slack that a save never reads. Allocates and zeroes the ring up front.
+    CaptureHistory(double seconds, unsigned int sampleRate, unsigned int channels,
+                   Format format);
+    ~CaptureHistory(); // Waits for a save in progress
+    CaptureHistory(const CaptureHistory&) = delete;
+    CaptureHistory& operator=(const CaptureHistory&) = delete;
+
+    // Render thread. Blocks with a different channel count are ignored.
+    void Write(const int32_t* pFrames, unsigned int nChannels, unsigned int nFrames);
+
+    // GUI thread. Starts writing the history to a WAV file on a background thread; false if
+    // the previous save is still running.
+    bool SaveAsync(const std::filesystem::path& path, std::string* error = nullptr);
+    bool IsSaving() const
+    {
+        return m_saving.load(std::memory_order_acquire);
+    }
+    // Of the last save once IsSaving is false: empty on success, or what went wrong
+    const std::string& GetSaveError() const
+    {
+        return m_saveError;
+    }
+    double GetSavedSeconds() const
+    {
+        return m_savedSeconds;
+    }
+
+    double GetFilledSeconds() const; // Up to GetCapacitySeconds once the ring has wrapped
+    double GetCapacitySeconds() const
+    {
+        return (double)m_historyFrames / m_sampleRate;
+    }
+    size_t GetBytes() const
+    {
+        return m_capacityFrames * m_frameBytes;
+    }
+
+private:
+    void CopyIn(const int32_t* pIn, size_t frame, size_t frames);
+    void Save(std::filesystem::path path);
+
+    const unsigned int m_sampleRate;
+    const unsigned int m_channels;
+    const Format m_format;
+    const size_t m_frameBytes;
+    const size_t m_historyFrames;  // The most a save writes
+    const size_t m_capacityFrames; // Plus the slack
+    std::unique_ptr<unsigned char[]> m_ring;
+    std::atomic<uint64_t> m_written{0}; // Frames since the device started
+
+    std::thread m_saveThread;
+    std::atomic<bool> m_saving{false};
+    std::string m_saveError; // Save thread while saving, GUI thread otherwise
+    double m_savedSeconds = 0.0;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "FFT.h"
+#include "WavFile.h"
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Uniformly partitioned overlap-save convolver with a frequency-domain delay line. Each call
+// consumes one partition of input and produces one partition per IR channel with no latency.
+class PartitionedConvolver
+{
+public:
+    void Prepare(const float* const* ppIr, unsigned int nChannels, size_t length,
+                 unsigned int partitionSize);
+    void Process(const float* pIn, float* const* ppOut);
+
+private:
+    unsigned int m_partitionSize = 0;
+    unsigned int m_binCount = 0;
+    unsigned int m_partitionCount = 0;
+    unsigned int m_channels = 0;
+    unsigned int m_fdlIndex = 0;
+    FFT m_fft;
+    std::vector<float> m_irRe; // [channel][partition][bin]
+    std::vector<float> m_irIm;
+    std::vector<float> m_fdlRe; // [partition][bin], newest input spectrum at m_fdlIndex
+    std::vector<float> m_fdlIm;
+    std::vector<float> m_frame; // Previous and current input partition back to back
+    std::vector<float> m_accRe;
+    std::vector<float> m_accIm;
+    std::vector<float> m_time;
+};
+
+// Convolution reverb for impulse responses several seconds long. The render thread convolves
+// the head of the IR in small partitions matching the device block, so its cost per block is
+// fixed whatever the IR length. A background thread convolves the tail in partitions
+// TAIL_FACTOR times larger; the head is two tail partitions long, which gives the thread a
+// whole tail partition of time to deliver each result before it is due.
+class ConvolutionReverb
+{
+public:
+    static constexpr unsigned int TAIL_FACTOR = 8;
+
+    ConvolutionReverb() = default;
+    ~ConvolutionReverb();
+    ConvolutionReverb(const ConvolutionReverb&) = delete;
+    ConvolutionReverb& operator=(const ConvolutionReverb&) = delete;
+
+    // Allocates everything and starts the tail thread; call off the audio thread
+    bool Prepare(const WavData& ir, double sampleRate, unsigned int blockSize);
+
+    // nFrames must equal the prepared block size; the wet signal is added at `mix`
+    void Process(float* pLeft, float* pRight, unsigned int nFrames, float mix);
+
+    size_t GetLength() const
+    {
+        return m_length;
+    }
+    double GetTailAverageMs() const
+    {
+        return m_tailAverageMs.load(std::memory_order_relaxed);
+    }
+    unsigned int GetTailMisses() const
+    {
+        return m_tailMisses.load(std::memory_order_relaxed);
+    }
+
+private:
+    unsigned int m_blockSize = 0;
+    unsigned int m_tailPartition = 0;
+    unsigned int m_headLength = 0;
+    unsigned int m_channels = 0;
+    size_t m_length = 0;
+
+    PartitionedConvolver m_head;
+    std::vector<float> m_input;
+    std::vector<float> m_headOut[2];
+
+    // Tail hand-off: the render thread writes input and reads output by absolute position
+    PartitionedConvolver m_tail;
+    bool m_hasTail = false;
+    unsigned int m_ringMask = 0;
+    std::vector<float> m_tailInputRing;
+    std::vector<float> m_tailOutputRing[2];
+    std::vector<float> m_tailChunkIn;
+    std::vector<float> m_tailChunkOut[2];
+    uint64_t m_renderPosition = 0;
+    std::atomic<uint64_t> m_inputWritten{0};
+    std::atomic<uint64_t> m_tailReadyEnd{0};
+    std::atomic<uint32_t> m_wake{0};
+    std::atomic<bool> m_running{false};
+    std::atomic<double> m_tailAverageMs{0.0};
+    std::atomic<unsigned int> m_tailMisses{0};
+    std::thread m_tailThread;
+
+    void TailLoop();
+};
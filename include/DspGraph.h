@@ -0,0 +1,124 @@
+#pragma once
+
+#include "EffectsChain.h"
+#include "RenderExchange.h"
+
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct GraphContext
+{
+    const float* voiceLeft;  // Summed voices, read by VoiceBus nodes
+    const float* voiceRight;
+    float* outputLeft;       // Written by the Output node; may alias the voice buffers
+    float* outputRight;
+    unsigned int nFrames;
+    bool gate;               // True while any voice is sounding
+    const EffectsSettings* effects;
+    EffectsChain* effectsChain; // Run by Effects nodes; owned outside so graph swaps keep tails
+};
+
+// Editable description of a signal path. Nodes are referred to by the index AddNode returns;
+// unconnected inputs read silence. Built and compiled off the audio thread.
+class DspGraph
+{
+public:
+    enum class NodeType
+    {
+        VoiceBus,   // 0 in, 2 out: the summed voices (L, R)
+        Oscillator, // 0 in, 1 out: params wave (0 sine, 1 square, 2 saw), Hz, amplitude, offset
+        Envelope,   // 0 in, 1 out: params attack ms, release ms; follows the voice gate
+        Filter,     // 2 in (signal, cutoff mod), 1 out: params mode, Hz, resonance, mod octaves
+        Mixer,      // 4 in, 1 out: params one gain per input
+        Multiply,   // 2 in, 1 out
+        Effects,    // 2 in, 2 out: the master delay and reverb, GraphContext::effectsChain
+        Output      // 2 in (L, R), 0 out; exactly one per graph
+    };
+
+    static constexpr unsigned int MAX_INPUTS = 4;
+    static constexpr unsigned int MAX_OUTPUTS = 2;
+    static constexpr unsigned int MAX_PARAMS = 4;
+
+    struct PortRef
+    {
+        int node = -1;
+        unsigned int port = 0;
+    };
+
+    struct Node
+    {
+        NodeType type;
+        float params[MAX_PARAMS] = {};
+        PortRef inputs[MAX_INPUTS];
+    };
+
+    int AddNode(NodeType type, std::initializer_list<float> params = {});
+    bool Connect(int fromNode, unsigned int fromPort, int toNode, unsigned int toPort);
+
+    const std::vector<Node>& GetNodes() const
+    {
+        return m_nodes;
+    }
+
+    static unsigned int GetInputCount(NodeType type);
+    static unsigned int GetOutputCount(NodeType type);
+
+private:
+    std::vector<Node> m_nodes;
+};
+
+// Built-in master bus graphs
+DspGraph MakeDirectGraph();         // Voices -> effects -> output
+DspGraph MakeEnvelopeFilterGraph(); // Gate envelope sweeps a lowpass before the effects
+DspGraph MakeTremoloGraph();        // Sine LFO amplitude modulation before the effects
+
+class DspNode
+{
+public:
+    virtual ~DspNode() = default;
+    virtual void Process(const GraphContext& context, const float* const* ppInputs,
+                         float* const* ppOutputs) = 0;
+};
+
+// A graph flattened into execution order. Every intermediate signal lives in one slot of a
+// contiguous scratch arena; slots are handed out by liveness, so a signal's slot is reused as
+// soon as its last reader has run.
+class CompiledGraph
+{
+public:
+    void Process(const GraphContext& context);
+
+    unsigned int GetSlotCount() const
+    {
+        return m_slotCount;
+    }
+    size_t GetArenaBytes() const
+    {
+        return m_arena.size() * sizeof(float);
+    }
+
+private:
+    friend std::unique_ptr<CompiledGraph> CompileGraph(const DspGraph& graph, double sampleRate,
+                                                       unsigned int maxFrames, std::string* error);
+
+    struct Step
+    {
+        std::unique_ptr<DspNode> node;
+        const float* inputs[DspGraph::MAX_INPUTS] = {};
+        float* outputs[DspGraph::MAX_OUTPUTS] = {};
+    };
+
+    std::vector<Step> m_steps;
+    std::vector<float> m_arena;
+    unsigned int m_slotCount = 0;
+};
+
+// Orders the nodes topologically and assigns arena slots. Returns nullptr and fills `error`
+// if the graph has a cycle or no single Output node. Allocates; never call on the audio thread.
+std::unique_ptr<CompiledGraph> CompileGraph(const DspGraph& graph, double sampleRate,
+                                            unsigned int maxFrames, std::string* error = nullptr);
+
+// Compiled graphs are published by the GUI and adopted by the audio thread once per block
+using GraphExchange = RenderExchange<CompiledGraph>;
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <vector>
+
+// Ring buffer delay line. Capacity is rounded up to a power of two so wrapping is a mask.
+class DelayLine
+{
+public:
+    void Prepare(unsigned int maxDelaySamples);
+    void Clear();
+
+    // Sample written `delay` writes ago; 1 is the most recent
+    float Read(unsigned int delay) const
+    {
+        return m_buffer[(m_write - delay) & m_mask];
+    }
+    float ReadFractional(float delay) const;
+    void Write(float sample)
+    {
+        m_buffer[m_write] = sample;
+        m_write = (m_write + 1) & m_mask;
+    }
+
+private:
+    std::vector<float> m_buffer;
+    unsigned int m_mask = 0;
+    unsigned int m_write = 0;
+};
+
+// Plain-data master bus settings, copied into the chain once per block
+struct EffectsSettings
+{
+    bool delayEnabled = false;
+    bool delaySync = false;    // Use tempo and delayBeats instead of delayMs
+    float delayMs = 350.0f;
+    float delayBeats = 0.75f;  // Dotted eighth
+    float tempoBpm = 120.0f;
+    float delayFeedback = 0.35f;
+    float delayPingPong = 0.0f; // 0 keeps each channel's echoes on its own side
+    float delayMix = 0.3f;
+
+    bool reverbEnabled = false;
+    float reverbSize = 0.5f;    // 0..1, scales the FDN line lengths
+    float reverbDecay = 2.0f;   // RT60 in seconds
+    float reverbDamping = 0.4f; // 0..1, high-frequency loss per pass
+    float reverbMix = 0.25f;
+
+    bool convolutionEnabled = false; // Needs an impulse response loaded into AudioManager
+    float convolutionMix = 0.3f;
+};
+
+class StereoDelay
+{
+public:
+    static constexpr float MAX_DELAY_SECONDS = 2.0f;
+
+    void Prepare(double sampleRate);
+    void Clear();
+    void Process(float* pLeft, float* pRight, unsigned int nFrames,
+                 const EffectsSettings& settings);
+
+private:
+    double m_sampleRate = 44100.0;
+    DelayLine m_lines[2];
+    float m_currentDelay = 0.0f; // Smoothed towards the target so time changes glide
+};
+
+// Eight-line feedback delay network with a Householder feedback matrix and one-pole damping
+// inside the loop. Even lines feed the left output, odd lines the right.
+class FdnReverb
+{
+public:
+    static constexpr unsigned int LINE_COUNT = 8;
+
+    void Prepare(double sampleRate);
+    void Clear();
+    void Process(float* pLeft, float* pRight, unsigned int nFrames,
+                 const EffectsSettings& settings);
+
+private:
+    double m_sampleRate = 44100.0;
+    DelayLine m_lines[LINE_COUNT];
+    unsigned int m_lengths[LINE_COUNT] = {};
+    float m_gains[LINE_COUNT] = {};
+    float m_damping[LINE_COUNT] = {};
+    float m_dampCoeff = 0.0f;
+    float m_size = -1.0f;
+    float m_decay = -1.0f;
+    float m_dampingSetting = -1.0f;
+
+    void UpdateCoefficients(const EffectsSettings& settings);
+};
+
+// Master bus stage run after the voices are summed. Prepare allocates every delay line; after
+// that Process neither allocates nor locks.
+class EffectsChain
+{
+public:
+    void Prepare(double sampleRate);
+    void Process(float* pLeft, float* pRight, unsigned int nFrames,
+                 const EffectsSettings& settings);
+
+private:
+    StereoDelay m_delay;
+    FdnReverb m_reverb;
+    bool m_delayWasEnabled = false;
+    bool m_reverbWasEnabled = false;
+};
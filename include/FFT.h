@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+// Real-input radix-2 FFT. A size-N real transform runs as an N/2 complex transform on the
+// even/odd samples packed as real/imaginary parts, then is split into N/2 + 1 bins.
+// Spectra are stored as separate real and imaginary arrays so multiply-accumulate loops over
+// bins vectorise. Each instance owns its work buffers and is not reentrant.
+class FFT
+{
+public:
+    void Prepare(unsigned int size); // Power of two, at least 4
+    unsigned int GetSize() const
+    {
+        return m_size;
+    }
+    unsigned int GetBinCount() const
+    {
+        return m_half + 1;
+    }
+
+    // m_size real samples -> GetBinCount() bins
+    void Forward(const float* pIn, float* pRe, float* pIm);
+    // GetBinCount() bins -> m_size real samples; Inverse(Forward(x)) == x
+    void Inverse(const float* pRe, const float* pIm, float* pOut);
+
+private:
+    unsigned int m_size = 0;
+    unsigned int m_half = 0;
+    std::vector<float> m_twiddleRe; // e^(-2 pi i k / half), k < half / 2
+    std::vector<float> m_twiddleIm;
+    std::vector<float> m_splitRe; // e^(-2 pi i k / size), k <= half
+    std::vector<float> m_splitIm;
+    std::vector<unsigned int> m_bitReverse;
+    std::vector<float> m_workRe;
+    std::vector<float> m_workIm;
+
+    void Transform(float* pRe, float* pIm, bool inverse);
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include "Simd.h"
+
+#include <cstdint>
+
+constexpr unsigned int FM_OPERATORS = 6;
+constexpr unsigned int FM_ALGORITHMS = 8;
+constexpr unsigned int FM_PRESETS = 3;
+
+// Operators are numbered from 0. An operator is only ever modulated by higher-numbered ones,
+// so one pass from the top of the stack down renders a sample.
+struct FmOperator
+{
+    float ratio;     // Of the note frequency
+    float level;     // 0 to 1: output level of a carrier, modulation depth of a modulator
+    float feedback;  // 0 to 1, phase modulation by the operator's own output
+    float attackMs;  // Linear rise to full level
+    float decayMs;   // To fall 60 dB, heading for the sustain level
+    float sustain;   // 0 to 1
+    float releaseMs; // To fall 60 dB after note off
+};
+
+struct FmPatch
+{
+    unsigned int algorithm; // Below FM_ALGORITHMS
+    FmOperator operators[FM_OPERATORS];
+};
+
+// "6>5>4>3>2>1" style routing, with operators numbered from 1 as the GUI shows them
+extern const char* const FM_ALGORITHM_NAMES[FM_ALGORITHMS];
+extern const char* const FM_PRESET_NAMES[FM_PRESETS];
+FmPatch MakeFmPreset(unsigned int index);
+
+// Phase-modulation voices, one per lane, with every operator's state stored structure-of-
+// arrays so a lane group of voices runs each operator with one SIMD instruction stream. The
+// routing comes from the patch and is the same for every voice, so it never diverges across
+// lanes. Envelopes advance at control rate, every ENVELOPE_INTERVAL samples, and ramp
+// linearly in between.
+//
+// Output is frame-major across voices, as SvfBank expects: sample n of voice v lives at
+// n * MAX_VOICES + v.
+class FmBank
+{
+public:
+    static constexpr unsigned int MAX_VOICES = 16;
+#if SYNTH_HAS_AVX
+    static constexpr unsigned int LANE_WIDTH = 8;
+#elif SYNTH_HAS_SSE2
+    static constexpr unsigned int LANE_WIDTH = 4;
+#else
+    static constexpr unsigned int LANE_WIDTH = 1;
+#endif
+    static constexpr unsigned int GROUP_COUNT = MAX_VOICES / LANE_WIDTH;
+    static constexpr unsigned int ENVELOPE_INTERVAL = 32;
+
+    // Restarts the voice's phases and attacks; a voice still releasing rises from its
+    // current level rather than clicking to zero
+    void NoteOn(unsigned int voice, double freq);
+    void NoteOff(unsigned int voice);
+    void Silence(); // Every voice, immediately
+
+    bool IsSounding(unsigned int voice) const
+    {
+        return (m_soundingMask >> voice) & 1;
+    }
+    // Voices still audible: held, or in their release
+    unsigned int GetSoundingMask() const
+    {
+        return m_soundingMask;
+    }
+
+    // Overwrites the lanes of every sounding voice with nFrames of output, scaled by gain, and
+    // returns the mask of voices it wrote. Voices whose carriers have finished releasing drop
+    // out of the mask afterwards.
+    unsigned int Render(const FmPatch& patch, float* pVoices, unsigned int nFrames,
+                        double sampleRate, float gain);
+
+private:
+    enum class Stage : uint8_t
+    {
+        Idle,
+        Attack,
+        Decay,
+        Release
+    };
+
+    alignas(32) float m_phase[FM_OPERATORS][MAX_VOICES] = {}; // Cycles, within +-0.5
+    alignas(32) float m_amplitude[FM_OPERATORS][MAX_VOICES] = {}; // Envelope times level
+    alignas(32) float m_feedback1[FM_OPERATORS][MAX_VOICES] = {}; // Last two outputs
+    alignas(32) float m_feedback2[FM_OPERATORS][MAX_VOICES] = {};
+    float m_envelope[FM_OPERATORS][MAX_VOICES] = {};
+    Stage m_stage[FM_OPERATORS][MAX_VOICES] = {};
+    double m_freq[MAX_VOICES] = {};
+    unsigned int m_soundingMask = 0;
+
+    // Per-sample multipliers for the patch and rate of the current block
+    struct Rates
+    {
+        float attackStep[FM_OPERATORS];
+        float decayCoeff[FM_OPERATORS];
+        float releaseCoeff[FM_OPERATORS];
+    };
+
+    bool AdvanceEnvelope(unsigned int op, unsigned int voice, const FmOperator& settings,
+                         const Rates& rates, unsigned int nSamples);
+    void RenderGroup(const FmPatch& patch, const Rates& rates, float* pVoices,
+                     unsigned int nFrames, double sampleRate, float gain, unsigned int first);
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "Simd.h"
+
+#include <cmath>
+#include <cstdint>
+
+// Full-scale multiplier used when converting [-1, 1] floats to PCM. For 32-bit samples this is
+// the largest float below 2^31, since 2147483647.0f rounds up and would wrap on conversion.
+template <class T>
+struct PcmTraits;
+
+template <>
+struct PcmTraits<int16_t>
+{
+    static constexpr float kScale = 32767.0f;
+};
+
+template <>
+struct PcmTraits<int32_t>
+{
+    static constexpr float kScale = 2147483520.0f;
+};
+
+template <class T>
+inline T ConvertSample(float fSample)
+{
+    float fClipped = fSample > 1.0f ? 1.0f : (fSample < -1.0f ? -1.0f : fSample);
+    return (T)std::lrintf(fClipped * PcmTraits<T>::kScale);
+}
+
+// Clips planar per-channel float buffers and interleaves them into device-format PCM frames.
+template <class T>
+inline void InterleaveScalar(const float* const* ppPlanar, unsigned int nChannels,
+                             unsigned int nFrames, T* pOut)
+{
+    for (unsigned int n = 0; n < nFrames; n++)
+        for (unsigned int c = 0; c < nChannels; c++)
+            pOut[n * nChannels + c] = ConvertSample<T>(ppPlanar[c][n]);
+}
+
+template <class T>
+inline void Interleave(const float* const* ppPlanar, unsigned int nChannels, unsigned int nFrames,
+                       T* pOut)
+{
+    InterleaveScalar(ppPlanar, nChannels, nFrames, pOut);
+}
+
+#if SYNTH_HAS_SSE2
+inline __m128i ConvertSamples4(__m128 vSamples)
+{
+    const __m128 vMax = _mm_set1_ps(1.0f);
+    const __m128 vMin = _mm_set1_ps(-1.0f);
+    const __m128 vScale = _mm_set1_ps(PcmTraits<int32_t>::kScale);
+    vSamples = _mm_min_ps(_mm_max_ps(vSamples, vMin), vMax);
+    return _mm_cvtps_epi32(_mm_mul_ps(vSamples, vScale));
+}
+
+// Mono and stereo cover every device we open; other layouts take the scalar path.
+template <>
+inline void Interleave<int32_t>(const float* const* ppPlanar, unsigned int nChannels,
+                                unsigned int nFrames, int32_t* pOut)
+{
+    unsigned int n = 0;
+    if (nChannels == 1)
+    {
+        const float* pMono = ppPlanar[0];
+        for (; n + 4 <= nFrames; n += 4)
+            _mm_storeu_si128((__m128i*)(pOut + n), ConvertSamples4(_mm_loadu_ps(pMono + n)));
+    }
+    else if (nChannels == 2)
+    {
+        const float* pLeft = ppPlanar[0];
+        const float* pRight = ppPlanar[1];
+        for (; n + 4 <= nFrames; n += 4)
+        {
+            __m128i vLeft = ConvertSamples4(_mm_loadu_ps(pLeft + n));
+            __m128i vRight = ConvertSamples4(_mm_loadu_ps(pRight + n));
+            _mm_storeu_si128((__m128i*)(pOut + n * 2), _mm_unpacklo_epi32(vLeft, vRight));
+            _mm_storeu_si128((__m128i*)(pOut + n * 2 + 4), _mm_unpackhi_epi32(vLeft, vRight));
+        }
+    }
+
+    for (; n < nFrames; n++)
+        for (unsigned int c = 0; c < nChannels; c++)
+            pOut[n * nChannels + c] = ConvertSample<int32_t>(ppPlanar[c][n]);
+}
+#endif
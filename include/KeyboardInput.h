@@ -0,0 +1,46 @@
+#pragma once
+
+#include <Windows.h>
+#include <bitset>
+#include <future>
+#include <thread>
+
+class AudioManager;
+
+// Reads the keyboard through Raw Input on a dedicated thread and queues each key with the audio
+// engine the moment it arrives, so key latency no longer waits on the GUI thread's message pump
+// and vsync. The thread owns a message-only window registered with RIDEV_INPUTSINK; key downs
+// are only played while `focusWindow` is in the foreground, but the matching key up is always
+// passed on so a note held across a focus change is not left stuck.
+//
+// While running, this thread is the only producer of key events for the AudioManager.
+class KeyboardInput
+{
+public:
+    KeyboardInput() = default;
+    ~KeyboardInput();
+    KeyboardInput(const KeyboardInput&) = delete;
+    KeyboardInput& operator=(const KeyboardInput&) = delete;
+
+    // Starts the thread and waits for the device registration. Returns false, with no thread
+    // left running, when Raw Input is unavailable.
+    bool Start(AudioManager* audio, HWND focusWindow);
+    void Stop();
+
+    bool IsRunning() const
+    {
+        return m_thread.joinable();
+    }
+
+private:
+    AudioManager* m_audio = nullptr;
+    HWND m_focusWindow = nullptr;
+    std::thread m_thread;
+    DWORD m_threadId = 0; // Written by the thread before it reports ready
+
+    // Input thread only: keys whose down was passed on, to drop auto-repeat and stray ups
+    std::bitset<256> m_keysDown;
+
+    void ThreadMain(std::promise<bool>* pReady);
+    void HandleInput(HRAWINPUT hInput);
+};
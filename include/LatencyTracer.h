@@ -0,0 +1,99 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Key-to-sound latency distribution. The render thread records one sample per traced key
+// event: the time from the input timestamp to the expected playback of the first block the
+// event affects, split into the wait for that block to be rendered and the time the block then
+// spends queued in the device. Readers may be on any thread.
+class LatencyTracer
+{
+public:
+    static constexpr unsigned int BIN_COUNT = 200;
+    static constexpr double BIN_MS = 0.5; // The last bin also collects everything slower
+
+    // Monotonic timestamp in nanoseconds, the clock every traced time is taken from
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    void Record(double queueMs, double outputMs)
+    {
+        double totalMs = queueMs + outputMs;
+        unsigned int bin = totalMs <= 0.0 ? 0 : (unsigned int)(totalMs / BIN_MS);
+        m_bins[bin < BIN_COUNT ? bin : BIN_COUNT - 1].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        Accumulate(m_queueSumMs, queueMs);
+        Accumulate(m_outputSumMs, outputMs);
+        if (totalMs > m_maxMs.load(std::memory_order_relaxed))
+            m_maxMs.store(totalMs, std::memory_order_relaxed);
+    }
+
+    void Reset()
+    {
+        for (std::atomic<uint32_t>& bin : m_bins)
+            bin.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_queueSumMs.store(0.0, std::memory_order_relaxed);
+        m_outputSumMs.store(0.0, std::memory_order_relaxed);
+        m_maxMs.store(0.0, std::memory_order_relaxed);
+    }
+
+    uint32_t GetCount() const
+    {
+        return m_count.load(std::memory_order_relaxed);
+    }
+    uint32_t GetBin(unsigned int bin) const
+    {
+        return m_bins[bin].load(std::memory_order_relaxed);
+    }
+    double GetAverageQueueMs() const
+    {
+        uint32_t count = GetCount();
+        return count ? m_queueSumMs.load(std::memory_order_relaxed) / count : 0.0;
+    }
+    double GetAverageOutputMs() const
+    {
+        uint32_t count = GetCount();
+        return count ? m_outputSumMs.load(std::memory_order_relaxed) / count : 0.0;
+    }
+    double GetMaxMs() const
+    {
+        return m_maxMs.load(std::memory_order_relaxed);
+    }
+
+    // Upper edge of the bin holding the given fraction of samples, e.g. 0.95
+    double GetPercentileMs(double fraction) const
+    {
+        uint32_t count = GetCount();
+        if (count == 0)
+            return 0.0;
+        uint64_t target = (uint64_t)(fraction * count + 0.5);
+        uint64_t seen = 0;
+        for (unsigned int b = 0; b < BIN_COUNT; b++)
+        {
+            seen += GetBin(b);
+            if (seen >= target && seen > 0)
+                return (b + 1) * BIN_MS;
+        }
+        return BIN_COUNT * BIN_MS;
+    }
+
+private:
+    std::atomic<uint32_t> m_bins[BIN_COUNT] = {};
+    std::atomic<uint32_t> m_count{0};
+    std::atomic<double> m_queueSumMs{0.0};
+    std::atomic<double> m_outputSumMs{0.0};
+    std::atomic<double> m_maxMs{0.0};
+
+    // Single writer, so a load and store is enough
+    static void Accumulate(std::atomic<double>& sum, double value)
+    {
+        sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+};
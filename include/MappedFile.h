@@ -0,0 +1,47 @@
+#pragma once
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+#include <cstdint>
+#include <filesystem>
+
+// Read-only view of a whole file. The data lives in the OS page cache rather than the process
+// heap, so large files cost address space, not committed memory, and pages the engine never
+// touches are never read from disk.
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::filesystem::path& path);
+    void Close();
+
+    // Reads one byte per page so later accesses don't fault, e.g. before the audio thread
+    // starts reading. `offset` and `size` select part of the file.
+    void Prefault(uint64_t offset = 0, uint64_t size = UINT64_MAX) const;
+
+    bool IsOpen() const
+    {
+        return m_data != nullptr;
+    }
+    const unsigned char* GetData() const
+    {
+        return m_data;
+    }
+    uint64_t GetSize() const
+    {
+        return m_size;
+    }
+
+private:
+#if defined(_WIN32)
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = nullptr;
+#endif
+    const unsigned char* m_data = nullptr;
+    uint64_t m_size = 0;
+};
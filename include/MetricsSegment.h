@@ -0,0 +1,71 @@
+#pragma once
+
+#if defined(_WIN32)
+#include <Windows.h>
+#endif
+#include <atomic>
+#include <cstdint>
+
+// Engine counters as published once per device block. Plain data, so both sides of the
+// segment see the same layout; METRICS_VERSION changes with it.
+struct EngineMetrics
+{
+    uint64_t blocks;       // Device blocks since the stream started
+    uint64_t underruns;    // Times the device played out everything queued
+    double blockMs;        // Render time of the newest device block
+    double averageBlockMs; // Smoothed, as the GUI's stats panel shows it
+    double peakBlockMs;    // Slowly decaying peak
+    double dspLoad;        // Average render time over block duration
+    uint32_t sampleRate;   // Of the device
+    uint32_t blockFrames;
+    uint32_t activeVoices;
+    uint32_t keyQueueDepth; // Key events waiting when the newest block started
+    uint32_t droppedKeyEvents;
+    uint32_t reserved;
+};
+
+constexpr uint32_t METRICS_VERSION = 1;
+constexpr const wchar_t* METRICS_SEGMENT_NAME = L"Local\\WinSynthMetrics";
+
+// A named shared-memory block holding EngineMetrics behind a sequence lock, so monitors in
+// other processes can read the engine's counters without any call into it. The render thread
+// pays a handful of stores per block; readers retry if they caught it mid-update. Windows only;
+// elsewhere Create and Open fail.
+class MetricsSegment
+{
+public:
+    MetricsSegment() = default;
+    ~MetricsSegment();
+    MetricsSegment(const MetricsSegment&) = delete;
+    MetricsSegment& operator=(const MetricsSegment&) = delete;
+
+    // Writer. Fails if the segment already exists, i.e. another instance is publishing.
+    bool Create();
+    // Reader; the segment only lives while its writer does
+    bool Open();
+    void Close();
+    bool IsOpen() const
+    {
+        return m_block != nullptr;
+    }
+
+    // Writer's render thread; does nothing unless created
+    void Publish(const EngineMetrics& metrics);
+    // False if not open, or the copy overlapped a Publish and should be retried
+    bool Read(EngineMetrics& out) const;
+
+private:
+    struct Block
+    {
+        uint32_t version;
+        uint32_t size; // sizeof(Block), a second check that both sides agree on the layout
+        std::atomic<uint32_t> sequence; // Odd while Publish is writing
+        EngineMetrics metrics;
+    };
+
+#if defined(_WIN32)
+    HANDLE m_mapping = nullptr;
+#endif
+    Block* m_block = nullptr;
+    bool m_writer = false;
+};
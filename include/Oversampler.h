@@ -0,0 +1,51 @@
+#pragma once
+
+#include <vector>
+
+// Half-band FIR decimator by two in polyphase form. The input is split into even and odd
+// phases; every other tap of a half-band filter is zero, so the even phase only meets the
+// centre tap and the odd phase carries the symmetric remainder.
+class HalfBandDecimator
+{
+public:
+    // halfLength pairs of non-zero symmetric taps, i.e. a (4 * halfLength - 1)-tap filter
+    void Prepare(unsigned int halfLength, unsigned int maxInputFrames);
+    void Reset();
+
+    // nInputFrames must be even; writes nInputFrames / 2 samples to pOut
+    void Process(const float* pIn, unsigned int nInputFrames, float* pOut);
+
+private:
+    unsigned int m_halfLength = 0;
+    unsigned int m_history = 0; // 2 * halfLength - 1 samples kept per phase
+    std::vector<float> m_coeffs; // odd-phase taps, nearest the centre first
+    std::vector<float> m_even;
+    std::vector<float> m_odd;
+};
+
+// Decimates a signal rendered at 2x, 4x or 8x the output rate with a cascade of half-band
+// stages. The final stage is the long one; earlier stages run at higher rates where the
+// transition band is wide, so they get away with short filters.
+class Oversampler
+{
+public:
+    static constexpr unsigned int MAX_FACTOR = 8;
+
+    void Prepare(unsigned int maxOutputFrames);
+    void SetFactor(unsigned int factor);
+    unsigned int GetFactor() const
+    {
+        return m_factor;
+    }
+    void Reset();
+
+    // Consumes nOutputFrames * factor oversampled samples and writes nOutputFrames samples
+    void Decimate(const float* pIn, unsigned int nOutputFrames, float* pOut);
+
+private:
+    static constexpr unsigned int STAGE_COUNT = 3;
+
+    unsigned int m_factor = 1;
+    HalfBandDecimator m_stages[STAGE_COUNT]; // m_stages[0] produces the output rate
+    std::vector<float> m_scratch[2];
+};
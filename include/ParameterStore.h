@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+// Every control the GUI can change on the running engine. Enum and switch parameters are
+// stored as floats holding their integer value.
+enum class ParamId
+{
+    WaveType,
+    StereoSpread,
+    Oversampling,
+    Drive,
+    FilterMode,
+    FilterCutoff,
+    FilterResonance,
+    DelayEnabled,
+    DelaySync,
+    DelayMs,
+    DelayBeats,
+    TempoBpm,
+    DelayFeedback,
+    DelayPingPong,
+    DelayMix,
+    ReverbEnabled,
+    ReverbSize,
+    ReverbDecay,
+    ReverbDamping,
+    ReverbMix,
+    ConvolutionEnabled,
+    ConvolutionMix,
+    SamplerInterpolation,
+    Count
+};
+
+enum class Smoothing
+{
+    None,   // Steps at the next block boundary
+    Linear, // Moves towards the target at a constant rate, full range in `smoothingMs`
+    OnePole // Exponential approach with time constant `smoothingMs`
+};
+
+struct ParamInfo
+{
+    const char* key; // Stable identifier used in preset files; never rename
+    const char* name;
+    float defaultValue;
+    float minValue;
+    float maxValue;
+    Smoothing smoothing;
+    float smoothingMs;
+};
+
+// Latest target value of every parameter. Any thread may write; each slot sits on its own
+// cache line so GUI writes never contend with the render thread's reads of its neighbours.
+// Parameters are independent of each other, so relaxed ordering is enough.
+class ParameterStore
+{
+public:
+    ParameterStore();
+
+    void Set(ParamId id, float value); // Clamped to the parameter's range
+    // Writes all ParamId::Count values as one batch, e.g. a preset. A ParameterSnapshot sees
+    // either none of the batch or all of it. One batch writer at a time.
+    void SetAll(const float* pValues);
+    // Reads all ParamId::Count values; false if a batch was being written meanwhile
+    bool GetAll(float* pValues) const;
+    float Get(ParamId id) const
+    {
+        return m_slots[(size_t)id].value.load(std::memory_order_relaxed);
+    }
+
+    static const ParamInfo& GetInfo(ParamId id);
+    static ParamId FindKey(std::string_view key); // ParamId::Count when unknown
+
+private:
+    struct alignas(64) Slot
+    {
+        std::atomic<float> value{0.0f};
+    };
+    Slot m_slots[(size_t)ParamId::Count];
+    alignas(64) std::atomic<uint32_t> m_sequence{0}; // Odd while SetAll is writing
+};
+
+// Render-thread view of the store. Update reads every target once at the top of a block and
+// advances each smoother by the block length; the block then ramps linearly from the previous
+// block's end value to the new one.
+class ParameterSnapshot
+{
+public:
+    void Reset(const ParameterStore& store); // Jump straight to the current targets
+    void Update(const ParameterStore& store, unsigned int nFrames, double sampleRate);
+
+    float GetStart(ParamId id) const
+    {
+        return m_start[(size_t)id];
+    }
+    float Get(ParamId id) const // Value at the end of the block
+    {
+        return m_end[(size_t)id];
+    }
+    int GetInt(ParamId id) const
+    {
+        return (int)m_end[(size_t)id];
+    }
+    bool GetBool(ParamId id) const
+    {
+        return m_end[(size_t)id] != 0.0f;
+    }
+    bool IsRamping(ParamId id) const
+    {
+        return m_start[(size_t)id] != m_end[(size_t)id];
+    }
+
+private:
+    float m_start[(size_t)ParamId::Count] = {};
+    float m_end[(size_t)ParamId::Count] = {};
+    float m_target[(size_t)ParamId::Count] = {}; // Last consistent read of the store
+};
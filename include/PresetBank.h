@@ -0,0 +1,95 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "ParameterStore.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Bank file layout, little-endian: one PresetBankHeader followed by `patchCount` PresetPatch
+// records. The file is mapped and used in place, so both structs are fixed size and plain
+// data. Bump PRESET_BANK_VERSION whenever either layout, or the meaning of an existing value
+// slot, changes; new parameters only need appending to ParamId, since a patch stores
+// `paramCount` values and anything past that loads as the parameter's default.
+constexpr char PRESET_BANK_MAGIC[8] = {'W', 'S', 'Y', 'N', 'B', 'A', 'N', 'K'};
+constexpr uint32_t PRESET_BANK_VERSION = 1;
+constexpr unsigned int PRESET_NAME_LENGTH = 32; // Including the terminator
+constexpr unsigned int PRESET_MAX_PARAMS = 64;
+static_assert((size_t)ParamId::Count <= PRESET_MAX_PARAMS, "Grow PRESET_MAX_PARAMS");
+
+struct PresetBankHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize; // sizeof(PresetBankHeader)
+    uint32_t patchSize;  // sizeof(PresetPatch)
+    uint32_t paramCount; // Value slots in use in every patch, ParamId::Count when written
+    uint32_t patchCount;
+    uint32_t reserved;
+};
+
+struct PresetPatch
+{
+    char name[PRESET_NAME_LENGTH];
+    float values[PRESET_MAX_PARAMS]; // Indexed by ParamId
+};
+
+static_assert(std::is_trivially_copyable_v<PresetBankHeader> && sizeof(PresetBankHeader) == 32);
+static_assert(std::is_trivially_copyable_v<PresetPatch> && sizeof(PresetPatch) == 288);
+
+// Patch holding every parameter's default value
+PresetPatch MakeDefaultPatch(const char* name);
+// Patch holding the store's current targets
+PresetPatch CapturePatch(const ParameterStore& store, const char* name);
+
+// Read-only view of a bank file mapped into memory. Opening validates the header and touches
+// every page, so selecting a patch afterwards is a pointer lookup with no I/O, parsing or
+// allocation. Patches stay valid until Close.
+class PresetBank
+{
+public:
+    PresetBank() = default;
+    ~PresetBank();
+    PresetBank(const PresetBank&) = delete;
+    PresetBank& operator=(const PresetBank&) = delete;
+
+    bool Open(const std::filesystem::path& path, std::string* error = nullptr);
+    void Close();
+
+    unsigned int GetCount() const
+    {
+        return m_header ? m_header->patchCount : 0;
+    }
+    const PresetPatch& GetPatch(unsigned int index) const
+    {
+        return m_patches[index];
+    }
+    // Parameter value with the default substituted for slots the bank predates
+    float GetValue(unsigned int index, ParamId id) const;
+    // Copies a patch with every slot filled in, ready for AudioManager::ApplyPatch
+    void Load(unsigned int index, PresetPatch& out) const;
+
+private:
+    MappedFile m_file;
+    const PresetBankHeader* m_header = nullptr;
+    const PresetPatch* m_patches = nullptr;
+};
+
+// Writes a bank file. The bank must not be open in a PresetBank while it is rewritten.
+bool SavePresetBank(const std::filesystem::path& path, const std::vector<PresetPatch>& patches,
+                    std::string* error = nullptr);
+
+// Plain-text form for editing and version control:
+//
+//   # comment
+//   [Patch name]
+//   filter_cutoff = 1200
+//   drive = 0.5
+//
+// Keys are ParamInfo::key; parameters a patch leaves out take their defaults.
+bool ImportPresetText(const std::filesystem::path& path, std::vector<PresetPatch>& out,
+                      std::string* error = nullptr);
+bool ExportPresetText(const std::filesystem::path& path, const PresetBank& bank);
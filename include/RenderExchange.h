@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+// Single-producer hand-off of engine objects to the audio thread. The GUI publishes; the
+// audio thread adopts the newest object at the top of a block and hands the old one back
+// through the retired slot, so nothing is freed on the audio thread.
+template <class T>
+class RenderExchange
+{
+public:
+    ~RenderExchange()
+    {
+        delete m_pending.exchange(nullptr);
+        delete m_retired.exchange(nullptr);
+        delete m_active;
+    }
+
+    // GUI thread
+    void Publish(std::unique_ptr<T> object)
+    {
+        delete m_retired.exchange(nullptr, std::memory_order_acquire);
+        // An object still pending was never seen by the audio thread and can go straight away
+        delete m_pending.exchange(object.release(), std::memory_order_acq_rel);
+    }
+
+    // Audio thread, once per block
+    T* Acquire()
+    {
+        // Only swap once the GUI has collected the previous retiree
+        if (m_retired.load(std::memory_order_acquire) == nullptr)
+        {
+            T* next = m_pending.exchange(nullptr, std::memory_order_acq_rel);
+            if (next)
+            {
+                m_retired.store(m_active, std::memory_order_release);
+                m_active = next;
+            }
+        }
+        return m_active;
+    }
+
+private:
+    std::atomic<T*> m_pending{nullptr};
+    std::atomic<T*> m_retired{nullptr};
+    T* m_active = nullptr;
+};
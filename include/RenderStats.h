@@ -0,0 +1,77 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+
+enum class RenderStage
+{
+    Total,
+    Voices,
+    Filter,
+    Oversampling,
+    Graph,
+    Convolution,
+    Capture, // Copying device blocks to the history and recorder, outside Total
+    Count
+};
+
+// Per-stage render cost written by the audio thread and read by the GUI. Each stage keeps a
+// smoothed average and a slowly decaying peak, both in milliseconds per block.
+class RenderStats
+{
+public:
+    void Record(RenderStage stage, double ms)
+    {
+        Slot& slot = m_slots[(size_t)stage];
+        double average = slot.averageMs.load(std::memory_order_relaxed);
+        double peak = slot.peakMs.load(std::memory_order_relaxed);
+        slot.averageMs.store(average + (ms - average) * SMOOTHING, std::memory_order_relaxed);
+        slot.peakMs.store(std::max(ms, peak * PEAK_DECAY), std::memory_order_relaxed);
+    }
+
+    double GetAverageMs(RenderStage stage) const
+    {
+        return m_slots[(size_t)stage].averageMs.load(std::memory_order_relaxed);
+    }
+
+    double GetPeakMs(RenderStage stage) const
+    {
+        return m_slots[(size_t)stage].peakMs.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr double SMOOTHING = 0.05;
+    static constexpr double PEAK_DECAY = 0.995;
+
+    struct Slot
+    {
+        std::atomic<double> averageMs{0.0};
+        std::atomic<double> peakMs{0.0};
+    };
+    Slot m_slots[(size_t)RenderStage::Count];
+};
+
+class ScopedStageTimer
+{
+public:
+    ScopedStageTimer(RenderStats& stats, RenderStage stage)
+        : m_stats(stats), m_stage(stage), m_start(std::chrono::steady_clock::now())
+    {
+    }
+
+    ~ScopedStageTimer()
+    {
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - m_start;
+        m_stats.Record(m_stage, elapsed.count());
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    RenderStats& m_stats;
+    RenderStage m_stage;
+    std::chrono::steady_clock::time_point m_start;
+};
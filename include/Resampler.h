@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tap counts are for upsampling; downsampling by a factor of r uses r times as many
+enum class ResampleQuality
+{
+    Draft,  // 8 taps; previews and sample playback with many voices
+    Normal, // 24 taps
+    High,   // 64 taps; offline and file conversion
+    Count
+};
+
+constexpr unsigned int RESAMPLE_MAX_TAPS = 256;
+
+// Kaiser-windowed sinc low-pass in polyphase form: PHASES + 1 rows of `taps` coefficients, one
+// row per fractional offset, with a second table of row-to-row differences so an arbitrary
+// fraction costs one multiply-add per tap. Serves both fixed-ratio conversion and the
+// variable ratio of pitched sample playback.
+class ResampleKernel
+{
+public:
+    static constexpr unsigned int PHASES = 256;
+
+    // `ratio` is output rate over input rate; below 1 the cutoff drops to the output Nyquist
+    // frequency and the kernel lengthens, up to RESAMPLE_MAX_TAPS
+    void Prepare(ResampleQuality quality, double ratio);
+
+    unsigned int GetTaps() const
+    {
+        return m_taps;
+    }
+    // Input frames on each side of the output position: pTaps[0] is frame floor(t) - half + 1
+    unsigned int GetHalfTaps() const
+    {
+        return m_taps / 2;
+    }
+
+    // Output at fractional position `fraction` (in [0, 1)) past pTaps[GetHalfTaps() - 1]
+    float Interpolate(const float* pTaps, float fraction) const;
+
+private:
+    unsigned int m_taps = 0;
+    std::vector<float> m_coeffs; // (PHASES + 1) * m_taps, row-major
+    std::vector<float> m_deltas; // Row p + 1 minus row p
+};
+
+// Streaming fixed-ratio converter for planar audio. Input is pushed in any amount; output is
+// pulled in any amount once enough input has arrived. Output frame k is the input signal at
+// time k * inRate / outRate, so the two stay aligned apart from the kernel's look-ahead of
+// GetHalfTaps() input frames.
+class Resampler
+{
+public:
+    // `maxPushFrames` bounds a single Push
+    void Prepare(double inRate, double outRate, unsigned int channels, ResampleQuality quality,
+                 size_t maxPushFrames);
+    void Reset();
+
+    // Adds input frames. Call only once Pull has taken everything it can.
+    void Push(const float* const* ppIn, size_t frames);
+    // Writes up to `frames` output frames at ppOut[c] + offset; returns how many were ready
+    size_t Pull(float* const* ppOut, size_t offset, size_t frames);
+
+    unsigned int GetHalfTaps() const
+    {
+        return m_kernel.GetHalfTaps();
+    }
+
+private:
+    ResampleKernel m_kernel;
+    std::vector<std::vector<float>> m_buffers; // Per channel: history, then pushed input
+    size_t m_buffered = 0;
+    uint64_t m_position = 0; // 32.32 input frames from the start of the buffers
+    uint64_t m_step = 0;
+};
+
+// Converts a whole signal, e.g. a file, at High quality. Returns
+// round(in.size() * outRate / inRate) frames.
+std::vector<float> ResampleSignal(const std::vector<float>& in, double inRate, double outRate,
+                                  ResampleQuality quality = ResampleQuality::High);
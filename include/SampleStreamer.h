@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Sampler.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+// Streams the part of each sample past its resident head into one ring per voice. Voices
+// address a stream by virtual frame, where a loop is unrolled, so the ring only ever moves
+// forward. The render thread never blocks: a frame the prefetch thread hasn't delivered yet
+// plays as silence and counts as a starvation.
+//
+// Each slot has one reader (the render thread, for the voice with that index) and one writer
+// (the prefetch thread). A note on bumps the slot's generation; data tagged with an older
+// generation is ignored, which is what lets a slot restart without a lock.
+class SampleStreamer
+{
+public:
+    static constexpr size_t RING_FRAMES = 1 << 16; // Per voice, mono
+    static constexpr size_t CHUNK_FRAMES = 4096;   // Decoded per slot before moving to the next
+    static_assert(RING_FRAMES >= GetSamplerDecodeFrames(512 * 8), "Ring shorter than one read");
+
+    explicit SampleStreamer(unsigned int slots);
+    ~SampleStreamer();
+    SampleStreamer(const SampleStreamer&) = delete;
+    SampleStreamer& operator=(const SampleStreamer&) = delete;
+
+    // Simulates a slow disk by sleeping this long before every chunk the thread decodes
+    void SetDiskDelayMs(double ms)
+    {
+        m_diskDelayMs.store(ms, std::memory_order_relaxed);
+    }
+
+    // Render thread
+    void BeginVoice(unsigned int slot, const SampleZone* zone);
+    void EndVoice(unsigned int slot);
+    // Fills virtual frames [first, first + count) from the head or the ring, with silence past
+    // the end of a one-shot sample and in place of anything not streamed in yet
+    void Read(unsigned int slot, int64_t first, size_t count, float* pOut);
+    // Frames before `first` are no longer needed and may be overwritten
+    void Release(unsigned int slot, int64_t first);
+    // Offline rendering only: waits until every active ring is as full as it can be, so the
+    // output doesn't depend on how fast the disk was
+    void WaitUntilFilled();
+
+    // Statistics, any thread
+    uint64_t GetReads() const
+    {
+        return m_reads.load(std::memory_order_relaxed);
+    }
+    uint64_t GetStarvations() const
+    {
+        return m_starvations.load(std::memory_order_relaxed);
+    }
+    double GetHitRate() const; // Fraction of reads served in full, 1 before any reads
+    // How far the ring ran ahead of the voice, in milliseconds of source audio; infinite
+    // before any streamed read
+    double GetMinLeadMs() const
+    {
+        return m_minLeadMs.load(std::memory_order_relaxed);
+    }
+    double GetAverageLeadMs() const;
+    void ResetStats();
+
+private:
+    struct Slot
+    {
+        // Written by the render thread
+        std::atomic<const SampleZone*> zone{nullptr};
+        std::atomic<uint32_t> generation{0};
+        std::atomic<int64_t> released{0}; // First virtual frame still needed
+        // Written by the prefetch thread: generation << 48 | first virtual frame not yet filled
+        alignas(64) std::atomic<uint64_t> filled{0};
+        std::unique_ptr<float[]> ring;
+
+        // Render thread's copy of what it asked for
+        const SampleZone* readerZone = nullptr;
+        uint32_t readerGeneration = 0;
+        // Prefetch thread's copy of what it is filling
+        const SampleZone* writerZone = nullptr;
+        uint32_t writerGeneration = 0;
+        uint64_t writerFilled = 0;
+    };
+
+    std::unique_ptr<Slot[]> m_slots;
+    unsigned int m_slotCount = 0;
+    std::atomic<uint32_t> m_wake{0};
+    std::atomic<bool> m_running{true};
+    std::atomic<double> m_diskDelayMs{0.0};
+    std::atomic<uint64_t> m_reads{0};
+    std::atomic<uint64_t> m_starvations{0};
+    std::atomic<uint64_t> m_leadSamples{0};
+    std::atomic<double> m_leadSumMs{0.0};
+    std::atomic<double> m_minLeadMs{0.0};
+    std::thread m_thread;
+
+    static uint64_t GetStreamEnd(const SampleZone* zone); // UINT64_MAX for a looped zone
+    uint64_t GetFillLimit(const Slot& slot, const SampleZone* zone) const;
+    void PrefetchLoop();
+    bool FillSlot(Slot& slot); // True if it decoded anything
+    void Wake();
+};
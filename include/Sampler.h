@@ -0,0 +1,183 @@
+#pragma once
+
+#include "MappedFile.h"
+#include "Resampler.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SampleStreamer;
+
+// WAV file used in place from a MappedFile; nothing is decoded up front. Accepts the formats
+// LoadWav does. Loop points and the root note come from the `smpl` chunk when there is one.
+class MappedWav
+{
+public:
+    bool Open(const std::filesystem::path& path, std::string* error = nullptr);
+
+    unsigned int GetSampleRate() const
+    {
+        return m_sampleRate;
+    }
+    unsigned int GetChannels() const
+    {
+        return m_channels;
+    }
+    size_t GetFrameCount() const
+    {
+        return m_frames;
+    }
+    size_t GetDataBytes() const
+    {
+        return m_frames * m_frameBytes;
+    }
+    bool HasLoop() const
+    {
+        return m_loopEnd > m_loopStart;
+    }
+    size_t GetLoopStart() const
+    {
+        return m_loopStart;
+    }
+    size_t GetLoopEnd() const // One past the last looped frame
+    {
+        return m_loopEnd;
+    }
+    double GetRootNote() const // MIDI note with fraction, or negative if the file has none
+    {
+        return m_rootNote;
+    }
+
+    // Decodes `count` frames from `first` to mono floats, averaging the channels. The frames
+    // must lie inside the file. Vectorized for 16-bit and float mono and stereo.
+    void DecodeMono(size_t first, size_t count, float* pOut) const;
+    // Pages frames [first, first + count) in from disk
+    void Prefault(size_t first, size_t count) const;
+
+private:
+    enum class Encoding
+    {
+        Int16,
+        Int24,
+        Int32,
+        Float32
+    };
+
+    MappedFile m_file;
+    const unsigned char* m_pFrames = nullptr;
+    uint64_t m_dataOffset = 0;
+    Encoding m_encoding = Encoding::Int16;
+    unsigned int m_sampleRate = 0;
+    unsigned int m_channels = 0;
+    unsigned int m_frameBytes = 0;
+    size_t m_frames = 0;
+    size_t m_loopStart = 0;
+    size_t m_loopEnd = 0;
+    double m_rootNote = -1.0;
+
+    void DecodeMonoScalar(size_t first, size_t count, float* pOut) const;
+};
+
+// Frames at the start of each sample kept paged in. A sample that plays longer than this is
+// streamed past it by a SampleStreamer; 1.5 s at 44.1 kHz.
+constexpr size_t SAMPLER_RESIDENT_FRAMES = 1 << 16;
+
+// One sample of a multisampled instrument, played for the notes nearest its root
+struct SampleZone
+{
+    MappedWav wav;
+    double rootFreq;
+    bool streamed; // Only the first SAMPLER_RESIDENT_FRAMES frames are resident
+    // One per ResampleQuality, converting the file's rate to the render rate; shared by every
+    // zone recorded at the same rate
+    const ResampleKernel* kernels;
+};
+
+// Decodes source frames [first, first + count) where frames before the start, or past the end
+// of a one-shot sample, are silent and frames past a loop's end wrap back into it
+void ReadSampleFrames(const MappedWav& wav, int64_t first, size_t count, float* pOut);
+
+// A directory of WAV files mapped as one instrument. Each file's root note comes from its
+// `smpl` chunk or, failing that, a note name ending the file name, e.g. "Piano_F#3.wav".
+// Short samples are paged in whole; longer ones keep their attack resident and stream the rest
+// through a prefetch thread the instrument owns, so libraries larger than RAM still play.
+class SampleInstrument
+{
+public:
+    SampleInstrument();
+    ~SampleInstrument();
+    SampleInstrument(const SampleInstrument&) = delete;
+    SampleInstrument& operator=(const SampleInstrument&) = delete;
+
+    // `voices` is the number of stream slots, one per voice that can play at once
+    bool Load(const std::filesystem::path& directory, double renderRate, unsigned int voices,
+              std::string* error = nullptr);
+
+    // Zone whose root is nearest `freq` in pitch; null when the instrument is empty
+    const SampleZone* FindZone(double freq) const;
+
+    size_t GetZoneCount() const
+    {
+        return m_zones.size();
+    }
+    size_t GetMappedBytes() const;
+    size_t GetStreamedZoneCount() const;
+    // Null when every sample fits in its resident head
+    SampleStreamer* GetStreamer() const
+    {
+        return m_streamer.get();
+    }
+
+private:
+    using KernelSet = std::array<ResampleKernel, (size_t)ResampleQuality::Count>;
+
+    std::map<unsigned int, KernelSet> m_kernels;      // By file sample rate
+    std::vector<std::unique_ptr<SampleZone>> m_zones; // Sorted by root frequency
+    std::unique_ptr<SampleStreamer> m_streamer;       // Declared last: stops before zones go
+};
+
+// Playback state of one sampler voice. The read position is 32.32 fixed point in source
+// frames, so it never drifts however long a loop plays. A streamed zone's position isn't
+// wrapped into its loop; the streamer unrolls the loop instead.
+struct SamplerVoice
+{
+    const SampleZone* zone = nullptr; // Null once a one-shot sample has finished
+    uint64_t position = 0;
+    unsigned int slot = 0; // Stream slot, when the zone is streamed
+};
+
+// How RenderSampler reads between source frames. The sinc kernels band-limit the conversion
+// from the file's rate to the render rate; transposing up still aliases as cubic does.
+enum class SamplerInterpolation
+{
+    Cubic, // Catmull-Rom, 4 taps
+    SincDraft,
+    SincNormal,
+    SincHigh
+};
+
+// Largest source frames read per output frame: pitch ratio times source to render rate.
+// Faster playback is clamped and goes flat.
+constexpr double SAMPLER_MAX_STEP = 8.0;
+
+// Source frames read either side of the playhead, for the widest interpolation
+constexpr size_t SAMPLER_MAX_HALF_TAPS = RESAMPLE_MAX_TAPS / 2;
+
+// Source frames DecodeMono can need for one RenderSampler call of `nFrames`
+constexpr size_t GetSamplerDecodeFrames(unsigned int nFrames)
+{
+    return (size_t)(nFrames * SAMPLER_MAX_STEP) + 2 * SAMPLER_MAX_HALF_TAPS + 1;
+}
+
+// Renders one voice at `freq` into pOut (every `stride`th float). `pDecode` holds
+// GetSamplerDecodeFrames(nFrames) floats of scratch. Writes silence once the sample has ended.
+// `pStreamer` is the instrument's, for streamed zones.
+void RenderSampler(SamplerVoice& voice, SampleStreamer* pStreamer,
+                   SamplerInterpolation interpolation, double freq, double sampleRate, float gain,
+                   float* pOut, unsigned int stride, unsigned int nFrames, float* pDecode);
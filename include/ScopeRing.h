@@ -0,0 +1,67 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Stereo history of the rendered output for the GUI's scope and analyzer. The render thread
+// appends each block with a memcpy per channel and publishes the new write position; readers
+// copy out the newest frames and check afterwards that the writer did not lap them.
+class ScopeRing
+{
+public:
+    static constexpr unsigned int CAPACITY = 1u << 14; // Frames, a power of two
+    // Largest store Write makes before publishing; longer blocks are split into stores this
+    // size, so a reader knows how far an unpublished store can reach
+    static constexpr unsigned int MAX_WRITE_FRAMES = 4096;
+
+    ScopeRing() : m_left(CAPACITY, 0.0f), m_right(CAPACITY, 0.0f) {}
+
+    // Render thread
+    void Write(const float* pLeft, const float* pRight, unsigned int nFrames)
+    {
+        for (unsigned int done = 0; done < nFrames; done += MAX_WRITE_FRAMES)
+        {
+            unsigned int length = std::min(nFrames - done, MAX_WRITE_FRAMES);
+            uint64_t position = m_written.load(std::memory_order_relaxed);
+            unsigned int start = (unsigned int)(position & (CAPACITY - 1));
+            unsigned int first = std::min(length, CAPACITY - start);
+            std::memcpy(m_left.data() + start, pLeft + done, first * sizeof(float));
+            std::memcpy(m_right.data() + start, pRight + done, first * sizeof(float));
+            std::memcpy(m_left.data(), pLeft + done + first, (length - first) * sizeof(float));
+            std::memcpy(m_right.data(), pRight + done + first, (length - first) * sizeof(float));
+            m_written.store(position + length, std::memory_order_release);
+        }
+    }
+
+    uint64_t GetWritePosition() const
+    {
+        return m_written.load(std::memory_order_acquire);
+    }
+
+    // Any thread. Copies the newest nFrames frames, at most CAPACITY / 2; false if fewer have
+    // been written or the writer may have overwritten part of them during the copy.
+    bool ReadLatest(float* pLeft, float* pRight, unsigned int nFrames) const
+    {
+        uint64_t end = m_written.load(std::memory_order_acquire);
+        if (nFrames > CAPACITY / 2 || end < nFrames)
+            return false;
+        uint64_t begin = end - nFrames;
+        for (unsigned int n = 0; n < nFrames; n++)
+        {
+            size_t index = (size_t)((begin + n) & (CAPACITY - 1));
+            pLeft[n] = m_left[index];
+            pRight[n] = m_right[index];
+        }
+        // A store still in progress reaches up to MAX_WRITE_FRAMES past the published position
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return m_written.load(std::memory_order_relaxed) - begin + MAX_WRITE_FRAMES <= CAPACITY;
+    }
+
+private:
+    std::vector<float> m_left;
+    std::vector<float> m_right;
+    std::atomic<uint64_t> m_written{0};
+};
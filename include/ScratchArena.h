@@ -0,0 +1,92 @@
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+
+// Bump allocator for per-block temporaries on the render thread. The region is allocated and
+// written once up front so every page is resident before the first block; Allocate is a
+// pointer bump and Reset rewinds it. Nothing is ever freed individually.
+//
+// Running out of space asserts in debug builds. Release builds return nullptr and count the
+// overflow, and the caller drops whatever it was about to render.
+class ScratchArena
+{
+public:
+    static constexpr size_t ALIGNMENT = 64;
+
+    ScratchArena() = default;
+    ~ScratchArena()
+    {
+        Release();
+    }
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    // Not thread safe; call before the render thread starts using the arena
+    void Reserve(size_t bytes)
+    {
+        Release();
+        m_capacity = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (m_capacity == 0)
+            return;
+        m_pBase = static_cast<unsigned char*>(
+            ::operator new(m_capacity, std::align_val_t{ALIGNMENT}));
+        std::memset(m_pBase, 0, m_capacity); // Prefault every page
+        m_used = 0;
+    }
+
+    void Reset()
+    {
+        m_used = 0;
+    }
+
+    template <class T>
+    T* Allocate(size_t count)
+    {
+        size_t bytes = (count * sizeof(T) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        if (bytes > m_capacity - m_used)
+        {
+            assert(!"ScratchArena overflow: reserve more scratch for the render thread");
+            m_overflows.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T* p = reinterpret_cast<T*>(m_pBase + m_used);
+        m_used += bytes;
+        if (m_used > m_highWater.load(std::memory_order_relaxed))
+            m_highWater.store(m_used, std::memory_order_relaxed);
+        return p;
+    }
+
+    // Safe to read from any thread
+    size_t GetCapacity() const
+    {
+        return m_capacity;
+    }
+    size_t GetHighWaterMark() const
+    {
+        return m_highWater.load(std::memory_order_relaxed);
+    }
+    unsigned int GetOverflowCount() const
+    {
+        return m_overflows.load(std::memory_order_relaxed);
+    }
+
+private:
+    unsigned char* m_pBase = nullptr;
+    size_t m_capacity = 0;
+    size_t m_used = 0;
+    std::atomic<size_t> m_highWater{0};
+    std::atomic<unsigned int> m_overflows{0};
+
+    void Release()
+    {
+        if (m_pBase)
+            ::operator delete(m_pBase, std::align_val_t{ALIGNMENT});
+        m_pBase = nullptr;
+        m_capacity = 0;
+        m_used = 0;
+    }
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+// Compile-time SIMD availability. MSVC does not define __SSE2__, so x64 and /arch:SSE2 builds
+// are detected from its own macros instead. SYNTH_FORCE_SCALAR builds the portable fallbacks
+// even where SIMD is available, so they can be tested there.
+#if defined(SYNTH_FORCE_SCALAR)
+#define SYNTH_HAS_SSE2 0
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SYNTH_HAS_SSE2 1
+#include <emmintrin.h>
+#else
+#define SYNTH_HAS_SSE2 0
+#endif
+
+#if defined(__AVX__) && !defined(SYNTH_FORCE_SCALAR)
+#define SYNTH_HAS_AVX 1
+#include <immintrin.h>
+#else
+#define SYNTH_HAS_AVX 0
+#endif
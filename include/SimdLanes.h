@@ -0,0 +1,201 @@
+#pragma once
+
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Lane-wide float operations at the widest SIMD width the build has, so a kernel written once
+// against Lanes runs as AVX, SSE2 or plain scalar code. Only for kernels whose lanes are
+// independent; anything needing shuffles between lanes still spells out its intrinsics.
+namespace simd
+{
+#if SYNTH_HAS_AVX
+using Lanes = __m256;
+constexpr unsigned int LANES = 8;
+inline Lanes Splat(float x)
+{
+    return _mm256_set1_ps(x);
+}
+inline Lanes Load(const float* p)
+{
+    return _mm256_load_ps(p);
+}
+inline Lanes LoadUnaligned(const float* p)
+{
+    return _mm256_loadu_ps(p);
+}
+inline void Store(float* p, Lanes v)
+{
+    _mm256_store_ps(p, v);
+}
+inline void StoreUnaligned(float* p, Lanes v)
+{
+    _mm256_storeu_ps(p, v);
+}
+inline Lanes Add(Lanes a, Lanes b)
+{
+    return _mm256_add_ps(a, b);
+}
+inline Lanes Sub(Lanes a, Lanes b)
+{
+    return _mm256_sub_ps(a, b);
+}
+inline Lanes Mul(Lanes a, Lanes b)
+{
+    return _mm256_mul_ps(a, b);
+}
+inline Lanes Min(Lanes a, Lanes b)
+{
+    return _mm256_min_ps(a, b);
+}
+inline Lanes Round(Lanes a)
+{
+    return _mm256_round_ps(a, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+}
+inline Lanes Abs(Lanes a)
+{
+    return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+}
+inline Lanes CopySign(Lanes magnitude, Lanes sign)
+{
+    return _mm256_or_ps(magnitude, _mm256_and_ps(sign, _mm256_set1_ps(-0.0f)));
+}
+// Of all lanes
+inline float Sum(Lanes a)
+{
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    return _mm_cvtss_f32(_mm_add_ss(half, _mm_shuffle_ps(half, half, 1)));
+}
+#elif SYNTH_HAS_SSE2
+using Lanes = __m128;
+constexpr unsigned int LANES = 4;
+inline Lanes Splat(float x)
+{
+    return _mm_set1_ps(x);
+}
+inline Lanes Load(const float* p)
+{
+    return _mm_load_ps(p);
+}
+inline Lanes LoadUnaligned(const float* p)
+{
+    return _mm_loadu_ps(p);
+}
+inline void Store(float* p, Lanes v)
+{
+    _mm_store_ps(p, v);
+}
+inline void StoreUnaligned(float* p, Lanes v)
+{
+    _mm_storeu_ps(p, v);
+}
+inline Lanes Add(Lanes a, Lanes b)
+{
+    return _mm_add_ps(a, b);
+}
+inline Lanes Sub(Lanes a, Lanes b)
+{
+    return _mm_sub_ps(a, b);
+}
+inline Lanes Mul(Lanes a, Lanes b)
+{
+    return _mm_mul_ps(a, b);
+}
+inline Lanes Min(Lanes a, Lanes b)
+{
+    return _mm_min_ps(a, b);
+}
+// Round to nearest under the default MXCSR mode; phases stay far inside int32 range
+inline Lanes Round(Lanes a)
+{
+    return _mm_cvtepi32_ps(_mm_cvtps_epi32(a));
+}
+inline Lanes Abs(Lanes a)
+{
+    return _mm_andnot_ps(_mm_set1_ps(-0.0f), a);
+}
+inline Lanes CopySign(Lanes magnitude, Lanes sign)
+{
+    return _mm_or_ps(magnitude, _mm_and_ps(sign, _mm_set1_ps(-0.0f)));
+}
+inline float Sum(Lanes a)
+{
+    a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+    return _mm_cvtss_f32(_mm_add_ss(a, _mm_shuffle_ps(a, a, 1)));
+}
+#else
+using Lanes = float;
+constexpr unsigned int LANES = 1;
+inline Lanes Splat(float x)
+{
+    return x;
+}
+inline Lanes Load(const float* p)
+{
+    return *p;
+}
+inline Lanes LoadUnaligned(const float* p)
+{
+    return *p;
+}
+inline void Store(float* p, Lanes v)
+{
+    *p = v;
+}
+inline void StoreUnaligned(float* p, Lanes v)
+{
+    *p = v;
+}
+inline Lanes Add(Lanes a, Lanes b)
+{
+    return a + b;
+}
+inline Lanes Sub(Lanes a, Lanes b)
+{
+    return a - b;
+}
+inline Lanes Mul(Lanes a, Lanes b)
+{
+    return a * b;
+}
+inline Lanes Min(Lanes a, Lanes b)
+{
+    return std::min(a, b);
+}
+inline Lanes Round(Lanes a)
+{
+    return nearbyintf(a);
+}
+inline Lanes Abs(Lanes a)
+{
+    return fabsf(a);
+}
+inline Lanes CopySign(Lanes magnitude, Lanes sign)
+{
+    return copysignf(magnitude, sign);
+}
+inline float Sum(Lanes a)
+{
+    return a;
+}
+#endif
+
+constexpr float TWO_PI = 6.28318530717958647692f;
+
+// sin(2 pi x) for a phase in cycles. Folded to a quarter cycle, where a degree-9 Taylor
+// series is within 4e-6 of the true value.
+inline Lanes Sine(Lanes x)
+{
+    Lanes r = Sub(x, Round(x));
+    Lanes a = Abs(r);
+    Lanes t = Mul(Min(a, Sub(Splat(0.5f), a)), Splat(TWO_PI));
+    Lanes t2 = Mul(t, t);
+    Lanes p = Add(Splat(-1.0f / 5040.0f), Mul(t2, Splat(1.0f / 362880.0f)));
+    p = Add(Splat(1.0f / 120.0f), Mul(t2, p));
+    p = Add(Splat(-1.0f / 6.0f), Mul(t2, p));
+    p = Add(Splat(1.0f), Mul(t2, p));
+    return CopySign(Mul(t, p), r);
+}
+} // namespace simd
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "FFT.h"
+
+#include <cstdint>
+#include <memory>
+
+constexpr unsigned int SPECTRAL_MAX_PARTIALS = 4096;
+constexpr unsigned int SPECTRAL_PRESETS = 3;
+
+// As AdditivePatch, with room for the thousands of partials of a spectral pad
+struct SpectralPatch
+{
+    unsigned int partialCount; // Up to SPECTRAL_MAX_PARTIALS
+    float attackMs;            // Linear rise
+    float releaseMs;           // To fall 60 dB after note off
+    float ratios[SPECTRAL_MAX_PARTIALS];
+    float amplitudes[SPECTRAL_MAX_PARTIALS];
+};
+
+extern const char* const SPECTRAL_PRESET_NAMES[SPECTRAL_PRESETS];
+// At most partialCount partials of the preset's series
+SpectralPatch MakeSpectralPreset(unsigned int index,
+                                 unsigned int partialCount = SPECTRAL_MAX_PARTIALS);
+
+// Sine partials synthesised in the frequency domain. Every HOP samples each sounding voice
+// builds the spectrum of one Blackman-Harris windowed frame, adding each partial as the
+// window's main lobe (KERNEL_BINS bins) centred on its frequency, and turns it back into audio
+// with one inverse FFT. The window is divided out again and the frames overlap-add under
+// triangular windows, which crossfade each partial's level from frame to frame. The inverse
+// FFT is a fixed cost per voice, and a partial costs KERNEL_BINS multiply-adds per hop rather
+// than one oscillator step per sample, so this overtakes AdditiveBank once a voice has more
+// than a few hundred partials.
+//
+// Levels and envelopes change once per hop, so attacks shorter than a hop are smoothed into
+// one. Output is frame-major across voices, as SvfBank expects: sample n of voice v lives at
+// n * MAX_VOICES + v.
+class SpectralBank
+{
+public:
+    static constexpr unsigned int MAX_VOICES = 16;
+    static constexpr unsigned int FRAME_SIZE = 1024;
+    static constexpr unsigned int HOP = FRAME_SIZE / 4;
+    static constexpr unsigned int KERNEL_BINS = 8; // The window's main lobe
+
+    SpectralBank();
+    SpectralBank(const SpectralBank&) = delete;
+    SpectralBank& operator=(const SpectralBank&) = delete;
+
+    // Restarts the voice's partials and attacks from the next hop; a voice still releasing
+    // rises from its current level
+    void NoteOn(unsigned int voice, double freq);
+    void NoteOff(unsigned int voice);
+    void Silence(); // Every voice, immediately, with its hop and overlap tail cleared
+    // The patch's ratios or partial count may have changed: every voice is retuned at the next
+    // hop, keeping the phase of partials that survive the change
+    void PatchChanged();
+
+    bool IsSounding(unsigned int voice) const
+    {
+        return (m_soundingMask >> voice) & 1;
+    }
+    unsigned int GetSoundingMask() const
+    {
+        return m_soundingMask;
+    }
+    // Partials the voice rendered in its last frame, after culling
+    unsigned int GetPartialCount(unsigned int voice) const;
+
+    // Overwrites the lanes of every sounding voice with nFrames of output, scaled by gain, and
+    // returns the mask of voices it wrote
+    unsigned int Render(const SpectralPatch& patch, float* pVoices, unsigned int nFrames,
+                        double sampleRate, float gain);
+
+private:
+    static constexpr unsigned int BIN_COUNT = FRAME_SIZE / 2 + 1;
+    static constexpr unsigned int KERNEL_STEPS = 256; // Fractional bin offsets tabulated
+
+    enum class Stage : uint8_t
+    {
+        Idle,
+        Attack,
+        Hold,
+        Release
+    };
+
+    // One voice's partials below the top of the spectrum, packed to the front. The phasor is
+    // the partial's phase at the centre of the next frame.
+    struct Partials
+    {
+        float cos[SPECTRAL_MAX_PARTIALS];
+        float sin[SPECTRAL_MAX_PARTIALS];
+        float rotationCos[SPECTRAL_MAX_PARTIALS]; // One hop's phase advance
+        float rotationSin[SPECTRAL_MAX_PARTIALS];
+        float bin[SPECTRAL_MAX_PARTIALS];          // Frequency in bins
+        uint16_t partial[SPECTRAL_MAX_PARTIALS];   // Index into the patch
+        unsigned int count;
+        bool stale;   // Retune before the next frame
+        bool restart; // Retune from phase zero
+    };
+
+    // Per voice, on the heap with the partials: the hop being played out, and the second half
+    // of the last frame waiting for the next one to overlap it
+    struct Output
+    {
+        float hop[HOP];
+        float tail[HOP];
+    };
+
+    std::unique_ptr<Partials[]> m_partials;
+    std::unique_ptr<Output[]> m_output;
+    double m_freq[MAX_VOICES] = {};
+    float m_envelope[MAX_VOICES] = {};
+    Stage m_stage[MAX_VOICES] = {};
+    unsigned int m_soundingMask = 0;
+    unsigned int m_finishingMask = 0; // Silent from the next hop, once the tail has played
+    unsigned int m_hopPosition = HOP; // Samples of the current hop already played
+    double m_sampleRate = 0.0;
+
+    // Row r holds the window's spectrum at bin offsets j - 3 - r / KERNEL_STEPS, j below
+    // KERNEL_BINS, with every odd j negated to centre the frame
+    alignas(32) float m_kernel[KERNEL_STEPS + 1][KERNEL_BINS];
+    float m_synthesis[2 * HOP]; // Triangle over the window, for the middle half of a frame
+    FFT m_fft;
+    alignas(32) float m_spectrumRe[BIN_COUNT + KERNEL_BINS];
+    alignas(32) float m_spectrumIm[BIN_COUNT + KERNEL_BINS];
+    float m_frame[FRAME_SIZE];
+
+    void Tune(unsigned int voice, const SpectralPatch& patch, double sampleRate);
+    bool AdvanceEnvelope(unsigned int voice, const SpectralPatch& patch, double sampleRate);
+    void SynthesiseFrame(unsigned int voice, const SpectralPatch& patch, float scale);
+};
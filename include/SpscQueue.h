@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+// Bounded single-producer, single-consumer queue. Push and Pop never block or allocate, so
+// either side may be the render thread. CAPACITY must be a power of two.
+template <class T, size_t CAPACITY>
+class SpscQueue
+{
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "CAPACITY must be a power of two");
+
+public:
+    // Producer. Returns false and drops the item when the queue is full.
+    bool Push(const T& item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == CAPACITY)
+            return false;
+        m_items[tail & (CAPACITY - 1)] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Any thread; a snapshot that may be stale by the time it returns
+    size_t GetSize() const
+    {
+        return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_relaxed);
+    }
+
+    // Consumer
+    bool Pop(T& item)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire))
+            return false;
+        item = m_items[head & (CAPACITY - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T m_items[CAPACITY];
+    alignas(64) std::atomic<size_t> m_head{0}; // Consumer's index
+    alignas(64) std::atomic<size_t> m_tail{0}; // Producer's index
+};
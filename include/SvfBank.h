@@ -0,0 +1,51 @@
+#pragma once
+
+#include "Simd.h"
+
+// Zero-delay-feedback (TPT) state-variable filters, one per voice, stored structure-of-arrays
+// so a lane group of voices is filtered with one SIMD instruction stream.
+//
+// Buffers are frame-major across voices: sample n of voice v lives at n * MAX_VOICES + v.
+class SvfBank
+{
+public:
+    enum class Mode
+    {
+        Lowpass,
+        Bandpass,
+        Highpass
+    };
+
+    static constexpr unsigned int MAX_VOICES = 16;
+#if SYNTH_HAS_AVX
+    static constexpr unsigned int LANE_WIDTH = 8;
+#elif SYNTH_HAS_SSE2
+    static constexpr unsigned int LANE_WIDTH = 4;
+#else
+    static constexpr unsigned int LANE_WIDTH = 1;
+#endif
+    static constexpr unsigned int GROUP_COUNT = MAX_VOICES / LANE_WIDTH;
+
+    // Control-rate coefficient update; resonance runs from 0 (Q = 0.5) towards self-oscillation
+    void UpdateVoice(unsigned int voice, Mode mode, float cutoffHz, float resonance,
+                     double sampleRate);
+    void ResetVoice(unsigned int voice);
+
+    // Filters the voices whose bit is set in voiceMask in place; untouched lanes are skipped a
+    // whole group at a time
+    void Process(float* pVoices, unsigned int nFrames, unsigned int voiceMask);
+
+private:
+    alignas(32) float m_ic1[MAX_VOICES] = {};
+    alignas(32) float m_ic2[MAX_VOICES] = {};
+    alignas(32) float m_a1[MAX_VOICES] = {};
+    alignas(32) float m_a2[MAX_VOICES] = {};
+    alignas(32) float m_a3[MAX_VOICES] = {};
+    alignas(32) float m_k[MAX_VOICES] = {};
+    alignas(32) float m_lowGain[MAX_VOICES] = {};
+    alignas(32) float m_bandGain[MAX_VOICES] = {};
+    alignas(32) float m_highGain[MAX_VOICES] = {};
+
+    void ProcessGroupScalar(float* pVoices, unsigned int nFrames, unsigned int first,
+                            unsigned int count);
+};
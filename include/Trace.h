@@ -0,0 +1,114 @@
+#pragma once
+
+// Timeline trace scopes, exported as Chrome trace JSON for about:tracing or Perfetto, to see how
+// the GUI and audio threads interleave around a glitch. Without SYNTH_TRACE (CMake option of
+// the same name) every macro compiles to nothing. With it, a scope costs two clock reads and
+// one store into the calling thread's own ring; the rings are only read when exported.
+//
+//   SYNTH_TRACE_THREAD("Audio");      // At thread start: names the thread and allocates its
+//                                     // ring, which would otherwise happen at the first event
+//   SYNTH_TRACE_SCOPE("RenderBlock"); // Until the end of the enclosing block
+//   SYNTH_TRACE_INSTANT("KeyDown");
+//   SYNTH_TRACE_INSTANT_AT("WOM_DONE", ns); // Recorded later, stamped with an earlier Now()
+//
+// Names must be string literals: only the pointer is stored.
+
+#ifndef SYNTH_TRACE
+#define SYNTH_TRACE 0
+#endif
+
+#if SYNTH_TRACE
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+struct TraceEvent
+{
+    const char* name;
+    int64_t beginNs;
+    int64_t durationNs; // Negative for an instant event
+};
+
+// One thread's most recent events. Only the owning thread writes; an export copies the ring
+// and drops whatever the owner overwrote meanwhile, as ScopeRing readers do.
+class TraceBuffer
+{
+public:
+    static constexpr size_t CAPACITY = 1 << 15; // Events, a power of two
+    static constexpr unsigned int MAX_THREADS = 32; // Later threads' events are not exported
+
+    static int64_t Now()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                   std::chrono::steady_clock::now().time_since_epoch())
+            .count();
+    }
+
+    static TraceBuffer& ForThisThread()
+    {
+        thread_local TraceBuffer* t_buffer = Register();
+        return *t_buffer;
+    }
+
+    void SetName(const char* name)
+    {
+        m_name.store(name, std::memory_order_release);
+    }
+
+    void Record(const char* name, int64_t beginNs, int64_t durationNs)
+    {
+        uint64_t index = m_written.load(std::memory_order_relaxed);
+        m_events[index & (CAPACITY - 1)] = TraceEvent{name, beginNs, durationNs};
+        m_written.store(index + 1, std::memory_order_release);
+    }
+
+    // Any thread. Writes every thread's buffered events, oldest first.
+    static bool WriteChromeJson(const std::filesystem::path& path, std::string* error = nullptr);
+
+private:
+    TraceBuffer() = default;
+    static TraceBuffer* Register();
+    size_t CopyEvents(TraceEvent* pOut) const; // Returns how many are intact
+
+    std::unique_ptr<TraceEvent[]> m_events = std::make_unique<TraceEvent[]>(CAPACITY);
+    std::atomic<uint64_t> m_written{0};
+    std::atomic<const char*> m_name{nullptr};
+};
+
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* name) : m_name(name), m_beginNs(TraceBuffer::Now()) {}
+    ~TraceScope()
+    {
+        TraceBuffer::ForThisThread().Record(m_name, m_beginNs, TraceBuffer::Now() - m_beginNs);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_name;
+    int64_t m_beginNs;
+};
+
+#define SYNTH_TRACE_JOIN_INNER(a, b) a##b
+#define SYNTH_TRACE_JOIN(a, b) SYNTH_TRACE_JOIN_INNER(a, b)
+#define SYNTH_TRACE_SCOPE(name) TraceScope SYNTH_TRACE_JOIN(traceScope, __LINE__)(name)
+#define SYNTH_TRACE_INSTANT(name) \
+    TraceBuffer::ForThisThread().Record(name, TraceBuffer::Now(), -1)
+#define SYNTH_TRACE_INSTANT_AT(name, ns) TraceBuffer::ForThisThread().Record(name, ns, -1)
+#define SYNTH_TRACE_THREAD(name) TraceBuffer::ForThisThread().SetName(name)
+
+#else
+
+#define SYNTH_TRACE_SCOPE(name) ((void)0)
+#define SYNTH_TRACE_INSTANT(name) ((void)0)
+#define SYNTH_TRACE_INSTANT_AT(name, ns) ((void)0)
+#define SYNTH_TRACE_THREAD(name) ((void)0)
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <vector>
+
+// Decoded WAV audio as planar float channels in [-1, 1]
+struct WavData
+{
+    unsigned int sampleRate = 0;
+    std::vector<std::vector<float>> channels;
+
+    size_t GetFrameCount() const
+    {
+        return channels.empty() ? 0 : channels[0].size();
+    }
+};
+
+// Reads 16/24/32-bit integer PCM and 32-bit float WAV files, including WAVE_FORMAT_EXTENSIBLE
+bool LoadWav(const std::filesystem::path& path, WavData& out);
+
+// Writes 32-bit float WAV, so a render round-trips bit for bit
+bool SaveWav(const std::filesystem::path& path, const WavData& data);
+
+// The 44-byte header of a canonical WAV file, for writers that stream interleaved samples
+// after it. One that doesn't know the length yet passes 0 and calls UpdateWavSizes at the end.
+void WriteWavHeader(std::ostream& out, unsigned int sampleRate, unsigned int channels,
+                    unsigned int bitsPerSample, bool isFloat, uint32_t dataBytes);
+bool UpdateWavSizes(std::ostream& out, uint32_t dataBytes);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+
+// Records the blocks sent to the output device, interleaved 32-bit PCM, to a WAV file. The
+// render thread copies each block into a ring and returns; a writer thread drains the ring to
+// disk in large sequential writes. A block that doesn't fit because the disk has fallen behind
+// is dropped whole and counted, never waited for.
+class WavRecorder
+{
+public:
+    static constexpr size_t RING_SAMPLES = 1 << 21;  // About 20 s of 48 kHz stereo
+    static constexpr size_t WRITE_SAMPLES = 1 << 16; // 256 KB per write
+
+    WavRecorder() = default;
+    ~WavRecorder();
+    WavRecorder(const WavRecorder&) = delete;
+    WavRecorder& operator=(const WavRecorder&) = delete;
+
+    // GUI thread. Start fails if a recording is already running; Stop waits for the ring to
+    // drain, then writes the final sizes into the header.
+    bool Start(const std::filesystem::path& path, unsigned int sampleRate, unsigned int channels,
+               std::string* error = nullptr);
+    bool Stop(std::string* error = nullptr);
+    bool IsRecording() const
+    {
+        return m_recording.load(std::memory_order_relaxed);
+    }
+
+    // Render thread; returns at once when not recording. Blocks with a different channel
+    // count from Start's are ignored.
+    void Write(const int32_t* pFrames, unsigned int nChannels, unsigned int nFrames);
+
+    // Of the current or last recording
+    double GetRecordedSeconds() const;
+    uint64_t GetDroppedBlocks() const
+    {
+        return m_droppedBlocks.load(std::memory_order_relaxed);
+    }
+
+private:
+    void WriterLoop();
+    void WriteRun(size_t count); // Up to `count` samples from the head, without wrapping
+
+    std::unique_ptr<int32_t[]> m_ring;         // Allocated by the first Start
+    alignas(64) std::atomic<size_t> m_head{0}; // Writer's index, in samples
+    alignas(64) std::atomic<size_t> m_tail{0}; // Render thread's index
+    std::atomic<bool> m_recording{false};
+    std::atomic<unsigned int> m_activeWrites{0}; // Render thread calls inside Write
+    std::atomic<bool> m_stopping{false};
+    std::atomic<uint32_t> m_wake{0};
+    std::atomic<uint64_t> m_recordedFrames{0};
+    std::atomic<uint64_t> m_droppedBlocks{0};
+
+    // Writer thread while recording, GUI thread otherwise
+    std::ofstream m_file;
+    uint64_t m_dataBytes = 0;
+    bool m_writeFailed = false;
+
+    std::filesystem::path m_path;
+    unsigned int m_sampleRate = 0;
+    unsigned int m_channels = 0;
+    std::thread m_thread;
+};
@@ -2,27 +2,34 @@
 
 #pragma comment(lib, "winmm.lib")
 
+#include "AudioDevice.h"
+#include "Denormals.h"
+#include "Interleave.h"
+#include "ScratchArena.h"
+#include "Trace.h"
+
 #include <Windows.h>
+#include <algorithm>
 #include <atomic>
 #include <cmath>
 #include <condition_variable>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
 #include <string>
 #include <thread>
 #include <vector>
 
-constexpr double PI = 3.14159265358979323846;
-
 template <class T>
-class NoiseMaker
+class NoiseMaker : public AudioDevice
 {
 public:
     NoiseMaker(std::wstring sOutputDevice, unsigned int nSampleRate = 44100,
                unsigned int nChannels = 1, unsigned int nBlocks = 8,
-               unsigned int nBlockSamples = 512) // leave device name for user input
+               unsigned int nBlockSamples = 512, // leave device name for user input
+               size_t nScratchBytes = 1 << 20)
     {
-        Create(sOutputDevice, nSampleRate, nChannels, nBlocks, nBlockSamples);
+        Create(sOutputDevice, nSampleRate, nChannels, nBlocks, nBlockSamples, nScratchBytes);
     }
     ~NoiseMaker()
     {
@@ -42,7 +49,7 @@ public:
 
     bool Create(std::wstring sOutputDevice, unsigned int nSampleRate = 44100,
                 unsigned int nChannels = 1, unsigned int nBlocks = 8,
-                unsigned int nBlockSamples = 512)
+                unsigned int nBlockSamples = 512, size_t nScratchBytes = 1 << 20)
     {
         m_bReady = false;
         m_nSampleRate = nSampleRate;
@@ -55,6 +62,8 @@ public:
         m_pWaveHeaders = nullptr;
 
         m_userFunction = nullptr;
+        m_blockFunction = nullptr;
+        m_outputFunction = nullptr;
 
         std::vector<std::wstring> devices = GetDevices(); // get list of all devices
         auto d = std::find(
@@ -84,11 +93,12 @@ public:
             return false;
         }
 
-        // Allocate Wave|Block Memory
-        m_pBlockMemory = new T[m_nBlockCount * m_nBlockSamples];
+        // Allocate Wave|Block Memory, one interleaved frame of m_nChannels samples per block sample
+        unsigned int nBlockValues = m_nBlockSamples * m_nChannels;
+        m_pBlockMemory = new T[m_nBlockCount * nBlockValues];
         if (m_pBlockMemory == nullptr)
             return Destroy();
-        ZeroMemory(m_pBlockMemory, sizeof(T) * m_nBlockCount * m_nBlockSamples);
+        ZeroMemory(m_pBlockMemory, sizeof(T) * m_nBlockCount * nBlockValues);
 
         m_pWaveHeaders = new WAVEHDR[m_nBlockCount];
         if (m_pWaveHeaders == nullptr)
@@ -96,10 +106,17 @@ public:
         ZeroMemory(m_pWaveHeaders, sizeof(WAVEHDR) * m_nBlockCount);
         for (unsigned int n = 0; n < m_nBlockCount; n++)
         {
-            m_pWaveHeaders[n].dwBufferLength = m_nBlockSamples * sizeof(T);
-            m_pWaveHeaders[n].lpData = (LPSTR)(m_pBlockMemory + (n * m_nBlockSamples));
+            m_pWaveHeaders[n].dwBufferLength = nBlockValues * sizeof(T);
+            m_pWaveHeaders[n].lpData = (LPSTR)(m_pBlockMemory + (n * nBlockValues));
         }
 
+        // Planar render buffers, one per channel, interleaved into block memory by the kernel
+        m_planarMemory.assign(nBlockValues, 0.0f);
+        m_planarChannels.resize(m_nChannels);
+        for (unsigned int c = 0; c < m_nChannels; c++)
+            m_planarChannels[c] = m_planarMemory.data() + c * m_nBlockSamples;
+        m_scratch.Reserve(nScratchBytes);
+
         m_bReady = true;
 
         m_thread = std::thread(&NoiseMaker::MainThread, this);
@@ -130,11 +147,73 @@ public:
         return 0.0;
     }
 
+    // Renders one block into planar channel buffers. The default evaluates the per-sample
+    // function and copies it to every channel.
+    virtual void UserProcessBlock(float* const* ppChannels, unsigned int nChannels,
+                                  unsigned int nFrames, double dTime)
+    {
+        double dTimeStep = 1.0 / (double)m_nSampleRate;
+        for (unsigned int n = 0; n < nFrames; n++)
+        {
+            double dSampleTime = dTime + n * dTimeStep;
+            double dSample = m_userFunction == nullptr ? UserProcess(dSampleTime)
+                                                       : m_userFunction(dSampleTime);
+            ppChannels[0][n] = (float)dSample;
+        }
+        for (unsigned int c = 1; c < nChannels; c++)
+            std::copy(ppChannels[0], ppChannels[0] + nFrames, ppChannels[c]);
+    }
+
     double GetTime()
     {
         return m_dGlobalTime;
     }
 
+    unsigned int GetSampleRate() const override
+    {
+        return m_nSampleRate;
+    }
+
+    // False if the device refused the format, e.g. an unsupported sample rate
+    bool IsOpen() const
+    {
+        return m_bReady;
+    }
+
+    unsigned int GetChannels() const override
+    {
+        return m_nChannels;
+    }
+
+    unsigned int GetBlockSamples() const
+    {
+        return m_nBlockSamples;
+    }
+
+    // The device counter is 32 bits, hence the unwrapping
+    bool GetPlayedFrames(uint64_t nNearFrame, uint64_t& nPlayed) override
+    {
+        MMTIME time = {};
+        time.wType = TIME_SAMPLES;
+        if (waveOutGetPosition(m_hwDevice, &time, sizeof(time)) != S_OK ||
+            time.wType != TIME_SAMPLES)
+            return false;
+        int32_t nDelta = (int32_t)((uint32_t)nNearFrame - (uint32_t)time.u.sample);
+        nPlayed = nNearFrame - nDelta;
+        return true;
+    }
+
+    uint64_t GetUnderruns() const override
+    {
+        return m_nUnderruns.load(std::memory_order_relaxed);
+    }
+
+    // Per-block temporaries for the block function; rewound before every block
+    ScratchArena& GetScratch()
+    {
+        return m_scratch;
+    }
+
 public:
     static std::vector<std::wstring> GetDevices(){ // Use wstring to hold wide character strings for device names
 
@@ -152,6 +231,21 @@ public:
         m_userFunction = func;
     }
 
+    // Block callback: fills nChannels planar buffers of nFrames samples starting at dTime
+    void SetBlockFunction(void (*func)(float* const* ppChannels, unsigned int nChannels,
+                                       unsigned int nFrames, double dTime))
+    {
+        m_blockFunction = func;
+    }
+
+    // Output tap: sees each block exactly as it goes to the device, clipped, converted and
+    // interleaved. Called on the render thread, so it must not block.
+    void SetOutputFunction(void (*func)(const T* pFrames, unsigned int nChannels,
+                                        unsigned int nFrames))
+    {
+        m_outputFunction = func;
+    }
+
     double clip(double dSample, double dMax)
     {
         if (dSample >= 0.0)
@@ -162,6 +256,8 @@ public:
 
 private:
     double (*m_userFunction)(double);
+    void (*m_blockFunction)(float* const*, unsigned int, unsigned int, double);
+    void (*m_outputFunction)(const T*, unsigned int, unsigned int);
 
     unsigned int m_nSampleRate;
     unsigned int m_nChannels;
@@ -171,19 +267,31 @@ private:
 
     T* m_pBlockMemory;
     WAVEHDR* m_pWaveHeaders;
+    std::vector<float> m_planarMemory;
+    std::vector<float*> m_planarChannels;
+    ScratchArena m_scratch;
     HWAVEOUT m_hwDevice; // output device
 
     std::thread m_thread;
     bool m_bReady;
     std::atomic<unsigned int> m_nBlockFree;
+    std::atomic<uint64_t> m_nUnderruns{0};
     std::condition_variable m_cvBlockNotZero;
     std::mutex m_muxBlockNotZero;
 
     std::atomic<double> m_dGlobalTime;
+#if SYNTH_TRACE
+    // When the driver last finished a block. Recorded by the audio thread, so the driver's
+    // callback thread never allocates a trace ring or shows up as an unnamed track.
+    std::atomic<int64_t> m_lastBlockDoneNs{0};
+#endif
     void waveOutProc(HWAVEOUT hWaveOut, UINT uMsg, DWORD dwParam1, DWORD dwParam2)
     {
         if (uMsg != WOM_DONE)
             return;
+#if SYNTH_TRACE
+        m_lastBlockDoneNs.store(TraceBuffer::Now(), std::memory_order_relaxed);
+#endif
 
         m_nBlockFree++;
         std::unique_lock<std::mutex> lm(m_muxBlockNotZero);
@@ -196,43 +304,53 @@ private:
     }
     void MainThread()
     {
+        // Decaying tails must not fall into the slow denormal path on the render thread
+        ScopedFlushDenormals flushDenormals;
+        SYNTH_TRACE_THREAD("Audio");
         m_dGlobalTime = 0.0;
         double dTimeStep = 1.0 / (double)m_nSampleRate;
-
-        // Goofy hack to get maximum integer for a type at run-time
-        T nMaxSample = (T)pow(2, (sizeof(T) * 8) - 1) - 1;
-        double dMaxSample = (double)nMaxSample;
-        T nPreviousSample = 0;
+        uint64_t nBlocksWritten = 0;
 
         while (m_bReady)
         {
             if (m_nBlockFree == 0)
             {
+                SYNTH_TRACE_SCOPE("WaitForDevice");
                 std::unique_lock<std::mutex> lm(m_muxBlockNotZero);
                 m_cvBlockNotZero.wait(lm);
             }
-
+            SYNTH_TRACE_SCOPE("DeviceBlock");
+#if SYNTH_TRACE
+            // Completions since the last wake collapse into the latest one
+            if (int64_t doneNs = m_lastBlockDoneNs.exchange(0, std::memory_order_relaxed))
+                SYNTH_TRACE_INSTANT_AT("WOM_DONE", doneNs);
+#endif
+
+            // All blocks free once the first round has been queued means the device starved
+            if (nBlocksWritten >= m_nBlockCount && m_nBlockFree == m_nBlockCount)
+                m_nUnderruns.fetch_add(1, std::memory_order_relaxed);
             m_nBlockFree--;
             if (m_pWaveHeaders[m_nBlockCurrent].dwFlags & WHDR_PREPARED)
                 waveOutUnprepareHeader(m_hwDevice, &m_pWaveHeaders[m_nBlockCurrent],
                                        sizeof(WAVEHDR));
 
-            T nNewSample = 0;
-            int nCurrentBlock = m_nBlockCurrent * m_nBlockSamples;
+            T* pCurrentBlock = m_pBlockMemory + m_nBlockCurrent * m_nBlockSamples * m_nChannels;
+            float* const* ppChannels = m_planarChannels.data();
 
-            for (unsigned int n = 0; n < m_nBlockSamples; n++)
-            {
-                if (m_userFunction == nullptr)
-                    nNewSample = (T)(clip(UserProcess(m_dGlobalTime), 1.0) * dMaxSample);
-                else
-                    nNewSample = (T)(clip(m_userFunction(m_dGlobalTime), 1.0) * dMaxSample);
-
-                m_pBlockMemory[nCurrentBlock + n] = nNewSample;
-                nPreviousSample = nNewSample;
-                m_dGlobalTime = m_dGlobalTime + dTimeStep;
-            }
+            m_scratch.Reset();
+            if (m_blockFunction == nullptr)
+                UserProcessBlock(ppChannels, m_nChannels, m_nBlockSamples, m_dGlobalTime);
+            else
+                m_blockFunction(ppChannels, m_nChannels, m_nBlockSamples, m_dGlobalTime);
+
+            // Clip and convert the planar render into the device's interleaved format
+            Interleave<T>(ppChannels, m_nChannels, m_nBlockSamples, pCurrentBlock);
+            if (m_outputFunction != nullptr)
+                m_outputFunction(pCurrentBlock, m_nChannels, m_nBlockSamples);
+            m_dGlobalTime = m_dGlobalTime + m_nBlockSamples * dTimeStep;
             waveOutPrepareHeader(m_hwDevice, &m_pWaveHeaders[m_nBlockCurrent], sizeof(WAVEHDR));
             waveOutWrite(m_hwDevice, &m_pWaveHeaders[m_nBlockCurrent], sizeof(WAVEHDR));
+            nBlocksWritten++;
             m_nBlockCurrent++;
             m_nBlockCurrent %= m_nBlockCount;
         }
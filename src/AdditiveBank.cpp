@@ -0,0 +1,265 @@
+#include "AdditiveBank.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+using namespace simd;
+
+constexpr double ADDITIVE_TWO_PI = 6.28318530717958647692;
+constexpr float ENVELOPE_FLOOR = 0.001f; // -60 dB, where release time is measured
+constexpr float SILENCE_LEVEL = 1e-4f;   // A releasing envelope below this has finished
+constexpr unsigned int ORGAN_PARTIALS = 9; // Drawbars, 16' to 1'
+constexpr float ORGAN_RATIOS[ORGAN_PARTIALS] = {0.5f, 1.0f, 1.5f, 2.0f, 3.0f,
+                                                4.0f, 5.0f, 6.0f, 8.0f};
+constexpr float ORGAN_LEVELS[ORGAN_PARTIALS] = {0.5f, 0.8f, 0.4f, 0.6f, 0.3f,
+                                                0.3f, 0.2f, 0.15f, 0.2f};
+constexpr float STIFFNESS = 4e-4f; // Inharmonicity of the stiff string preset
+
+float SamplesFor(float ms, double sampleRate)
+{
+    return (float)std::max(1.0, ms * 0.001 * sampleRate);
+}
+} // namespace
+
+const char* const ADDITIVE_PRESET_NAMES[ADDITIVE_PRESETS] = {"Sawtooth", "Square", "Organ",
+                                                             "Stiff string"};
+
+AdditivePatch MakeAdditivePreset(unsigned int index, unsigned int partialCount)
+{
+    AdditivePatch patch = {};
+    patch.partialCount =
+        std::min(partialCount, index == 2 ? ORGAN_PARTIALS : ADDITIVE_MAX_PARTIALS);
+    patch.attackMs = 5.0f;
+    patch.releaseMs = 300.0f;
+    // Levels are scaled so that a full series peaks near 1, Gibbs overshoot included
+    for (unsigned int k = 0; k < patch.partialCount; k++)
+    {
+        float harmonic = (float)(k + 1);
+        switch (index)
+        {
+        case 1:
+            patch.ratios[k] = 2.0f * k + 1.0f;
+            patch.amplitudes[k] = 1.08f / patch.ratios[k];
+            break;
+        case 2:
+            patch.ratios[k] = ORGAN_RATIOS[k];
+            patch.amplitudes[k] = ORGAN_LEVELS[k] / 3.45f;
+            break;
+        case 3:
+            patch.ratios[k] = harmonic * sqrtf(1.0f + STIFFNESS * harmonic * harmonic);
+            patch.amplitudes[k] = 0.5f / (harmonic * sqrtf(harmonic));
+            break;
+        default:
+            patch.ratios[k] = harmonic;
+            patch.amplitudes[k] = 0.55f / harmonic;
+            break;
+        }
+    }
+    if (index == 3)
+    {
+        patch.attackMs = 1.0f;
+        patch.releaseMs = 1500.0f;
+    }
+    return patch;
+}
+
+AdditiveBank::AdditiveBank() : m_oscillators(std::make_unique<Oscillators[]>(MAX_VOICES))
+{
+}
+
+void AdditiveBank::NoteOn(unsigned int voice, double freq)
+{
+    m_freq[voice] = freq;
+    m_stage[voice] = Stage::Attack;
+    m_oscillators[voice].stale = true;
+    m_oscillators[voice].restart = true;
+    m_soundingMask |= 1u << voice;
+}
+
+void AdditiveBank::NoteOff(unsigned int voice)
+{
+    if (m_stage[voice] != Stage::Idle)
+        m_stage[voice] = Stage::Release;
+}
+
+void AdditiveBank::Silence()
+{
+    for (unsigned int v = 0; v < MAX_VOICES; v++)
+    {
+        m_stage[v] = Stage::Idle;
+        m_envelope[v] = 0.0f;
+        Oscillators& o = m_oscillators[v];
+        std::fill(o.amplitude, o.amplitude + ADDITIVE_MAX_PARTIALS, 0.0f);
+    }
+    m_soundingMask = 0;
+}
+
+void AdditiveBank::PatchChanged()
+{
+    for (unsigned int v = 0; v < MAX_VOICES; v++)
+        m_oscillators[v].stale = true;
+}
+
+unsigned int AdditiveBank::GetPartialCount(unsigned int voice) const
+{
+    return m_oscillators[voice].count;
+}
+
+void AdditiveBank::Tune(unsigned int voice, const AdditivePatch& patch, double sampleRate)
+{
+    Oscillators& o = m_oscillators[voice];
+    // Where each patch partial sits now, so survivors keep their phase and level
+    int16_t slotOf[ADDITIVE_MAX_PARTIALS];
+    std::fill(std::begin(slotOf), std::end(slotOf), (int16_t)-1);
+    if (!o.restart)
+    {
+        for (unsigned int i = 0; i < o.count; i++)
+            slotOf[o.partial[i]] = (int16_t)i;
+    }
+
+    float previousCos[ADDITIVE_MAX_PARTIALS];
+    float previousSin[ADDITIVE_MAX_PARTIALS];
+    float previousAmplitude[ADDITIVE_MAX_PARTIALS];
+    std::copy(o.cos, o.cos + o.count, previousCos);
+    std::copy(o.sin, o.sin + o.count, previousSin);
+    std::copy(o.amplitude, o.amplitude + o.count, previousAmplitude);
+
+    const unsigned int partials = std::min(patch.partialCount, ADDITIVE_MAX_PARTIALS);
+    const double nyquist = 0.5 * sampleRate;
+    unsigned int count = 0;
+    for (unsigned int k = 0; k < partials; k++)
+    {
+        double freq = m_freq[voice] * patch.ratios[k];
+        if (freq <= 0.0 || freq >= nyquist)
+            continue;
+        double omega = ADDITIVE_TWO_PI * freq / sampleRate;
+        o.rotationCos[count] = (float)cos(omega);
+        o.rotationSin[count] = (float)sin(omega);
+        o.partial[count] = (uint16_t)k;
+        int slot = slotOf[k];
+        o.cos[count] = slot >= 0 ? previousCos[slot] : 1.0f;
+        o.sin[count] = slot >= 0 ? previousSin[slot] : 0.0f;
+        o.amplitude[count] = slot >= 0 ? previousAmplitude[slot] : 0.0f;
+        count++;
+    }
+    o.count = count;
+    o.paddedCount = (count + LANES - 1) / LANES * LANES;
+    for (unsigned int i = count; i < o.paddedCount; i++)
+    {
+        o.cos[i] = o.sin[i] = o.rotationSin[i] = o.amplitude[i] = 0.0f;
+        o.rotationCos[i] = 1.0f;
+    }
+    o.stale = false;
+    o.restart = false;
+}
+
+bool AdditiveBank::AdvanceEnvelope(unsigned int voice, const AdditivePatch& patch,
+                                   double sampleRate, unsigned int nSamples)
+{
+    float& envelope = m_envelope[voice];
+    Stage& stage = m_stage[voice];
+    if (stage == Stage::Attack)
+    {
+        envelope += nSamples / SamplesFor(patch.attackMs, sampleRate);
+        if (envelope >= 1.0f)
+        {
+            envelope = 1.0f;
+            stage = Stage::Hold;
+        }
+    }
+    else if (stage == Stage::Release)
+    {
+        envelope *= powf(ENVELOPE_FLOOR, nSamples / SamplesFor(patch.releaseMs, sampleRate));
+        if (envelope < SILENCE_LEVEL)
+        {
+            envelope = 0.0f;
+            stage = Stage::Idle;
+        }
+    }
+    return stage != Stage::Idle;
+}
+
+unsigned int AdditiveBank::Render(const AdditivePatch& patch, float* pVoices,
+                                  unsigned int nFrames, double sampleRate, float gain)
+{
+    if (sampleRate != m_sampleRate)
+    {
+        m_sampleRate = sampleRate;
+        PatchChanged();
+    }
+    const unsigned int written = m_soundingMask;
+    for (unsigned int v = 0; v < MAX_VOICES; v++)
+    {
+        if (!((written >> v) & 1))
+            continue;
+        if (m_oscillators[v].stale)
+            Tune(v, patch, sampleRate);
+        RenderVoice(v, patch, pVoices + v, nFrames, sampleRate, gain);
+    }
+    return written;
+}
+
+void AdditiveBank::RenderVoice(unsigned int voice, const AdditivePatch& patch, float* pOut,
+                               unsigned int nFrames, double sampleRate, float gain)
+{
+    Oscillators& o = m_oscillators[voice];
+    alignas(32) float targets[ADDITIVE_MAX_PARTIALS];
+    alignas(32) float steps[ADDITIVE_MAX_PARTIALS];
+    for (unsigned int start = 0; start < nFrames; start += CONTROL_INTERVAL)
+    {
+        const unsigned int length = std::min(CONTROL_INTERVAL, nFrames - start);
+
+        // Control rate: every partial's level at the end of this stretch, from the patch
+        bool sounding = AdvanceEnvelope(voice, patch, sampleRate, length);
+        float scale = m_envelope[voice] * gain;
+        for (unsigned int i = 0; i < o.count; i++)
+        {
+            targets[i] = patch.amplitudes[o.partial[i]] * scale;
+            steps[i] = (targets[i] - o.amplitude[i]) / length;
+        }
+        std::fill(targets + o.count, targets + o.paddedCount, 0.0f);
+        std::fill(steps + o.count, steps + o.paddedCount, 0.0f);
+
+        // One lane group of partials at a time through the whole stretch, so each group's
+        // state stays in registers; the per-sample sums collect in sums[]
+        Lanes sums[CONTROL_INTERVAL];
+        for (unsigned int n = 0; n < length; n++)
+            sums[n] = Splat(0.0f);
+        for (unsigned int i = 0; i < o.paddedCount; i += LANES)
+        {
+            Lanes c = Load(o.cos + i);
+            Lanes s = Load(o.sin + i);
+            const Lanes rotationCos = Load(o.rotationCos + i);
+            const Lanes rotationSin = Load(o.rotationSin + i);
+            Lanes amplitude = Load(o.amplitude + i);
+            const Lanes step = Load(steps + i);
+            for (unsigned int n = 0; n < length; n++)
+            {
+                Lanes nextCos = Sub(Mul(c, rotationCos), Mul(s, rotationSin));
+                s = Add(Mul(c, rotationSin), Mul(s, rotationCos));
+                c = nextCos;
+                amplitude = Add(amplitude, step);
+                sums[n] = Add(sums[n], Mul(s, amplitude));
+            }
+            // Rounding slowly changes the magnitude; pull it back towards 1
+            Lanes correction = Sub(Splat(1.5f), Mul(Splat(0.5f), Add(Mul(c, c), Mul(s, s))));
+            Store(o.cos + i, Mul(c, correction));
+            Store(o.sin + i, Mul(s, correction));
+        }
+        std::copy(targets, targets + o.paddedCount, o.amplitude);
+        for (unsigned int n = 0; n < length; n++)
+            pOut[(size_t)(start + n) * MAX_VOICES] = Sum(sums[n]);
+
+        if (!sounding)
+        {
+            m_soundingMask &= ~(1u << voice);
+            // The rest of the block is silent
+            for (unsigned int n = start + length; n < nFrames; n++)
+                pOut[(size_t)n * MAX_VOICES] = 0.0f;
+            return;
+        }
+    }
+}
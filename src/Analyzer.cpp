@@ -0,0 +1,98 @@
+#include "Analyzer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr double ANALYZER_PI = 3.14159265358979323846;
+}
+
+void DecimateMinMax(const float* pIn, size_t count, unsigned int columns, float* pMin,
+                    float* pMax)
+{
+    for (unsigned int c = 0; c < columns; c++)
+    {
+        size_t begin = count * c / columns;
+        size_t end = std::max(count * (c + 1) / columns, begin + 1);
+        float lo = pIn[std::min(begin, count - 1)];
+        float hi = lo;
+        for (size_t n = begin; n < end && n < count; n++)
+        {
+            lo = std::min(lo, pIn[n]);
+            hi = std::max(hi, pIn[n]);
+        }
+        pMin[c] = lo;
+        pMax[c] = hi;
+    }
+}
+
+void SpectrumAnalyzer::Prepare(unsigned int fftSize, double sampleRate, unsigned int columns)
+{
+    m_fft.Prepare(fftSize);
+    m_sampleRate = sampleRate;
+
+    // Hann window, scaled so a full-scale sine reads 0 dBFS at its peak bin
+    m_window.resize(fftSize);
+    for (unsigned int n = 0; n < fftSize; n++)
+        m_window[n] = (float)(0.5 - 0.5 * cos(2.0 * ANALYZER_PI * n / fftSize));
+    float scale = 4.0f / fftSize;
+    for (float& w : m_window)
+        w *= scale;
+
+    m_windowed.assign(fftSize, 0.0f);
+    m_re.assign(m_fft.GetBinCount(), 0.0f);
+    m_im.assign(m_fft.GetBinCount(), 0.0f);
+    m_binDb.assign(m_fft.GetBinCount(), MIN_DB);
+    m_columnsDb.assign(columns, MIN_DB);
+}
+
+float SpectrumAnalyzer::GetColumnFrequency(unsigned int column) const
+{
+    double nyquist = m_sampleRate * 0.5;
+    return (float)(MIN_FREQ * pow(nyquist / MIN_FREQ, (double)column / m_columnsDb.size()));
+}
+
+bool SpectrumAnalyzer::IsSettled() const
+{
+    return std::all_of(m_columnsDb.begin(), m_columnsDb.end(),
+                       [](float db) { return db <= MIN_DB; });
+}
+
+void SpectrumAnalyzer::Update(const float* pIn, float elapsedSeconds)
+{
+    const unsigned int size = m_fft.GetSize();
+    for (unsigned int n = 0; n < size; n++)
+        m_windowed[n] = pIn[n] * m_window[n];
+    m_fft.Forward(m_windowed.data(), m_re.data(), m_im.data());
+
+    for (size_t k = 0; k < m_binDb.size(); k++)
+    {
+        float power = m_re[k] * m_re[k] + m_im[k] * m_im[k];
+        m_binDb[k] = std::max(10.0f * log10f(power + 1e-20f), MIN_DB);
+    }
+
+    // Low columns span less than a bin and interpolate; high columns take their loudest bin
+    const double binHz = m_sampleRate / size;
+    const size_t lastBin = m_binDb.size() - 1;
+    float fall = FALL_DB_PER_SECOND * elapsedSeconds;
+    for (unsigned int c = 0; c < m_columnsDb.size(); c++)
+    {
+        double lowBin = GetColumnFrequency(c) / binHz;
+        double highBin = GetColumnFrequency(c + 1) / binHz;
+        size_t first = std::min((size_t)lowBin, lastBin);
+        size_t last = std::min((size_t)highBin, lastBin);
+        float level;
+        if (last <= first)
+        {
+            float frac = (float)(lowBin - first);
+            size_t next = std::min(first + 1, lastBin);
+            level = m_binDb[first] + (m_binDb[next] - m_binDb[first]) * frac;
+        }
+        else
+        {
+            level = *std::max_element(m_binDb.begin() + first, m_binDb.begin() + last + 1);
+        }
+        m_columnsDb[c] = std::max(level, m_columnsDb[c] - fall);
+    }
+}
@@ -3,9 +3,30 @@
 #include "AudioManager.h"
 #include "D3DManager.h"
 #include "GuiManager.h"
+#include "KeyboardInput.h"
+#include "SampleStreamer.h"
+#include "Trace.h"
 
 #include <imgui_impl_win32.h>
 
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <system_error>
+
+constexpr unsigned int ANALYZER_FFT_SIZE = 4096;
+constexpr unsigned int ANALYZER_COLUMNS = 256;
+constexpr unsigned int SCOPE_FRAMES = 2048; // About 46 ms at 44.1 kHz
+constexpr unsigned int SCOPE_MAX_COLUMNS = 2048;
+constexpr float ANALYZER_HEIGHT = 90.0f;
+constexpr unsigned int SCOPE_PROBE_FRAMES = 256;
+constexpr float SCOPE_SILENCE = 1e-5f;
+constexpr int UI_SETTLE_FRAMES = 4; // Lets ImGui finish hover and focus changes after input
+constexpr DWORD IDLE_POLL_MS = 100; // How often an idle loop checks for new scope signal
+constexpr wchar_t PRESET_BANK_PATH[] = L"presets.bin";
+
 extern IMGUI_IMPL_API LRESULT ImGui_ImplWin32_WndProcHandler(HWND hWnd, UINT msg, WPARAM wParam,
                                                              LPARAM lParam);
 
@@ -49,6 +70,20 @@ bool App::Initialize()
         return false;
     }
 
+    // Falls back to the window's key messages when Raw Input can't be registered
+    m_keyboardInput = std::make_unique<KeyboardInput>();
+    if (!m_keyboardInput->Start(m_audioManager.get(), m_hWnd))
+        m_keyboardInput.reset();
+
+    // A missing bank just means no presets yet; importing text creates one
+    m_presets.Open(PRESET_BANK_PATH);
+
+    m_analyzer.Prepare(ANALYZER_FFT_SIZE, m_audioManager->GetSampleRate(), ANALYZER_COLUMNS);
+    m_scopeLeft.assign(ANALYZER_FFT_SIZE, 0.0f);
+    m_scopeRight.assign(ANALYZER_FFT_SIZE, 0.0f);
+    m_scopeMono.assign(ANALYZER_FFT_SIZE, 0.0f);
+    m_scopeMin.assign(SCOPE_MAX_COLUMNS, 0.0f);
+    m_scopeMax.assign(SCOPE_MAX_COLUMNS, 0.0f);
     return true;
 }
 
@@ -56,10 +91,23 @@ void App::Run()
 {
     ::ShowWindow(m_hWnd, SW_SHOWDEFAULT);
     ::UpdateWindow(m_hWnd);
+    SYNTH_TRACE_THREAD("GUI");
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point nextFrame = Clock::now();
+    m_cpuSampleStart = nextFrame;
+    m_uiFramesPending = UI_SETTLE_FRAMES;
 
     bool done = false;
     while (!done)
     {
+        // Sleep until a message arrives, the next frame is due or, when idle, the next poll
+        bool dirty = !m_idleWhenQuiet || m_uiFramesPending > 0 || HasScopeActivity();
+        auto untilFrame = std::chrono::ceil<std::chrono::milliseconds>(nextFrame - Clock::now());
+        DWORD timeout = dirty ? (DWORD)std::max<long long>(untilFrame.count(), 0) : IDLE_POLL_MS;
+        if (timeout > 0)
+            ::MsgWaitForMultipleObjects(0, nullptr, FALSE, timeout, QS_ALLINPUT);
+
         MSG msg;
         while (::PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE))
         {
@@ -67,9 +115,19 @@ void App::Run()
             ::DispatchMessage(&msg);
             if (msg.message == WM_QUIT)
                 done = true;
+            m_uiFramesPending = UI_SETTLE_FRAMES;
         }
         if (done)
             break;
+
+        UpdateGuiCpuUsage();
+        if (m_idleWhenQuiet && m_uiFramesPending == 0 && !HasScopeActivity())
+            continue;
+        Clock::time_point now = Clock::now();
+        if (now < nextFrame)
+            continue;
+        // The cap is measured from the frame's start so a slow frame is not made up for later
+        nextFrame = now + std::chrono::microseconds(1000000 / std::max(m_maxFps, 1));
         if (m_d3dManager->IsDeviceLost())
         {
             HRESULT hr = m_d3dManager->TestDeviceCooperativeLevel();
@@ -90,35 +148,572 @@ void App::Run()
             m_d3dManager->ResetDevice();
             m_d3dManager->ClearResizeFlags();
         }
-        m_guiManager->NewFrame();
-        if (ImGui::Begin("Synthesizer Control", nullptr))
         {
-            if (ImGui::Button("Sine Wave"))
-            {
-                m_audioManager->SetWaveType(AudioManager::WaveType::Sine);
-            }
-            ImGui::SameLine();
-            if (ImGui::Button("Square Wave"))
-            {
-                m_audioManager->SetWaveType(AudioManager::WaveType::Square);
-            }
+            SYNTH_TRACE_SCOPE("NewFrame");
+            m_guiManager->NewFrame();
+        }
+        // Every drawn frame, even with the control panel collapsed, so the idle mode can tell
+        // when the output has gone quiet
+        UpdateAnalyzer();
+        {
+            SYNTH_TRACE_SCOPE("DrawControlPanel");
+            DrawControlPanel();
+        }
+        {
+            SYNTH_TRACE_SCOPE("Render");
+            m_guiManager->Render(m_d3dManager->GetDevice(), m_d3dManager->GetClearColor());
+        }
+        HRESULT result;
+        {
+            SYNTH_TRACE_SCOPE("Present");
+            result = m_d3dManager->Present();
         }
-        ImGui::End();
-        m_guiManager->Render(m_d3dManager->GetDevice(), m_d3dManager->GetClearColor());
-        HRESULT result = m_d3dManager->Present();
         if (result == D3DERR_DEVICELOST)
             m_d3dManager->SetDeviceLostFlag(true);
+        if (m_uiFramesPending > 0)
+            m_uiFramesPending--;
+        m_framesSinceSample++;
+    }
+}
+
+bool App::HasScopeActivity() const
+{
+    // A quiet output still needs drawing until the trace and spectrum have decayed to silence
+    if (!m_scopeSettled)
+        return true;
+    float left[SCOPE_PROBE_FRAMES];
+    float right[SCOPE_PROBE_FRAMES];
+    if (!m_audioManager->GetScope().ReadLatest(left, right, SCOPE_PROBE_FRAMES))
+        return false;
+    for (unsigned int n = 0; n < SCOPE_PROBE_FRAMES; n++)
+    {
+        if (fabsf(left[n]) > SCOPE_SILENCE || fabsf(right[n]) > SCOPE_SILENCE)
+            return true;
     }
+    return false;
+}
+
+void App::UpdateGuiCpuUsage()
+{
+    auto now = std::chrono::steady_clock::now();
+    std::chrono::duration<double> elapsed = now - m_cpuSampleStart;
+    if (elapsed.count() < 1.0)
+        return;
+
+    FILETIME creation, exit, kernel, user;
+    if (!::GetThreadTimes(::GetCurrentThread(), &creation, &exit, &kernel, &user))
+        return;
+    uint64_t threadTime = (((uint64_t)kernel.dwHighDateTime << 32) | kernel.dwLowDateTime) +
+                          (((uint64_t)user.dwHighDateTime << 32) | user.dwLowDateTime);
+
+    m_guiCpuLoad = (threadTime - m_cpuSampleThreadTime) * 1e-7 / elapsed.count();
+    if (!m_cpuSampleMixed)
+        m_guiCpuLoadByMode[m_idleWhenQuiet] = m_guiCpuLoad;
+    m_cpuSampleMixed = false;
+    m_guiFps = m_framesSinceSample / elapsed.count();
+    m_cpuSampleThreadTime = threadTime;
+    m_cpuSampleStart = now;
+    m_framesSinceSample = 0;
 }
 
 void App::Shutdown()
 {
+    m_keyboardInput.reset();
     m_audioManager->Shutdown();
     m_guiManager->Shutdown();
     m_d3dManager->Shutdown();
     CleanupAppWindow();
 }
 
+void App::DrawControlPanel()
+{
+    if (ImGui::Begin("Synthesizer Control", nullptr))
+    {
+        if (ImGui::Button("Sine Wave"))
+        {
+            m_audioManager->SetWaveType(AudioManager::WaveType::Sine);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Square Wave"))
+        {
+            m_audioManager->SetWaveType(AudioManager::WaveType::Square);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Sampler"))
+        {
+            m_audioManager->SetWaveType(AudioManager::WaveType::Sampler);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("FM"))
+        {
+            m_audioManager->SetWaveType(AudioManager::WaveType::Fm);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Additive"))
+        {
+            m_audioManager->SetWaveType(AudioManager::WaveType::Additive);
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Spectral"))
+        {
+            m_audioManager->SetWaveType(AudioManager::WaveType::Spectral);
+        }
+        ImGui::InputText("Sample folder", m_samplePath, sizeof(m_samplePath));
+        if (ImGui::Button("Load samples"))
+        {
+            if (m_audioManager->LoadSampleInstrument(m_samplePath, &m_sampleStatus))
+            {
+                char status[64];
+                snprintf(status, sizeof(status), "%zu zones (%zu streamed), %.1f MB mapped",
+                         m_audioManager->GetSampleZoneCount(),
+                         m_audioManager->GetStreamedZoneCount(),
+                         m_audioManager->GetSampleBytes() / (1024.0 * 1024.0));
+                m_sampleStatus = status;
+            }
+        }
+        if (!m_sampleStatus.empty())
+        {
+            ImGui::SameLine();
+            ImGui::TextUnformatted(m_sampleStatus.c_str());
+        }
+        const char* interpolations[] = {"Cubic", "Sinc (draft)", "Sinc (normal)", "Sinc (high)"};
+        if (ImGui::Combo("Interpolation", &m_samplerInterpolation, interpolations, 4))
+        {
+            m_audioManager->SetSamplerInterpolation(
+                (SamplerInterpolation)m_samplerInterpolation);
+        }
+        if (m_audioManager->GetSampleStreamer())
+        {
+            if (ImGui::SliderFloat("Slow disk", &m_streamDiskDelayMs, 0.0f, 50.0f,
+                                   "%.1f ms per chunk"))
+                m_audioManager->SetStreamDiskDelay(m_streamDiskDelayMs);
+        }
+        DrawFmPatch();
+        DrawAdditivePatch();
+        DrawSpectralPatch();
+
+        ImGui::Separator();
+        ImGui::Text("Oversampling");
+        const char* oversamplingLabels[] = {"1x", "2x", "4x", "8x"};
+        const int oversamplingFactors[] = {1, 2, 4, 8};
+        for (int i = 0; i < 4; i++)
+        {
+            ImGui::SameLine();
+            if (ImGui::RadioButton(oversamplingLabels[i], &m_oversampling, oversamplingFactors[i]))
+            {
+                m_audioManager->SetOversampling((unsigned int)m_oversampling);
+            }
+        }
+        if (ImGui::SliderFloat("Drive", &m_drive, 0.0f, 1.0f))
+        {
+            m_audioManager->SetDrive(m_drive);
+        }
+
+        ImGui::Separator();
+        const char* filterModes[] = {"Off", "Lowpass", "Bandpass", "Highpass"};
+        bool filterChanged = ImGui::Combo("Filter", &m_filterMode, filterModes, 4);
+        filterChanged |= ImGui::SliderFloat("Cutoff", &m_filterCutoff, 20.0f, 20000.0f, "%.0f Hz");
+        filterChanged |= ImGui::SliderFloat("Resonance", &m_filterResonance, 0.0f, 1.0f);
+        if (filterChanged)
+        {
+            m_audioManager->SetFilter((AudioManager::FilterMode)m_filterMode, m_filterCutoff,
+                                      m_filterResonance);
+        }
+
+        ImGui::Separator();
+        const char* masterGraphs[] = {"Direct", "Envelope filter", "Tremolo"};
+        if (ImGui::Combo("Master graph", &m_masterGraph, masterGraphs, 3))
+        {
+            DspGraph graph = m_masterGraph == 2   ? MakeTremoloGraph()
+                             : m_masterGraph == 1 ? MakeEnvelopeFilterGraph()
+                                                  : MakeDirectGraph();
+            m_audioManager->SetMasterGraph(graph);
+        }
+        bool effectsChanged = ImGui::Checkbox("Delay", &m_effects.delayEnabled);
+        ImGui::SameLine();
+        effectsChanged |= ImGui::Checkbox("Sync", &m_effects.delaySync);
+        if (m_effects.delaySync)
+        {
+            effectsChanged |=
+                ImGui::SliderFloat("Tempo", &m_effects.tempoBpm, 40.0f, 240.0f, "%.0f BPM");
+            effectsChanged |= ImGui::SliderFloat("Beats", &m_effects.delayBeats, 0.125f, 2.0f);
+        }
+        else
+        {
+            effectsChanged |=
+                ImGui::SliderFloat("Time", &m_effects.delayMs, 1.0f, 2000.0f, "%.0f ms");
+        }
+        effectsChanged |= ImGui::SliderFloat("Feedback", &m_effects.delayFeedback, 0.0f, 0.95f);
+        effectsChanged |= ImGui::SliderFloat("Ping-pong", &m_effects.delayPingPong, 0.0f, 1.0f);
+        effectsChanged |= ImGui::SliderFloat("Delay mix", &m_effects.delayMix, 0.0f, 1.0f);
+        effectsChanged |= ImGui::Checkbox("Reverb", &m_effects.reverbEnabled);
+        effectsChanged |= ImGui::SliderFloat("Size", &m_effects.reverbSize, 0.0f, 1.0f);
+        effectsChanged |=
+            ImGui::SliderFloat("Decay", &m_effects.reverbDecay, 0.1f, 10.0f, "%.1f s");
+        effectsChanged |= ImGui::SliderFloat("Damping", &m_effects.reverbDamping, 0.0f, 1.0f);
+        effectsChanged |= ImGui::SliderFloat("Reverb mix", &m_effects.reverbMix, 0.0f, 1.0f);
+
+        ImGui::InputText("Impulse response", m_irPath, sizeof(m_irPath));
+        if (ImGui::Button("Load IR"))
+        {
+            m_irLoadFailed = !m_audioManager->LoadImpulseResponse(m_irPath);
+        }
+        if (m_irLoadFailed)
+        {
+            ImGui::SameLine();
+            ImGui::Text("Could not load WAV");
+        }
+        effectsChanged |= ImGui::Checkbox("Convolution", &m_effects.convolutionEnabled);
+        effectsChanged |= ImGui::SliderFloat("IR mix", &m_effects.convolutionMix, 0.0f, 1.0f);
+        if (effectsChanged)
+        {
+            m_audioManager->SetEffects(m_effects);
+        }
+
+        ImGui::Separator();
+        DrawPresets();
+
+        ImGui::Separator();
+        DrawRecorder();
+
+        ImGui::Separator();
+        DrawAnalyzer();
+
+        ImGui::Separator();
+        if (ImGui::Checkbox("Idle when quiet", &m_idleWhenQuiet))
+            m_cpuSampleMixed = true;
+        ImGui::SliderInt("Frame cap", &m_maxFps, 10, 240, "%d fps");
+        ImGui::Text("GUI thread: %.0f fps, %.1f%% of a core", m_guiFps, 100.0 * m_guiCpuLoad);
+        // The saving is the difference between the last samples taken in each mode
+        if (m_guiCpuLoadByMode[0] >= 0.0 && m_guiCpuLoadByMode[1] >= 0.0)
+        {
+            ImGui::Text("Idle mode saves %.1f%% of a core (%.1f%% off, %.1f%% on)",
+                        100.0 * (m_guiCpuLoadByMode[0] - m_guiCpuLoadByMode[1]),
+                        100.0 * m_guiCpuLoadByMode[0], 100.0 * m_guiCpuLoadByMode[1]);
+        }
+        else
+        {
+            ImGui::Text("Idle mode saving: toggle it to measure");
+        }
+        const RenderStats& stats = m_audioManager->GetRenderStats();
+        ImGui::Text("DSP load: %.1f%%", 100.0 * m_audioManager->GetDspLoad());
+        if (m_audioManager->GetDeviceSampleRate() != m_audioManager->GetSampleRate())
+        {
+            ImGui::Text("Device: %u Hz, resampled from %.0f Hz",
+                        m_audioManager->GetDeviceSampleRate(), m_audioManager->GetSampleRate());
+        }
+        ImGui::Text("Block: %.3f ms (peak %.3f ms)", stats.GetAverageMs(RenderStage::Total),
+                    stats.GetPeakMs(RenderStage::Total));
+        ImGui::Text("Voices: %.3f ms", stats.GetAverageMs(RenderStage::Voices));
+        ImGui::Text("Filter: %.3f ms", stats.GetAverageMs(RenderStage::Filter));
+        ImGui::Text("Oversampling: %.3f ms", stats.GetAverageMs(RenderStage::Oversampling));
+        ImGui::Text("Master graph: %.3f ms", stats.GetAverageMs(RenderStage::Graph));
+        DrawLatency();
+#if SYNTH_TRACE
+        if (ImGui::Button("Save trace"))
+        {
+            if (TraceBuffer::WriteChromeJson("trace.json", &m_traceStatus))
+                m_traceStatus = "Wrote trace.json; open it in about:tracing or Perfetto";
+        }
+        ImGui::SameLine();
+        ImGui::TextUnformatted(m_traceStatus.c_str());
+#endif
+        ImGui::Text("Scratch: %.0f of %.0f KB at peak",
+                    m_audioManager->GetScratchHighWater() / 1024.0,
+                    m_audioManager->GetScratchCapacity() / 1024.0);
+        ImGui::Text("Convolution: %.3f ms (tail %.3f ms per partition, %u late)",
+                    stats.GetAverageMs(RenderStage::Convolution),
+                    m_audioManager->GetConvolutionTailMs(),
+                    m_audioManager->GetConvolutionTailMisses());
+        if (SampleStreamer* streamer = m_audioManager->GetSampleStreamer())
+        {
+            ImGui::Text("Streaming: %.2f%% hits, %llu starved, lead %.0f ms min / %.0f ms avg",
+                        streamer->GetHitRate() * 100.0,
+                        (unsigned long long)streamer->GetStarvations(),
+                        streamer->GetMinLeadMs(), streamer->GetAverageLeadMs());
+            ImGui::SameLine();
+            if (ImGui::Button("Reset##stream"))
+                streamer->ResetStats();
+        }
+    }
+    ImGui::End();
+}
+
+void App::DrawFmPatch()
+{
+    if (!ImGui::CollapsingHeader("FM operators"))
+        return;
+    bool changed = false;
+    if (ImGui::Combo("FM preset", &m_fmPreset, FM_PRESET_NAMES, FM_PRESETS))
+    {
+        m_fmPatch = MakeFmPreset((unsigned int)m_fmPreset);
+        changed = true;
+    }
+    int algorithm = (int)m_fmPatch.algorithm;
+    if (ImGui::Combo("Algorithm", &algorithm, FM_ALGORITHM_NAMES, FM_ALGORITHMS))
+    {
+        m_fmPatch.algorithm = (unsigned int)algorithm;
+        changed = true;
+    }
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+    {
+        // Operators share slider labels, so each gets its own ID scope
+        FmOperator& settings = m_fmPatch.operators[op];
+        ImGui::PushID((int)op);
+        ImGui::Text("Operator %u", op + 1);
+        changed |= ImGui::SliderFloat("Ratio", &settings.ratio, 0.5f, 16.0f, "%.3f");
+        changed |= ImGui::SliderFloat("Level", &settings.level, 0.0f, 1.0f);
+        changed |= ImGui::SliderFloat("Feedback", &settings.feedback, 0.0f, 1.0f);
+        changed |= ImGui::SliderFloat("Attack", &settings.attackMs, 0.0f, 2000.0f, "%.0f ms");
+        changed |= ImGui::SliderFloat("Decay", &settings.decayMs, 1.0f, 10000.0f, "%.0f ms");
+        changed |= ImGui::SliderFloat("Sustain", &settings.sustain, 0.0f, 1.0f);
+        changed |= ImGui::SliderFloat("Release", &settings.releaseMs, 1.0f, 10000.0f, "%.0f ms");
+        ImGui::PopID();
+    }
+    if (changed)
+    {
+        m_audioManager->SetFmPatch(m_fmPatch);
+    }
+}
+
+void App::DrawAdditivePatch()
+{
+    if (!ImGui::CollapsingHeader("Additive partials"))
+        return;
+    bool series = ImGui::Combo("Partial series", &m_additivePreset, ADDITIVE_PRESET_NAMES,
+                               ADDITIVE_PRESETS);
+    bool partials = ImGui::SliderInt("Partials", &m_additivePartials, 1, ADDITIVE_MAX_PARTIALS);
+    if (series || partials)
+    {
+        // A new series brings its own envelope times; a new count keeps the current ones
+        float attackMs = m_additivePatch.attackMs;
+        float releaseMs = m_additivePatch.releaseMs;
+        m_additivePatch =
+            MakeAdditivePreset((unsigned int)m_additivePreset, (unsigned int)m_additivePartials);
+        if (!series)
+        {
+            m_additivePatch.attackMs = attackMs;
+            m_additivePatch.releaseMs = releaseMs;
+        }
+    }
+    bool changed = series || partials;
+    changed |= ImGui::SliderFloat("Attack##additive", &m_additivePatch.attackMs, 0.0f, 2000.0f,
+                                  "%.0f ms");
+    changed |= ImGui::SliderFloat("Release##additive", &m_additivePatch.releaseMs, 1.0f,
+                                  10000.0f, "%.0f ms");
+    ImGui::PlotHistogram("Levels", m_additivePatch.amplitudes,
+                         (int)m_additivePatch.partialCount, 0, nullptr, 0.0f, 0.6f,
+                         ImVec2(0.0f, 60.0f));
+    if (changed)
+    {
+        m_audioManager->SetAdditivePatch(m_additivePatch);
+    }
+}
+
+void App::DrawSpectralPatch()
+{
+    if (!ImGui::CollapsingHeader("Spectral partials"))
+        return;
+    bool series = ImGui::Combo("Spectral series", &m_spectralPreset, SPECTRAL_PRESET_NAMES,
+                               SPECTRAL_PRESETS);
+    bool partials = ImGui::SliderInt("Partials##spectral", &m_spectralPartials, 1,
+                                     SPECTRAL_MAX_PARTIALS);
+    if (series || partials)
+    {
+        // As for additive partials: only a new series replaces the envelope times
+        float attackMs = m_spectralPatch.attackMs;
+        float releaseMs = m_spectralPatch.releaseMs;
+        m_spectralPatch =
+            MakeSpectralPreset((unsigned int)m_spectralPreset, (unsigned int)m_spectralPartials);
+        if (!series)
+        {
+            m_spectralPatch.attackMs = attackMs;
+            m_spectralPatch.releaseMs = releaseMs;
+        }
+    }
+    bool changed = series || partials;
+    changed |= ImGui::SliderFloat("Attack##spectral", &m_spectralPatch.attackMs, 0.0f, 4000.0f,
+                                  "%.0f ms");
+    changed |= ImGui::SliderFloat("Release##spectral", &m_spectralPatch.releaseMs, 1.0f,
+                                  10000.0f, "%.0f ms");
+    if (changed)
+    {
+        m_audioManager->SetSpectralPatch(m_spectralPatch);
+    }
+}
+
+void App::DrawRecorder()
+{
+    const WavRecorder& recorder = m_audioManager->GetRecorder();
+    ImGui::InputText("Record to", m_recordPath, sizeof(m_recordPath));
+    if (!recorder.IsRecording())
+    {
+        if (ImGui::Button("Record"))
+        {
+            m_recordStatus.clear();
+            m_audioManager->StartRecording(m_recordPath, &m_recordStatus);
+        }
+    }
+    else if (ImGui::Button("Stop##record"))
+    {
+        if (m_audioManager->StopRecording(&m_recordStatus))
+        {
+            char status[96];
+            snprintf(status, sizeof(status), "Saved %.1f s, %llu blocks dropped",
+                     recorder.GetRecordedSeconds(),
+                     (unsigned long long)recorder.GetDroppedBlocks());
+            m_recordStatus = status;
+        }
+    }
+    ImGui::SameLine();
+    if (recorder.IsRecording())
+    {
+        ImGui::Text("%.1f s, %llu blocks dropped, %.3f ms per block",
+                    recorder.GetRecordedSeconds(),
+                    (unsigned long long)recorder.GetDroppedBlocks(),
+                    m_audioManager->GetRenderStats().GetAverageMs(RenderStage::Capture));
+    }
+    else
+    {
+        ImGui::TextUnformatted(m_recordStatus.c_str());
+    }
+
+    const CaptureHistory* history = m_audioManager->GetCaptureHistory();
+    if (!history)
+        return;
+    ImGui::InputText("Save history to", m_historyPath, sizeof(m_historyPath));
+    char label[64];
+    snprintf(label, sizeof(label), "Save last %.0f s", history->GetCapacitySeconds());
+    if (ImGui::Button(label) && !history->IsSaving())
+    {
+        m_historyStatus.clear();
+        m_historySaving = m_audioManager->SaveCaptureHistory(m_historyPath, &m_historyStatus);
+    }
+    if (m_historySaving && !history->IsSaving())
+    {
+        m_historySaving = false;
+        m_historyStatus = history->GetSaveError();
+        if (m_historyStatus.empty())
+        {
+            char status[64];
+            snprintf(status, sizeof(status), "Saved %.1f s", history->GetSavedSeconds());
+            m_historyStatus = status;
+        }
+    }
+    ImGui::SameLine();
+    if (history->IsSaving())
+        ImGui::TextUnformatted("Saving...");
+    else if (!m_historyStatus.empty())
+        ImGui::TextUnformatted(m_historyStatus.c_str());
+    else
+        ImGui::Text("%.0f s held, %.1f MB", history->GetFilledSeconds(),
+                    history->GetBytes() / (1024.0 * 1024.0));
+}
+
+void App::DrawPresets()
+{
+    int count = (int)m_presets.GetCount();
+    if (ImGui::Button("<") && count > 0)
+        SelectPreset(m_preset <= 0 ? count - 1 : m_preset - 1);
+    ImGui::SameLine();
+    if (ImGui::Button(">") && count > 0)
+        SelectPreset(m_preset + 1 >= count ? 0 : m_preset + 1);
+    ImGui::SameLine();
+    if (m_preset >= 0 && m_preset < count)
+        ImGui::Text("%d/%d %s", m_preset + 1, count, m_presets.GetPatch(m_preset).name);
+    else
+        ImGui::Text("%d presets", count);
+
+    ImGui::InputText("Preset text", m_presetTextPath, sizeof(m_presetTextPath));
+    if (ImGui::Button("Import"))
+    {
+        std::vector<PresetPatch> patches;
+        if (ImportPresetText(m_presetTextPath, patches, &m_presetStatus) && RewriteBank(patches))
+            m_presetStatus = "Imported " + std::to_string(patches.size()) + " presets";
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export"))
+    {
+        m_presetStatus = ExportPresetText(m_presetTextPath, m_presets)
+                             ? "Exported " + std::to_string(count) + " presets"
+                             : "Could not write " + std::string(m_presetTextPath);
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Store current"))
+    {
+        std::vector<PresetPatch> patches(count);
+        for (int p = 0; p < count; p++)
+            m_presets.Load(p, patches[p]);
+        std::string name = "Patch " + std::to_string(count + 1);
+        patches.push_back(CapturePatch(m_audioManager->GetParameters(), name.c_str()));
+        if (RewriteBank(patches))
+            m_preset = count;
+    }
+    if (!m_presetStatus.empty())
+        ImGui::TextUnformatted(m_presetStatus.c_str());
+}
+
+void App::SelectPreset(int index)
+{
+    // The bank is already mapped and paged in, so this is two struct copies
+    PresetPatch patch;
+    m_presets.Load((unsigned int)index, patch);
+    m_audioManager->ApplyPatch(patch);
+    m_preset = index;
+    SyncControls();
+}
+
+bool App::RewriteBank(const std::vector<PresetPatch>& patches)
+{
+    // Written beside the bank first, so a failed write leaves the current bank untouched
+    std::filesystem::path temporary = std::wstring(PRESET_BANK_PATH) + L".tmp";
+    std::error_code ignored;
+    if (!SavePresetBank(temporary, patches, &m_presetStatus))
+    {
+        std::filesystem::remove(temporary, ignored);
+        return false;
+    }
+
+    // Windows won't replace a file that is mapped
+    m_presets.Close();
+    if (!::MoveFileExW(temporary.wstring().c_str(), PRESET_BANK_PATH,
+                       MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+    {
+        m_presetStatus = "could not replace " + std::filesystem::path(PRESET_BANK_PATH).string();
+        std::filesystem::remove(temporary, ignored);
+        m_presets.Open(PRESET_BANK_PATH);
+        return false;
+    }
+    m_preset = -1;
+    return m_presets.Open(PRESET_BANK_PATH, &m_presetStatus);
+}
+
+void App::SyncControls()
+{
+    const ParameterStore& params = m_audioManager->GetParameters();
+    m_oversampling = (int)params.Get(ParamId::Oversampling);
+    m_drive = params.Get(ParamId::Drive);
+    m_filterMode = (int)params.Get(ParamId::FilterMode);
+    m_filterCutoff = params.Get(ParamId::FilterCutoff);
+    m_filterResonance = params.Get(ParamId::FilterResonance);
+    m_samplerInterpolation = (int)params.Get(ParamId::SamplerInterpolation);
+    m_effects.delayEnabled = params.Get(ParamId::DelayEnabled) != 0.0f;
+    m_effects.delaySync = params.Get(ParamId::DelaySync) != 0.0f;
+    m_effects.delayMs = params.Get(ParamId::DelayMs);
+    m_effects.delayBeats = params.Get(ParamId::DelayBeats);
+    m_effects.tempoBpm = params.Get(ParamId::TempoBpm);
+    m_effects.delayFeedback = params.Get(ParamId::DelayFeedback);
+    m_effects.delayPingPong = params.Get(ParamId::DelayPingPong);
+    m_effects.delayMix = params.Get(ParamId::DelayMix);
+    m_effects.reverbEnabled = params.Get(ParamId::ReverbEnabled) != 0.0f;
+    m_effects.reverbSize = params.Get(ParamId::ReverbSize);
+    m_effects.reverbDecay = params.Get(ParamId::ReverbDecay);
+    m_effects.reverbDamping = params.Get(ParamId::ReverbDamping);
+    m_effects.reverbMix = params.Get(ParamId::ReverbMix);
+    m_effects.convolutionEnabled = params.Get(ParamId::ConvolutionEnabled) != 0.0f;
+    m_effects.convolutionMix = params.Get(ParamId::ConvolutionMix);
+}
+
 bool App::CreateAppWindow()
 {
     m_wc = {sizeof(m_wc),
@@ -156,19 +751,22 @@ void App::CleanupAppWindow()
 
 LRESULT CALLBACK App::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
+    // Stamped before ImGui sees the message, so the trace covers everything after dispatch
+    int64_t timestamp = LatencyTracer::Now();
     if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
         return true;
     if (g_AppInstance)
     {
-        if (g_AppInstance->m_audioManager)
+        // The key queue takes one producer, so keys come from here only without the input thread
+        if (g_AppInstance->m_audioManager && !g_AppInstance->m_keyboardInput)
         {
             if (msg == WM_KEYDOWN)
             {
-                g_AppInstance->m_audioManager->HandleKeyDown(wParam);
+                g_AppInstance->m_audioManager->HandleKeyDown(wParam, timestamp);
             }
             else if (msg == WM_KEYUP)
             {
-                g_AppInstance->m_audioManager->HandleKeyUp(wParam);
+                g_AppInstance->m_audioManager->HandleKeyUp(wParam, timestamp);
             }
         }
 
@@ -196,4 +794,70 @@ LRESULT CALLBACK App::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
         return 0;
     }
     return ::DefWindowProcW(hWnd, msg, wParam, lParam);
-}
\ No newline at end of file
+}
+
+void App::UpdateAnalyzer()
+{
+    // A torn read (the render thread lapped the copy) just keeps the previous frame's data
+    const unsigned int size = m_analyzer.GetSize();
+    if (m_audioManager->GetScope().ReadLatest(m_scopeLeft.data(), m_scopeRight.data(), size))
+    {
+        for (unsigned int n = 0; n < size; n++)
+            m_scopeMono[n] = 0.5f * (m_scopeLeft[n] + m_scopeRight[n]);
+        m_analyzer.Update(m_scopeMono.data(), ImGui::GetIO().DeltaTime);
+    }
+    float peak = 0.0f;
+    for (unsigned int n = 0; n < size; n++)
+        peak = std::max(peak, fabsf(m_scopeMono[n]));
+    m_scopeSettled = peak <= SCOPE_SILENCE && m_analyzer.IsSettled();
+}
+
+void App::DrawAnalyzer()
+{
+    const unsigned int size = m_analyzer.GetSize();
+    float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    float height = ANALYZER_HEIGHT * m_mainScale;
+    unsigned int columns = std::min((unsigned int)width, SCOPE_MAX_COLUMNS);
+    DecimateMinMax(m_scopeMono.data() + size - SCOPE_FRAMES, SCOPE_FRAMES, columns,
+                   m_scopeMin.data(), m_scopeMax.data());
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    float halfHeight = height * 0.5f;
+    float centre = origin.y + halfHeight;
+    drawList->AddRectFilled(origin, ImVec2(origin.x + width, origin.y + height),
+                            IM_COL32(20, 20, 24, 255));
+    for (unsigned int c = 0; c < columns; c++)
+    {
+        float x = origin.x + (float)c;
+        float top = centre - std::clamp(m_scopeMax[c], -1.0f, 1.0f) * halfHeight;
+        float bottom = centre - std::clamp(m_scopeMin[c], -1.0f, 1.0f) * halfHeight;
+        drawList->AddLine(ImVec2(x, top), ImVec2(x, bottom + 1.0f), IM_COL32(90, 220, 120, 255));
+    }
+    ImGui::Dummy(ImVec2(width, height));
+
+    ImGui::PlotLines("##Spectrum", m_analyzer.GetColumnsDb(), (int)m_analyzer.GetColumnCount(), 0,
+                     "Spectrum (log frequency)", SpectrumAnalyzer::MIN_DB, 0.0f,
+                     ImVec2(width, height));
+}
+
+void App::DrawLatency()
+{
+    const LatencyTracer& latency = m_audioManager->GetLatencyTracer();
+    ImGui::Text("Key to sound: p50 %.1f ms, p95 %.1f ms, p99 %.1f ms, max %.1f ms (%u keys)",
+                latency.GetPercentileMs(0.5), latency.GetPercentileMs(0.95),
+                latency.GetPercentileMs(0.99), latency.GetMaxMs(), latency.GetCount());
+    ImGui::Text("  waiting for render %.1f ms + queued in device %.1f ms, %u dropped (%s)",
+                latency.GetAverageQueueMs(), latency.GetAverageOutputMs(),
+                m_audioManager->GetDroppedKeyEvents(),
+                m_keyboardInput ? "Raw Input thread" : "window messages");
+
+    auto getBin = [](void* data, int bin) {
+        return (float)static_cast<const LatencyTracer*>(data)->GetBin((unsigned int)bin);
+    };
+    ImGui::PlotHistogram("##Latency", getBin, (void*)&latency, LatencyTracer::BIN_COUNT, 0,
+                         "0 - 100 ms", 0.0f, FLT_MAX, ImVec2(0.0f, 40.0f * m_mainScale));
+    ImGui::SameLine();
+    if (ImGui::Button("Reset"))
+        m_audioManager->ResetLatencyTrace();
+}
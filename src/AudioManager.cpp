@@ -1,8 +1,28 @@
 #include "AudioManager.h"
+#include "PresetBank.h"
+#include "SampleStreamer.h"
+#include "Trace.h"
+
+#if defined(_WIN32)
 #include "noiseMaker.h"
+#endif
+
+#include <algorithm>
 #include <cmath>
 
+constexpr double PI = 3.14159265358979323846;
 constexpr double TWO_PI = 2.0 * PI;
+constexpr unsigned int SAMPLE_RATE = 44100;
+// Tried in order until a device accepts one; anything but SAMPLE_RATE is resampled to
+constexpr unsigned int DEVICE_RATES[] = {SAMPLE_RATE, 48000, 96000, 88200, 32000};
+constexpr unsigned int OUTPUT_CHANNELS = 2;
+constexpr unsigned int BLOCK_COUNT = 8;
+constexpr unsigned int BLOCK_SAMPLES = 512;
+constexpr size_t SCRATCH_HEADROOM = 2; // Room for stages that start using scratch later
+constexpr double CAPTURE_HISTORY_SECONDS = 120.0; // About 21 MB at 44.1 kHz stereo
+constexpr double VOICE_GAIN = 0.5;
+constexpr float DRIVE_MAX_GAIN = 10.0f;
+constexpr double PAN_CENTRE_FREQ = 523.25; // C5 sits in the middle of the stereo field
 
 // Musical note frequencies (in Hz)
 namespace NoteFrequencies
@@ -34,34 +54,38 @@ constexpr double E6 = 1318.51;
 // Virtual key codes for keyboard mapping
 namespace VirtualKeys
 {
-constexpr WPARAM Q = 0x51;
-constexpr WPARAM W = 0x57;
-constexpr WPARAM E = 0x45;
-constexpr WPARAM R = 0x52;
-constexpr WPARAM T = 0x54;
-constexpr WPARAM Y = 0x59;
-constexpr WPARAM U = 0x55;
-constexpr WPARAM I = 0x49;
-constexpr WPARAM O = 0x4F;
-constexpr WPARAM P = 0x50;
-constexpr WPARAM Z = 0x5A;
-constexpr WPARAM X = 0x58;
-constexpr WPARAM C = 0x43;
-constexpr WPARAM V = 0x56;
-constexpr WPARAM B = 0x42;
-constexpr WPARAM N = 0x4E;
-constexpr WPARAM M = 0x4D;
+constexpr AudioManager::KeyCode Q = 0x51;
+constexpr AudioManager::KeyCode W = 0x57;
+constexpr AudioManager::KeyCode E = 0x45;
+constexpr AudioManager::KeyCode R = 0x52;
+constexpr AudioManager::KeyCode T = 0x54;
+constexpr AudioManager::KeyCode Y = 0x59;
+constexpr AudioManager::KeyCode U = 0x55;
+constexpr AudioManager::KeyCode I = 0x49;
+constexpr AudioManager::KeyCode O = 0x4F;
+constexpr AudioManager::KeyCode P = 0x50;
+constexpr AudioManager::KeyCode Z = 0x5A;
+constexpr AudioManager::KeyCode X = 0x58;
+constexpr AudioManager::KeyCode C = 0x43;
+constexpr AudioManager::KeyCode V = 0x56;
+constexpr AudioManager::KeyCode B = 0x42;
+constexpr AudioManager::KeyCode N = 0x4E;
+constexpr AudioManager::KeyCode M = 0x4D;
 } // namespace VirtualKeys
 
 AudioManager* AudioManager::s_instance = nullptr;
 
 AudioManager::AudioManager()
 {
-    s_instance = this;
+    SetFmPatch(MakeFmPreset(0));
+    SetAdditivePatch(MakeAdditivePreset(0));
+    SetSpectralPatch(MakeSpectralPreset(0));
 }
 
 AudioManager::~AudioManager()
 {
+    // Stop the render thread before the graphs and buffers it uses are destroyed
+    m_sound.reset();
     if (s_instance == this)
     {
         s_instance = nullptr;
@@ -70,97 +94,850 @@ AudioManager::~AudioManager()
 
 bool AudioManager::Initialize()
 {
+#if defined(_WIN32)
     std::vector<std::wstring> devices = NoiseMaker<int>::GetDevices();
     if (devices.empty())
     {
         return false;
     }
 
-    m_sound = std::make_unique<NoiseMaker<int>>(devices[0]);
-    m_sound->SetUserFunction(AudioManager::StaticNoiseCallback);
+    // Per-block temporaries come from the NoiseMaker's scratch arena
+    size_t scratchBytes = GetScratchBytes(BLOCK_SAMPLES, OUTPUT_CHANNELS);
+    std::unique_ptr<NoiseMaker<int>> sound;
+    for (unsigned int rate : DEVICE_RATES)
+    {
+        sound = std::make_unique<NoiseMaker<int>>(devices[0], rate, OUTPUT_CHANNELS, BLOCK_COUNT,
+                                                  BLOCK_SAMPLES, scratchBytes);
+        if (sound->IsOpen())
+            break;
+        sound.reset();
+    }
+    if (!sound)
+        return false;
+    // Only the device callbacks need it, so offline engines on other threads never touch it
+    s_instance = this;
+    NoiseMaker<int>& device = *sound;
+    m_sound = std::move(sound);
+    if (!PrepareEngine(device.GetBlockSamples(), device.GetChannels(), &device.GetScratch()))
+        return false;
+
+    // The engine always renders at SAMPLE_RATE; a device at another rate gets whole blocks
+    // converted on the render thread
+    const unsigned int channels = m_sound->GetChannels();
+    m_deviceResampling = m_sound->GetSampleRate() != SAMPLE_RATE;
+    if (m_deviceResampling)
+    {
+        m_deviceResampler.Prepare(SAMPLE_RATE, m_sound->GetSampleRate(), channels,
+                                  ResampleQuality::Normal, m_blockSamples);
+        m_deviceInputMemory.assign((size_t)m_blockSamples * channels, 0.0f);
+        m_deviceInput.resize(channels);
+        for (unsigned int c = 0; c < channels; c++)
+            m_deviceInput[c] = m_deviceInputMemory.data() + (size_t)c * m_blockSamples;
+    }
+
+    m_captureHistory = std::make_unique<CaptureHistory>(
+        CAPTURE_HISTORY_SECONDS, m_sound->GetSampleRate(), channels, CaptureHistory::Format::Int16);
+    // Optional: a second instance leaves the segment to the first
+    m_metrics.Create();
+    device.SetBlockFunction(AudioManager::StaticBlockCallback);
+    device.SetOutputFunction(AudioManager::StaticOutputCallback);
     return true;
+#else
+    // waveOut is the only output device; other platforms render offline
+    return false;
+#endif
+}
+
+bool AudioManager::InitializeOffline(unsigned int blockSamples)
+{
+    m_offlineScratch.Reserve(GetScratchBytes(blockSamples, OUTPUT_CHANNELS));
+    return PrepareEngine(blockSamples, OUTPUT_CHANNELS, &m_offlineScratch);
+}
+
+bool AudioManager::PrepareEngine(unsigned int blockSamples, unsigned int channels,
+                                 ScratchArena* pScratch)
+{
+    m_timeStep = 1.0 / (double)SAMPLE_RATE;
+    m_blockSamples = blockSamples;
+    m_blockDurationMs = 1000.0 * blockSamples / SAMPLE_RATE;
+    m_scratch = pScratch;
+    m_oversamplers.resize(channels);
+    for (unsigned int c = 0; c < channels; c++)
+        m_oversamplers[c].Prepare(blockSamples);
+    m_effectsChain.Prepare(SAMPLE_RATE);
+    m_blockParams.Reset(m_params);
+    return SetMasterGraph(MakeDirectGraph());
+}
+
+size_t AudioManager::GetScratchBytes(unsigned int blockSamples, unsigned int channels)
+{
+    // Sized for the largest oversampling factor: the voice lanes, the oversampled channels and
+    // their pointers, the sampler's decode buffer, plus headroom
+    size_t maxOversampledFrames = (size_t)blockSamples * Oversampler::MAX_FACTOR;
+    size_t bytes = maxOversampledFrames * MAX_VOICES * sizeof(float) +
+                   maxOversampledFrames * channels * sizeof(float) +
+                   channels * sizeof(float*) +
+                   GetSamplerDecodeFrames((unsigned int)maxOversampledFrames) * sizeof(float) +
+                   4 * ScratchArena::ALIGNMENT;
+    return bytes * SCRATCH_HEADROOM;
+}
+
+void AudioManager::RenderOffline(const std::vector<NoteEvent>& script, double seconds,
+                                 WavData& out)
+{
+    const unsigned int channels = (unsigned int)m_oversamplers.size();
+    const size_t blocks = (size_t)ceil(seconds * SAMPLE_RATE / m_blockSamples);
+    out.sampleRate = SAMPLE_RATE;
+    out.channels.assign(channels, std::vector<float>(blocks * m_blockSamples));
+
+    // Start from the current settings rather than smoothing in from the previous render
+    m_blockParams.Reset(m_params);
+
+    std::vector<float*> ppChannels(channels);
+    size_t nextEvent = 0;
+    double dTime = 0.0;
+    for (size_t b = 0; b < blocks; b++)
+    {
+        // Events land on block boundaries, as key presses do in the live engine
+        double blockEnd = (b + 1) * m_blockSamples * m_timeStep;
+        while (nextEvent < script.size() && script[nextEvent].time < blockEnd)
+        {
+            const NoteEvent& event = script[nextEvent++];
+            if (event.down)
+                HandleKeyDown(event.key);
+            else
+                HandleKeyUp(event.key);
+        }
+
+        for (unsigned int c = 0; c < channels; c++)
+            ppChannels[c] = out.channels[c].data() + b * m_blockSamples;
+        m_scratch->Reset();
+        RenderBlock(ppChannels.data(), channels, m_blockSamples, dTime);
+        // Accumulated the same way as the NoiseMaker thread, so phases match live output
+        dTime = dTime + m_blockSamples * m_timeStep;
+    }
 }
 
 void AudioManager::Shutdown()
 {
     m_sound.reset();
+    m_recorder.Stop();
+    m_scratch = nullptr;
+    m_blockSamples = 0;
 }
 
-void AudioManager::HandleKeyDown(WPARAM wParam)
+void AudioManager::HandleKeyDown(KeyCode key, int64_t timestampNs)
 {
-    std::lock_guard<std::mutex> lock(m_notesMutex);
-    if (m_activeNotes.find(wParam) == m_activeNotes.end())
+    if (MapNoteFrequency(key) == 0.0)
+        return;
+    SYNTH_TRACE_INSTANT("KeyDown");
+    KeyEvent event{key, true, timestampNs ? timestampNs : LatencyTracer::Now()};
+    if (!m_keyEvents.Push(event))
+        m_droppedKeyEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioManager::HandleKeyUp(KeyCode key, int64_t timestampNs)
+{
+    if (MapNoteFrequency(key) == 0.0)
+        return;
+    SYNTH_TRACE_INSTANT("KeyUp");
+    KeyEvent event{key, false, timestampNs ? timestampNs : LatencyTracer::Now()};
+    if (!m_keyEvents.Push(event))
+        m_droppedKeyEvents.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AudioManager::ProcessKeyEvents(double dTime)
+{
+    SYNTH_TRACE_SCOPE("KeyEvents");
+    // Every event applied here is first heard when this block plays. The device position says
+    // how far ahead of playback the block is, and so when that will be.
+    enum class Position
+    {
+        Unknown,
+        Known,
+        Unavailable
+    } position = m_sound ? Position::Unknown : Position::Unavailable;
+    int64_t now = 0;
+    double outputMs = 0.0;
+
+    m_keyQueueDepth = (unsigned int)m_keyEvents.GetSize();
+    KeyEvent event;
+    while (m_keyEvents.Pop(event))
     {
-        MapNoteFrequency(wParam);
+        if (!ApplyKeyEvent(event) || position == Position::Unavailable)
+            continue;
+        if (position == Position::Unknown)
+        {
+            now = LatencyTracer::Now();
+            // In device frames, which differ from render frames when the output is resampled
+            const double deviceRate = m_sound->GetSampleRate();
+            uint64_t blockFrame = (uint64_t)llround(dTime * deviceRate);
+            uint64_t playedFrames = 0;
+            if (!m_sound->GetPlayedFrames(blockFrame, playedFrames))
+            {
+                position = Position::Unavailable;
+                continue;
+            }
+            if (blockFrame > playedFrames)
+                outputMs = 1000.0 * (blockFrame - playedFrames) / deviceRate;
+            position = Position::Known;
+        }
+        m_latency.Record((now - event.timestampNs) * 1e-6, outputMs);
     }
 }
 
-void AudioManager::HandleKeyUp(WPARAM wParam)
+bool AudioManager::ApplyKeyEvent(const KeyEvent& event)
 {
-    std::lock_guard<std::mutex> lock(m_notesMutex);
-    m_activeNotes.erase(wParam);
+    if (!event.down)
+    {
+        bool released = false;
+        for (unsigned int v = 0; v < MAX_VOICES; v++)
+        {
+            Voice& voice = m_voices[v];
+            if (voice.active && voice.key == event.key)
+            {
+                voice.active = false;
+                StopSampler(voice.sampler);
+                m_fmBank.NoteOff(v);
+                m_additiveBank.NoteOff(v);
+                m_spectralBank.NoteOff(v);
+                released = true;
+            }
+        }
+        return released;
+    }
+
+    // Released FM, additive and spectral notes ring on, so prefer a slot whose release has
+    // finished
+    const WaveType waveType = (WaveType)m_blockParams.GetInt(ParamId::WaveType);
+    unsigned int ringing = 0;
+    if (waveType == WaveType::Fm)
+        ringing = m_fmBank.GetSoundingMask();
+    else if (waveType == WaveType::Additive)
+        ringing = m_additiveBank.GetSoundingMask();
+    else if (waveType == WaveType::Spectral)
+        ringing = m_spectralBank.GetSoundingMask();
+    int freeSlot = -1;
+    for (unsigned int v = 0; v < MAX_VOICES; v++)
+    {
+        if (m_voices[v].active && m_voices[v].key == event.key)
+            return false; // Key repeat
+        if (m_voices[v].active)
+            continue;
+        if (freeSlot < 0 || (((ringing >> freeSlot) & 1) && !((ringing >> v) & 1)))
+            freeSlot = (int)v;
+    }
+    if (freeSlot < 0)
+        return false; // Every voice is sounding
+
+    double freq = MapNoteFrequency(event.key);
+    float spread = m_blockParams.Get(ParamId::StereoSpread);
+    float pan = (float)(spread * log2(freq / PAN_CENTRE_FREQ));
+    m_filterBank.ResetVoice((unsigned int)freeSlot);
+    m_fmBank.NoteOn((unsigned int)freeSlot, freq);
+    m_additiveBank.NoteOn((unsigned int)freeSlot, freq);
+    m_spectralBank.NoteOn((unsigned int)freeSlot, freq);
+    SamplerVoice sampler;
+    sampler.zone = m_instrument ? m_instrument->FindZone(freq) : nullptr;
+    sampler.slot = (unsigned int)freeSlot;
+    if (sampler.zone && sampler.zone->streamed)
+        m_instrument->GetStreamer()->BeginVoice(sampler.slot, sampler.zone);
+    m_voices[freeSlot] = Voice{event.key, freq, std::clamp(pan, -1.0f, 1.0f), true, sampler};
+    return true;
+}
+
+void AudioManager::StopSampler(SamplerVoice& sampler)
+{
+    if (sampler.zone && sampler.zone->streamed)
+        m_instrument->GetStreamer()->EndVoice(sampler.slot);
+    sampler = SamplerVoice{};
+}
+
+void AudioManager::SilenceWaveBank(WaveType waveType)
+{
+    switch (waveType)
+    {
+    case WaveType::Fm:
+        m_fmBank.Silence();
+        break;
+    case WaveType::Additive:
+        m_additiveBank.Silence();
+        break;
+    case WaveType::Spectral:
+        m_spectralBank.Silence();
+        break;
+    default:
+        break; // Voices of the other wave types hold no state in a bank
+    }
+}
+
+void AudioManager::SetParameter(ParamId id, float value)
+{
+    m_params.Set(id, value);
 }
 
 void AudioManager::SetWaveType(WaveType type)
 {
-    std::lock_guard<std::mutex> lock(m_notesMutex);
-    m_currentWaveType = type;
+    m_params.Set(ParamId::WaveType, (float)type);
 }
 
-double AudioManager::StaticNoiseCallback(double dTime)
+void AudioManager::SetFmPatch(const FmPatch& patch)
+{
+    m_fmPatches.Publish(std::make_unique<FmPatch>(patch));
+}
+
+void AudioManager::SetAdditivePatch(const AdditivePatch& patch)
+{
+    m_additivePatches.Publish(std::make_unique<AdditivePatch>(patch));
+}
+
+void AudioManager::SetSpectralPatch(const SpectralPatch& patch)
+{
+    m_spectralPatches.Publish(std::make_unique<SpectralPatch>(patch));
+}
+
+void AudioManager::SetStereoSpread(float spread)
+{
+    m_params.Set(ParamId::StereoSpread, spread);
+}
+
+void AudioManager::SetOversampling(unsigned int factor)
+{
+    if (factor != 1 && factor != 2 && factor != 4 && factor != 8)
+        return;
+    m_params.Set(ParamId::Oversampling, (float)factor);
+}
+
+void AudioManager::SetSamplerInterpolation(SamplerInterpolation interpolation)
+{
+    m_params.Set(ParamId::SamplerInterpolation, (float)interpolation);
+}
+
+void AudioManager::SetDrive(float drive)
+{
+    m_params.Set(ParamId::Drive, drive);
+}
+
+void AudioManager::SetFilter(FilterMode mode, float cutoffHz, float resonance)
+{
+    m_params.Set(ParamId::FilterMode, (float)mode);
+    m_params.Set(ParamId::FilterCutoff, cutoffHz);
+    m_params.Set(ParamId::FilterResonance, resonance);
+}
+
+void AudioManager::SetEffects(const EffectsSettings& settings)
+{
+    m_params.Set(ParamId::DelayEnabled, settings.delayEnabled ? 1.0f : 0.0f);
+    m_params.Set(ParamId::DelaySync, settings.delaySync ? 1.0f : 0.0f);
+    m_params.Set(ParamId::DelayMs, settings.delayMs);
+    m_params.Set(ParamId::DelayBeats, settings.delayBeats);
+    m_params.Set(ParamId::TempoBpm, settings.tempoBpm);
+    m_params.Set(ParamId::DelayFeedback, settings.delayFeedback);
+    m_params.Set(ParamId::DelayPingPong, settings.delayPingPong);
+    m_params.Set(ParamId::DelayMix, settings.delayMix);
+    m_params.Set(ParamId::ReverbEnabled, settings.reverbEnabled ? 1.0f : 0.0f);
+    m_params.Set(ParamId::ReverbSize, settings.reverbSize);
+    m_params.Set(ParamId::ReverbDecay, settings.reverbDecay);
+    m_params.Set(ParamId::ReverbDamping, settings.reverbDamping);
+    m_params.Set(ParamId::ReverbMix, settings.reverbMix);
+    m_params.Set(ParamId::ConvolutionEnabled, settings.convolutionEnabled ? 1.0f : 0.0f);
+    m_params.Set(ParamId::ConvolutionMix, settings.convolutionMix);
+}
+
+void AudioManager::ApplyPatch(const PresetPatch& patch)
+{
+    m_params.SetAll(patch.values);
+}
+
+bool AudioManager::SetMasterGraph(const DspGraph& graph, std::string* error)
+{
+    if (m_blockSamples == 0)
+        return false;
+
+    std::unique_ptr<CompiledGraph> compiled =
+        CompileGraph(graph, SAMPLE_RATE, m_blockSamples, error);
+    if (!compiled)
+        return false;
+    m_masterGraph.Publish(std::move(compiled));
+    return true;
+}
+
+bool AudioManager::LoadImpulseResponse(const std::filesystem::path& path)
+{
+    if (m_blockSamples == 0)
+        return false;
+
+    WavData ir;
+    if (!LoadWav(path, ir))
+        return false;
+
+    // Built and its tail thread started here, so the render thread only ever sees a ready engine
+    auto convolution = std::make_unique<ConvolutionReverb>();
+    if (!convolution->Prepare(ir, SAMPLE_RATE, m_blockSamples))
+        return false;
+
+    // The engine it replaces is retired to this thread and destroyed at the next load
+    m_convolutions.Publish(std::move(convolution));
+    return true;
+}
+
+bool AudioManager::LoadSampleInstrument(const std::filesystem::path& directory,
+                                        std::string* error)
+{
+    auto instrument = std::make_unique<SampleInstrument>();
+    if (!instrument->Load(directory, SAMPLE_RATE, MAX_VOICES, error))
+        return false;
+    m_sampleZones = instrument->GetZoneCount();
+    m_sampleBytes = instrument->GetMappedBytes();
+    m_streamedZones = instrument->GetStreamedZoneCount();
+    m_sampleStreamer = instrument->GetStreamer();
+    if (m_sampleStreamer)
+        m_sampleStreamer->SetDiskDelayMs(m_streamDiskDelayMs);
+    m_instruments.Publish(std::move(instrument));
+    return true;
+}
+
+void AudioManager::SetStreamDiskDelay(double ms)
+{
+    m_streamDiskDelayMs = ms;
+    if (m_sampleStreamer)
+        m_sampleStreamer->SetDiskDelayMs(ms);
+}
+
+bool AudioManager::StartRecording(const std::filesystem::path& path, std::string* error)
+{
+    if (!m_sound)
+    {
+        if (error)
+            *error = "no output device";
+        return false;
+    }
+    return m_recorder.Start(path, m_sound->GetSampleRate(), m_sound->GetChannels(), error);
+}
+
+bool AudioManager::StopRecording(std::string* error)
+{
+    return m_recorder.Stop(error);
+}
+
+bool AudioManager::SaveCaptureHistory(const std::filesystem::path& path, std::string* error)
+{
+    if (!m_captureHistory)
+    {
+        if (error)
+            *error = "no output device";
+        return false;
+    }
+    return m_captureHistory->SaveAsync(path, error);
+}
+
+double AudioManager::GetConvolutionTailMs() const
+{
+    return m_convolutionTailMs.load(std::memory_order_relaxed);
+}
+
+unsigned int AudioManager::GetConvolutionTailMisses() const
+{
+    return m_convolutionTailMisses.load(std::memory_order_relaxed);
+}
+
+double AudioManager::GetSampleRate() const
+{
+    return SAMPLE_RATE;
+}
+
+unsigned int AudioManager::GetDeviceSampleRate() const
+{
+    return m_sound ? m_sound->GetSampleRate() : SAMPLE_RATE;
+}
+
+size_t AudioManager::GetScratchCapacity() const
+{
+    return m_scratch ? m_scratch->GetCapacity() : 0;
+}
+
+size_t AudioManager::GetScratchHighWater() const
+{
+    return m_scratch ? m_scratch->GetHighWaterMark() : 0;
+}
+
+double AudioManager::GetDspLoad() const
+{
+    if (m_blockDurationMs <= 0.0)
+        return 0.0;
+    return m_renderStats.GetAverageMs(RenderStage::Total) / m_blockDurationMs;
+}
+
+void AudioManager::StaticBlockCallback(float* const* ppChannels, unsigned int nChannels,
+                                       unsigned int nFrames, double dTime)
 {
     if (s_instance)
     {
-        WaveType currentType = s_instance->m_currentWaveType;
-        if (currentType == WaveType::Sine)
+        int64_t start = LatencyTracer::Now();
+        s_instance->RenderDeviceBlock(ppChannels, nChannels, nFrames, dTime);
+        s_instance->PublishMetrics(nFrames, (LatencyTracer::Now() - start) * 1e-6);
+        return;
+    }
+    for (unsigned int c = 0; c < nChannels; c++)
+        std::fill(ppChannels[c], ppChannels[c] + nFrames, 0.0f);
+}
+
+void AudioManager::StaticOutputCallback(const int32_t* pFrames, unsigned int nChannels,
+                                        unsigned int nFrames)
+{
+    if (!s_instance)
+        return;
+    SYNTH_TRACE_SCOPE("Capture");
+    ScopedStageTimer captureTimer(s_instance->m_renderStats, RenderStage::Capture);
+    if (s_instance->m_captureHistory)
+        s_instance->m_captureHistory->Write(pFrames, nChannels, nFrames);
+    s_instance->m_recorder.Write(pFrames, nChannels, nFrames);
+}
+
+void AudioManager::RenderDeviceBlock(float* const* ppChannels, unsigned int nChannels,
+                                     unsigned int nFrames, double dTime)
+{
+    if (!m_deviceResampling)
+    {
+        RenderBlock(ppChannels, nChannels, nFrames, dTime);
+        return;
+    }
+
+    // Render as many whole blocks as the device block needs; the remainder carries over in the
+    // resampler. The block clock runs at SAMPLE_RATE, not the device's.
+    size_t done = m_deviceResampler.Pull(ppChannels, 0, nFrames);
+    while (done < nFrames)
+    {
+        m_scratch->Reset();
+        RenderBlock(m_deviceInput.data(), nChannels, m_blockSamples, m_renderTime);
+        m_renderTime = m_renderTime + m_blockSamples * m_timeStep;
+        SYNTH_TRACE_SCOPE("DeviceResample");
+        m_deviceResampler.Push(m_deviceInput.data(), m_blockSamples);
+        done += m_deviceResampler.Pull(ppChannels, done, nFrames - done);
+    }
+}
+
+void AudioManager::PublishMetrics(unsigned int nFrames, double blockMs)
+{
+    if (!m_metrics.IsOpen())
+        return;
+    unsigned int activeVoices = 0;
+    for (const Voice& voice : m_voices)
+        activeVoices += voice.active ? 1 : 0;
+
+    EngineMetrics& metrics = m_publishedMetrics;
+    metrics.blocks++;
+    metrics.underruns = m_sound->GetUnderruns();
+    metrics.blockMs = blockMs;
+    metrics.averageBlockMs = m_renderStats.GetAverageMs(RenderStage::Total);
+    metrics.peakBlockMs = m_renderStats.GetPeakMs(RenderStage::Total);
+    metrics.dspLoad = GetDspLoad();
+    metrics.sampleRate = m_sound->GetSampleRate();
+    metrics.blockFrames = nFrames;
+    metrics.activeVoices = activeVoices;
+    metrics.keyQueueDepth = m_keyQueueDepth;
+    metrics.droppedKeyEvents = GetDroppedKeyEvents();
+    m_metrics.Publish(metrics);
+}
+
+void AudioManager::RenderBlock(float* const* ppChannels, unsigned int nChannels,
+                               unsigned int nFrames, double dTime)
+{
+    SYNTH_TRACE_SCOPE("RenderBlock");
+    ScopedStageTimer totalTimer(m_renderStats, RenderStage::Total);
+    m_blockParams.Update(m_params, nFrames, SAMPLE_RATE);
+    UpdateEffectsSettings();
+    SampleInstrument* instrument = m_instruments.Acquire();
+    if (instrument != m_instrument)
+    {
+        // The outgoing instrument may be freed by the GUI from now on
+        for (Voice& voice : m_voices)
+            voice.sampler = SamplerVoice{};
+        m_instrument = instrument;
+    }
+    // Bank notes still releasing when the wave type moves on would otherwise resume
+    // mid-release on the way back
+    const WaveType waveType = (WaveType)m_blockParams.GetInt(ParamId::WaveType);
+    if (waveType != m_blockWaveType)
+        SilenceWaveBank(m_blockWaveType);
+    m_blockWaveType = waveType;
+    m_fmPatch = m_fmPatches.Acquire();
+    const AdditivePatch* additivePatch = m_additivePatches.Acquire();
+    if (additivePatch != m_additivePatch)
+    {
+        // Checked every block, so a new patch can't hide behind its predecessor's address
+        m_additivePatch = additivePatch;
+        m_additiveBank.PatchChanged();
+    }
+    const SpectralPatch* spectralPatch = m_spectralPatches.Acquire();
+    if (spectralPatch != m_spectralPatch)
+    {
+        m_spectralPatch = spectralPatch;
+        m_spectralBank.PatchChanged();
+    }
+    ProcessKeyEvents(dTime);
+    // Offline there's no deadline to miss, so wait for the disk rather than starve
+    if (!m_sound && m_instrument && m_instrument->GetStreamer())
+        m_instrument->GetStreamer()->WaitUntilFilled();
+
+    nChannels = std::min(nChannels, (unsigned int)m_oversamplers.size());
+
+    // Generic SetParameter writes may land between the supported factors; round down
+    unsigned int factor = m_blockParams.GetInt(ParamId::Oversampling);
+    factor = factor >= 8 ? 8 : factor >= 4 ? 4 : factor >= 2 ? 2 : 1;
+    if (factor == 1)
+    {
+        RenderVoices(ppChannels, nChannels, nFrames, dTime, m_timeStep);
+        ApplyDrive(ppChannels, nChannels, nFrames);
+        m_renderStats.Record(RenderStage::Oversampling, 0.0);
+    }
+    else
+    {
+        // Voices and the saturator run at factor x the device rate, then decimate back down
+        unsigned int oversampledFrames = nFrames * factor;
+        float** ppOversampled = m_scratch->Allocate<float*>(nChannels);
+        float* pOversampled = m_scratch->Allocate<float>((size_t)oversampledFrames * nChannels);
+        if (!ppOversampled || !pOversampled)
+        {
+            for (unsigned int c = 0; c < nChannels; c++)
+                std::fill(ppChannels[c], ppChannels[c] + nFrames, 0.0f);
+            return;
+        }
+        for (unsigned int c = 0; c < nChannels; c++)
+            ppOversampled[c] = pOversampled + (size_t)c * oversampledFrames;
+
+        RenderVoices(ppOversampled, nChannels, nFrames * factor, dTime, m_timeStep / factor);
+        ApplyDrive(ppOversampled, nChannels, nFrames * factor);
+
+        ScopedStageTimer oversamplingTimer(m_renderStats, RenderStage::Oversampling);
+        for (unsigned int c = 0; c < nChannels; c++)
         {
-            return s_instance->MakeSineNoise(dTime);
+            m_oversamplers[c].SetFactor(factor);
+            m_oversamplers[c].Decimate(ppOversampled[c], nFrames, ppChannels[c]);
         }
-        else if (currentType == WaveType::Square)
+    }
+
+    if (nChannels >= 2)
+        ProcessMasterBus(ppChannels, nFrames);
+
+    // The scope costs this thread one copy per block; all analysis happens on the GUI thread
+    m_scope.Write(ppChannels[0], ppChannels[nChannels - 1], nFrames);
+}
+
+void AudioManager::ProcessMasterBus(float* const* ppChannels, unsigned int nFrames)
+{
+    SYNTH_TRACE_SCOPE("MasterBus");
+    // The master graph runs on the summed stereo output at the device rate, in place
+    {
+        ScopedStageTimer graphTimer(m_renderStats, RenderStage::Graph);
+        CompiledGraph* pGraph = m_masterGraph.Acquire();
+        if (pGraph)
         {
-            return s_instance->MakeSquareNoise(dTime);
+            bool gate = std::any_of(std::begin(m_voices), std::end(m_voices),
+                                    [](const Voice& voice) { return voice.active; });
+            GraphContext context{ppChannels[0],      ppChannels[1], ppChannels[0],
+                                 ppChannels[1],      nFrames,       gate,
+                                 &m_effectsSettings, &m_effectsChain};
+            pGraph->Process(context);
         }
     }
-    return 0.0;
+
+    ScopedStageTimer convolutionTimer(m_renderStats, RenderStage::Convolution);
+    ConvolutionReverb* pConvolution = m_convolutions.Acquire();
+    if (!pConvolution)
+        return;
+    if (m_effectsSettings.convolutionEnabled)
+        pConvolution->Process(ppChannels[0], ppChannels[1], nFrames,
+                              m_effectsSettings.convolutionMix);
+    m_convolutionTailMs.store(pConvolution->GetTailAverageMs(), std::memory_order_relaxed);
+    m_convolutionTailMisses.store(pConvolution->GetTailMisses(), std::memory_order_relaxed);
 }
 
-double AudioManager::SineSoundMaker(double freq, double dTime) const
+void AudioManager::UpdateEffectsSettings()
 {
-    return sin(freq * TWO_PI * dTime);
+    const ParameterSnapshot& p = m_blockParams;
+    m_effectsSettings.delayEnabled = p.GetBool(ParamId::DelayEnabled);
+    m_effectsSettings.delaySync = p.GetBool(ParamId::DelaySync);
+    m_effectsSettings.delayMs = p.Get(ParamId::DelayMs);
+    m_effectsSettings.delayBeats = p.Get(ParamId::DelayBeats);
+    m_effectsSettings.tempoBpm = p.Get(ParamId::TempoBpm);
+    m_effectsSettings.delayFeedback = p.Get(ParamId::DelayFeedback);
+    m_effectsSettings.delayPingPong = p.Get(ParamId::DelayPingPong);
+    m_effectsSettings.delayMix = p.Get(ParamId::DelayMix);
+    m_effectsSettings.reverbEnabled = p.GetBool(ParamId::ReverbEnabled);
+    m_effectsSettings.reverbSize = p.Get(ParamId::ReverbSize);
+    m_effectsSettings.reverbDecay = p.Get(ParamId::ReverbDecay);
+    m_effectsSettings.reverbDamping = p.Get(ParamId::ReverbDamping);
+    m_effectsSettings.reverbMix = p.Get(ParamId::ReverbMix);
+    m_effectsSettings.convolutionEnabled = p.GetBool(ParamId::ConvolutionEnabled);
+    m_effectsSettings.convolutionMix = p.Get(ParamId::ConvolutionMix);
 }
 
-double AudioManager::SquareSoundMaker(double freq, double dTime) const
+void AudioManager::RenderVoices(float* const* ppChannels, unsigned int nChannels,
+                                unsigned int nFrames, double dTime, double timeStep)
 {
-    // Simple and efficient square wave: returns 1 or -1
-    double phase = fmod(freq * dTime, 1.0);
-    return (phase < 0.5) ? 1.0 : -1.0;
+    SYNTH_TRACE_SCOPE("Voices");
+    ScopedStageTimer voicesTimer(m_renderStats, RenderStage::Voices);
+    for (unsigned int c = 0; c < nChannels; c++)
+        std::fill(ppChannels[c], ppChannels[c] + nFrames, 0.0f);
+
+    // Frame-major across MAX_VOICES lanes, the layout SvfBank filters in place
+    float* pVoices = m_scratch->Allocate<float>((size_t)nFrames * MAX_VOICES);
+    WaveType waveType = (WaveType)m_blockParams.GetInt(ParamId::WaveType);
+    bool sampler = waveType == WaveType::Sampler;
+    float* pDecode =
+        sampler ? m_scratch->Allocate<float>(GetSamplerDecodeFrames(nFrames)) : nullptr;
+    if (!pVoices || (sampler && !pDecode))
+        return;
+    unsigned int voiceMask = 0;
+    if (waveType == WaveType::Fm)
+    {
+        // Every operator of a lane group of voices at once, released notes included
+        if (m_fmPatch)
+            voiceMask = m_fmBank.Render(*m_fmPatch, pVoices, nFrames, 1.0 / timeStep,
+                                        (float)VOICE_GAIN);
+    }
+    else if (waveType == WaveType::Additive)
+    {
+        if (m_additivePatch)
+            voiceMask = m_additiveBank.Render(*m_additivePatch, pVoices, nFrames, 1.0 / timeStep,
+                                              (float)VOICE_GAIN);
+    }
+    else if (waveType == WaveType::Spectral)
+    {
+        // A hop of every sounding voice at a time, buffered across blocks
+        if (m_spectralPatch)
+            voiceMask = m_spectralBank.Render(*m_spectralPatch, pVoices, nFrames, 1.0 / timeStep,
+                                              (float)VOICE_GAIN);
+    }
+    else
+    {
+        for (unsigned int v = 0; v < MAX_VOICES; v++)
+        {
+            if (!m_voices[v].active)
+                continue;
+            RenderVoice(m_voices[v], pVoices + v, MAX_VOICES, nFrames, dTime, timeStep,
+                        pDecode);
+            voiceMask |= 1u << v;
+        }
+    }
+    if (voiceMask == 0)
+        return;
+
+    FilterMode filterMode = (FilterMode)m_blockParams.GetInt(ParamId::FilterMode);
+    if (filterMode != FilterMode::Off)
+    {
+        ScopedStageTimer filterTimer(m_renderStats, RenderStage::Filter);
+        SvfBank::Mode mode = filterMode == FilterMode::Highpass   ? SvfBank::Mode::Highpass
+                             : filterMode == FilterMode::Bandpass ? SvfBank::Mode::Bandpass
+                                                                  : SvfBank::Mode::Lowpass;
+        // Coefficients are set once per block, so the smoothed value is taken at block end
+        float cutoff = m_blockParams.Get(ParamId::FilterCutoff);
+        float resonance = m_blockParams.Get(ParamId::FilterResonance);
+        for (unsigned int v = 0; v < MAX_VOICES; v++)
+        {
+            if (voiceMask & (1u << v))
+                m_filterBank.UpdateVoice(v, mode, cutoff, resonance, 1.0 / timeStep);
+        }
+        m_filterBank.Process(pVoices, nFrames, voiceMask);
+    }
+
+    for (unsigned int v = 0; v < MAX_VOICES; v++)
+    {
+        if (!(voiceMask & (1u << v)))
+            continue;
+
+        const float* pVoice = pVoices + v;
+        if (nChannels == 1)
+        {
+            for (unsigned int n = 0; n < nFrames; n++)
+                ppChannels[0][n] += pVoice[n * MAX_VOICES];
+            continue;
+        }
+
+        // Constant-power pan, scaled so a centred voice keeps its mono level in each channel
+        double theta = (m_voices[v].pan + 1.0) * PI * 0.25;
+        float gainL = (float)(cos(theta) * sqrt(2.0));
+        float gainR = (float)(sin(theta) * sqrt(2.0));
+        for (unsigned int n = 0; n < nFrames; n++)
+        {
+            ppChannels[0][n] += pVoice[n * MAX_VOICES] * gainL;
+            ppChannels[1][n] += pVoice[n * MAX_VOICES] * gainR;
+        }
+    }
 }
 
-double AudioManager::MakeSineNoise(double dTime)
+void AudioManager::RenderVoice(Voice& voice, float* pOut, unsigned int stride,
+                               unsigned int nFrames, double dTime, double timeStep,
+                               float* pDecode)
 {
-    std::lock_guard<std::mutex> lock(m_notesMutex);
-    double dOutput = 0.0;
-    for (const auto& key : m_activeNotes)
+    SYNTH_TRACE_SCOPE("Voice");
+    WaveType waveType = (WaveType)m_blockParams.GetInt(ParamId::WaveType);
+    if (waveType == WaveType::Sampler)
+    {
+        // A finished one-shot sample stays silent until the key is released
+        auto interpolation =
+            (SamplerInterpolation)m_blockParams.GetInt(ParamId::SamplerInterpolation);
+        RenderSampler(voice.sampler, m_instrument ? m_instrument->GetStreamer() : nullptr,
+                      interpolation, voice.freq, 1.0 / timeStep, (float)VOICE_GAIN, pOut, stride,
+                      nFrames, pDecode);
+    }
+    else if (waveType == WaveType::Square)
     {
-        double freq = key.second;
-        dOutput += SineSoundMaker(freq, dTime);
+        for (unsigned int n = 0; n < nFrames; n++)
+            pOut[n * stride] =
+                (float)(SquareSoundMaker(voice.freq, dTime + n * timeStep) * VOICE_GAIN);
+    }
+    else
+    {
+        for (unsigned int n = 0; n < nFrames; n++)
+            pOut[n * stride] =
+                (float)(SineSoundMaker(voice.freq, dTime + n * timeStep) * VOICE_GAIN);
     }
-    return dOutput * 0.5;
 }
 
-double AudioManager::MakeSquareNoise(double dTime)
+void AudioManager::ApplyDrive(float* const* ppChannels, unsigned int nChannels,
+                              unsigned int nFrames) const
 {
-    std::lock_guard<std::mutex> lock(m_notesMutex);
-    double dOutput = 0.0;
-    for (const auto& key : m_activeNotes)
+    float startDrive = m_blockParams.GetStart(ParamId::Drive);
+    float endDrive = m_blockParams.Get(ParamId::Drive);
+    if (startDrive <= 0.0f && endDrive <= 0.0f)
+        return;
+
+    // tanh waveshaper, normalised so a full-scale input still peaks at full scale. Gain and
+    // makeup ramp linearly across the block while the drive knob is moving.
+    float startGain = 1.0f + startDrive * (DRIVE_MAX_GAIN - 1.0f);
+    float endGain = 1.0f + endDrive * (DRIVE_MAX_GAIN - 1.0f);
+    float startMakeup = 1.0f / std::tanh(startGain);
+    float endMakeup = 1.0f / std::tanh(endGain);
+    float gainStep = (endGain - startGain) / nFrames;
+    float makeupStep = (endMakeup - startMakeup) / nFrames;
+    for (unsigned int c = 0; c < nChannels; c++)
     {
-        double freq = key.second;
-        dOutput += SquareSoundMaker(freq, dTime);
+        float gain = startGain;
+        float makeup = startMakeup;
+        for (unsigned int n = 0; n < nFrames; n++)
+        {
+            gain += gainStep;
+            makeup += makeupStep;
+            ppChannels[c][n] = std::tanh(ppChannels[c][n] * gain) * makeup;
+        }
     }
-    return dOutput * 0.5;
 }
 
-void AudioManager::MapNoteFrequency(WPARAM wParam)
+double AudioManager::SineSoundMaker(double freq, double dTime) const
+{
+    return sin(freq * TWO_PI * dTime);
+}
+
+double AudioManager::SquareSoundMaker(double freq, double dTime) const
+{
+    // Simple and efficient square wave: returns 1 or -1
+    double phase = fmod(freq * dTime, 1.0);
+    return (phase < 0.5) ? 1.0 : -1.0;
+}
+
+double AudioManager::MapNoteFrequency(KeyCode key) const
 {
     using namespace NoteFrequencies;
     using namespace VirtualKeys;
@@ -168,43 +945,41 @@ void AudioManager::MapNoteFrequency(WPARAM wParam)
     double noteFreq = 0.0;
 
     // Top row: QWERTYUIOP maps to C5-E6
-    if (wParam == Q)
+    if (key == Q)
         noteFreq = C5;
-    else if (wParam == W)
+    else if (key == W)
         noteFreq = D5;
-    else if (wParam == E)
+    else if (key == E)
         noteFreq = E5;
-    else if (wParam == R)
+    else if (key == R)
         noteFreq = F5;
-    else if (wParam == T)
+    else if (key == T)
         noteFreq = G5;
-    else if (wParam == Y)
+    else if (key == Y)
         noteFreq = A5;
-    else if (wParam == U)
+    else if (key == U)
         noteFreq = B5;
-    else if (wParam == I)
+    else if (key == I)
         noteFreq = C6;
-    else if (wParam == O)
+    else if (key == O)
         noteFreq = D6;
-    else if (wParam == P)
+    else if (key == P)
         noteFreq = E6;
     // Bottom row: ZXCVBNM maps to C4-B4
-    else if (wParam == Z)
+    else if (key == Z)
         noteFreq = C4;
-    else if (wParam == X)
+    else if (key == X)
         noteFreq = D4;
-    else if (wParam == C)
+    else if (key == C)
         noteFreq = E4;
-    else if (wParam == V)
+    else if (key == V)
         noteFreq = F4;
-    else if (wParam == B)
+    else if (key == B)
         noteFreq = G4;
-    else if (wParam == N)
+    else if (key == N)
         noteFreq = A4;
-    else if (wParam == M)
+    else if (key == M)
         noteFreq = B4;
-    else
-        return; // Unknown key
 
-    m_activeNotes[wParam] = noteFreq;
+    return noteFreq; // 0 for keys that are not mapped to a note
 }
\ No newline at end of file
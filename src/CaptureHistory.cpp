@@ -0,0 +1,113 @@
+#include "CaptureHistory.h"
+
+#include "WavFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+// Longer than any device block, so the block being written when a save looks is never in it
+constexpr double SLACK_SECONDS = 1.0;
+} // namespace
+
+CaptureHistory::CaptureHistory(double seconds, unsigned int sampleRate, unsigned int channels,
+                               Format format)
+    : m_sampleRate(sampleRate), m_channels(channels), m_format(format),
+      m_frameBytes(channels * (format == Format::Int16 ? sizeof(int16_t) : sizeof(int32_t))),
+      m_historyFrames((size_t)ceil(seconds * sampleRate)),
+      m_capacityFrames(m_historyFrames + (size_t)ceil(SLACK_SECONDS * sampleRate)),
+      m_ring(std::make_unique<unsigned char[]>(m_capacityFrames * m_frameBytes))
+{
+}
+
+CaptureHistory::~CaptureHistory()
+{
+    if (m_saveThread.joinable())
+        m_saveThread.join();
+}
+
+void CaptureHistory::Write(const int32_t* pFrames, unsigned int nChannels, unsigned int nFrames)
+{
+    if (nChannels != m_channels)
+        return;
+    uint64_t position = m_written.load(std::memory_order_relaxed);
+    size_t start = (size_t)(position % m_capacityFrames);
+    size_t first = std::min((size_t)nFrames, m_capacityFrames - start);
+    CopyIn(pFrames, start, first);
+    CopyIn(pFrames + first * nChannels, 0, nFrames - first);
+    m_written.store(position + nFrames, std::memory_order_release);
+}
+
+bool CaptureHistory::SaveAsync(const std::filesystem::path& path, std::string* error)
+{
+    if (IsSaving())
+    {
+        if (error)
+            *error = "still saving";
+        return false;
+    }
+    if (m_saveThread.joinable())
+        m_saveThread.join();
+    m_saveError.clear();
+    m_saving.store(true, std::memory_order_relaxed);
+    m_saveThread = std::thread(&CaptureHistory::Save, this, path);
+    return true;
+}
+
+double CaptureHistory::GetFilledSeconds() const
+{
+    uint64_t written = m_written.load(std::memory_order_relaxed);
+    return (double)std::min<uint64_t>(written, m_historyFrames) / m_sampleRate;
+}
+
+void CaptureHistory::CopyIn(const int32_t* pIn, size_t frame, size_t frames)
+{
+    const size_t count = frames * m_channels;
+    if (m_format == Format::Int32)
+    {
+        memcpy(m_ring.get() + frame * m_frameBytes, pIn, count * sizeof(int32_t));
+        return;
+    }
+    // One narrowing pass, which vectorises to the same cost as the copy
+    int16_t* pOut = (int16_t*)m_ring.get() + frame * m_channels;
+    for (size_t i = 0; i < count; i++)
+        pOut[i] = (int16_t)(pIn[i] >> 16);
+}
+
+void CaptureHistory::Save(std::filesystem::path path)
+{
+    // Snapshot the newest frames at memcpy speed; the disk can then take as long as it likes
+    const uint64_t end = m_written.load(std::memory_order_acquire);
+    const uint64_t frames = std::min<uint64_t>(end, m_historyFrames);
+    const uint64_t begin = end - frames;
+    std::vector<unsigned char> data((size_t)frames * m_frameBytes);
+    size_t start = (size_t)(begin % m_capacityFrames);
+    size_t first = std::min((size_t)frames, m_capacityFrames - start);
+    memcpy(data.data(), m_ring.get() + start * m_frameBytes, first * m_frameBytes);
+    memcpy(data.data() + first * m_frameBytes, m_ring.get(),
+           ((size_t)frames - first) * m_frameBytes);
+
+    // Drop any frames the render thread reached while they were copied, slack included, so a
+    // save stalled for longer than the slack still writes only whole, untorn audio
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t written = m_written.load(std::memory_order_relaxed);
+    const uint64_t reach = written + (m_capacityFrames - m_historyFrames);
+    const uint64_t overwritten = reach > m_capacityFrames ? reach - m_capacityFrames : 0;
+    const size_t skip = (size_t)std::min(overwritten > begin ? overwritten - begin : 0, frames);
+    const size_t keptBytes = ((size_t)frames - skip) * m_frameBytes;
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    const unsigned int bits = m_format == Format::Int16 ? 16 : 32;
+    WriteWavHeader(file, m_sampleRate, m_channels, bits, false, (uint32_t)keptBytes);
+    // Little-endian hosts only, like the rest of the engine
+    file.write((const char*)data.data() + skip * m_frameBytes, (std::streamsize)keptBytes);
+    file.close();
+
+    m_saveError = file.fail() ? "could not write " + path.string() : std::string();
+    m_savedSeconds = (double)(frames - skip) / m_sampleRate;
+    m_saving.store(false, std::memory_order_release);
+}
@@ -0,0 +1,267 @@
+#include "ConvolutionReverb.h"
+#include "Denormals.h"
+#include "Resampler.h"
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+namespace
+{
+unsigned int NextPowerOfTwo(size_t n)
+{
+    unsigned int p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+} // namespace
+
+void PartitionedConvolver::Prepare(const float* const* ppIr, unsigned int nChannels,
+                                   size_t length, unsigned int partitionSize)
+{
+    m_partitionSize = partitionSize;
+    m_channels = nChannels;
+    m_fft.Prepare(partitionSize * 2);
+    m_binCount = m_fft.GetBinCount();
+    m_partitionCount = (unsigned int)((length + partitionSize - 1) / partitionSize);
+    m_fdlIndex = 0;
+
+    size_t spectrumSize = (size_t)m_partitionCount * m_binCount;
+    m_irRe.assign(spectrumSize * nChannels, 0.0f);
+    m_irIm.assign(spectrumSize * nChannels, 0.0f);
+    m_fdlRe.assign(spectrumSize, 0.0f);
+    m_fdlIm.assign(spectrumSize, 0.0f);
+    m_frame.assign(partitionSize * 2, 0.0f);
+    m_accRe.assign(m_binCount, 0.0f);
+    m_accIm.assign(m_binCount, 0.0f);
+    m_time.assign(partitionSize * 2, 0.0f);
+
+    // Each partition is zero-padded to twice its length before transforming
+    std::vector<float> padded(partitionSize * 2);
+    for (unsigned int c = 0; c < nChannels; c++)
+    {
+        for (unsigned int p = 0; p < m_partitionCount; p++)
+        {
+            std::fill(padded.begin(), padded.end(), 0.0f);
+            size_t start = (size_t)p * partitionSize;
+            size_t count = std::min((size_t)partitionSize, length - start);
+            std::copy(ppIr[c] + start, ppIr[c] + start + count, padded.begin());
+            size_t offset = (c * spectrumSize) + (size_t)p * m_binCount;
+            m_fft.Forward(padded.data(), m_irRe.data() + offset, m_irIm.data() + offset);
+        }
+    }
+}
+
+void PartitionedConvolver::Process(const float* pIn, float* const* ppOut)
+{
+    const unsigned int P = m_partitionSize;
+    std::copy(m_frame.begin() + P, m_frame.end(), m_frame.begin());
+    std::copy(pIn, pIn + P, m_frame.begin() + P);
+
+    m_fdlIndex = (m_fdlIndex + m_partitionCount - 1) % m_partitionCount;
+    float* pNewRe = m_fdlRe.data() + (size_t)m_fdlIndex * m_binCount;
+    float* pNewIm = m_fdlIm.data() + (size_t)m_fdlIndex * m_binCount;
+    m_fft.Forward(m_frame.data(), pNewRe, pNewIm);
+
+    size_t spectrumSize = (size_t)m_partitionCount * m_binCount;
+    for (unsigned int c = 0; c < m_channels; c++)
+    {
+        std::fill(m_accRe.begin(), m_accRe.end(), 0.0f);
+        std::fill(m_accIm.begin(), m_accIm.end(), 0.0f);
+        float* accRe = m_accRe.data();
+        float* accIm = m_accIm.data();
+
+        // Partition p of the IR meets the input spectrum from p partitions ago
+        for (unsigned int p = 0; p < m_partitionCount; p++)
+        {
+            size_t slot = (size_t)((m_fdlIndex + p) % m_partitionCount) * m_binCount;
+            const float* xr = m_fdlRe.data() + slot;
+            const float* xi = m_fdlIm.data() + slot;
+            const float* hr = m_irRe.data() + c * spectrumSize + (size_t)p * m_binCount;
+            const float* hi = m_irIm.data() + c * spectrumSize + (size_t)p * m_binCount;
+            for (unsigned int k = 0; k < m_binCount; k++)
+            {
+                accRe[k] += xr[k] * hr[k] - xi[k] * hi[k];
+                accIm[k] += xr[k] * hi[k] + xi[k] * hr[k];
+            }
+        }
+
+        // Overlap-save: only the second half of the circular result is alias-free
+        m_fft.Inverse(accRe, accIm, m_time.data());
+        std::copy(m_time.begin() + P, m_time.end(), ppOut[c]);
+    }
+}
+
+ConvolutionReverb::~ConvolutionReverb()
+{
+    if (m_tailThread.joinable())
+    {
+        m_running.store(false, std::memory_order_release);
+        m_wake.fetch_add(1, std::memory_order_release);
+        m_wake.notify_all();
+        m_tailThread.join();
+    }
+}
+
+bool ConvolutionReverb::Prepare(const WavData& ir, double sampleRate, unsigned int blockSize)
+{
+    if (ir.channels.empty() || ir.GetFrameCount() == 0 || ir.sampleRate == 0 || blockSize == 0)
+        return false;
+
+    m_channels = std::min((unsigned int)ir.channels.size(), 2u);
+    std::vector<std::vector<float>> channels(ir.channels.begin(), ir.channels.begin() + m_channels);
+    if (ir.sampleRate != (unsigned int)sampleRate)
+    {
+        for (std::vector<float>& channel : channels)
+            channel = ResampleSignal(channel, ir.sampleRate, sampleRate);
+    }
+    m_length = channels[0].size();
+
+    // Normalise so the louder channel has unit energy, keeping wildly hot IRs usable
+    double energy = 0.0;
+    for (const std::vector<float>& channel : channels)
+    {
+        double sum = 0.0;
+        for (float s : channel)
+            sum += (double)s * s;
+        energy = std::max(energy, sum);
+    }
+    float gain = energy > 0.0 ? (float)(1.0 / sqrt(energy)) : 0.0f;
+    for (std::vector<float>& channel : channels)
+        for (float& s : channel)
+            s *= gain;
+
+    m_blockSize = blockSize;
+    m_tailPartition = blockSize * TAIL_FACTOR;
+    m_headLength = (unsigned int)std::min(m_length, (size_t)m_tailPartition * 2);
+
+    const float* heads[2] = {channels[0].data(), channels[m_channels - 1].data()};
+    m_head.Prepare(heads, m_channels, m_headLength, blockSize);
+    m_input.assign(blockSize, 0.0f);
+    for (std::vector<float>& out : m_headOut)
+        out.assign(blockSize, 0.0f);
+
+    m_hasTail = m_length > m_headLength;
+    if (!m_hasTail)
+        return true;
+
+    const float* tails[2] = {channels[0].data() + m_headLength,
+                             channels[m_channels - 1].data() + m_headLength};
+    m_tail.Prepare(tails, m_channels, m_length - m_headLength, m_tailPartition);
+
+    unsigned int ringSize = NextPowerOfTwo((size_t)m_tailPartition * 4);
+    m_ringMask = ringSize - 1;
+    m_tailInputRing.assign(ringSize, 0.0f);
+    for (std::vector<float>& ring : m_tailOutputRing)
+        ring.assign(ringSize, 0.0f);
+    m_tailChunkIn.assign(m_tailPartition, 0.0f);
+    for (std::vector<float>& out : m_tailChunkOut)
+        out.assign(m_tailPartition, 0.0f);
+
+    // Nothing from the tail is due before the head has played out
+    m_tailReadyEnd.store(m_headLength, std::memory_order_relaxed);
+    m_running.store(true, std::memory_order_release);
+    m_tailThread = std::thread(&ConvolutionReverb::TailLoop, this);
+    return true;
+}
+
+void ConvolutionReverb::Process(float* pLeft, float* pRight, unsigned int nFrames, float mix)
+{
+    if (nFrames != m_blockSize)
+        return;
+
+    for (unsigned int n = 0; n < nFrames; n++)
+        m_input[n] = 0.5f * (pLeft[n] + pRight[n]);
+
+    float* headOut[2] = {m_headOut[0].data(), m_headOut[1].data()};
+    m_head.Process(m_input.data(), headOut);
+    float* pWetL = headOut[0];
+    float* pWetR = headOut[m_channels - 1];
+
+    if (m_hasTail)
+    {
+        for (unsigned int n = 0; n < nFrames; n++)
+            m_tailInputRing[(m_renderPosition + n) & m_ringMask] = m_input[n];
+        m_inputWritten.store(m_renderPosition + nFrames, std::memory_order_release);
+        m_wake.fetch_add(1, std::memory_order_release);
+        m_wake.notify_one();
+
+        // A late tail is dropped for this block rather than waited for
+        if (m_tailReadyEnd.load(std::memory_order_acquire) >= m_renderPosition + nFrames)
+        {
+            for (unsigned int c = 0; c < m_channels; c++)
+            {
+                const std::vector<float>& ring = m_tailOutputRing[c];
+                for (unsigned int n = 0; n < nFrames; n++)
+                    headOut[c][n] += ring[(m_renderPosition + n) & m_ringMask];
+            }
+        }
+        else
+        {
+            m_tailMisses.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    for (unsigned int n = 0; n < nFrames; n++)
+    {
+        pLeft[n] += pWetL[n] * mix;
+        pRight[n] += pWetR[n] * mix;
+    }
+    m_renderPosition += nFrames;
+}
+
+void ConvolutionReverb::TailLoop()
+{
+    ScopedFlushDenormals flushDenormals;
+    SYNTH_TRACE_THREAD("ConvolutionTail");
+    const unsigned int L = m_tailPartition;
+    const uint64_t ringSize = (uint64_t)m_ringMask + 1;
+    uint64_t chunkStart = 0;
+    float* chunkOut[2] = {m_tailChunkOut[0].data(), m_tailChunkOut[1].data()};
+
+    while (m_running.load(std::memory_order_acquire))
+    {
+        uint32_t wake = m_wake.load(std::memory_order_acquire);
+        uint64_t written = m_inputWritten.load(std::memory_order_acquire);
+        if (written < chunkStart + L)
+        {
+            m_wake.wait(wake, std::memory_order_acquire);
+            continue;
+        }
+        if (written - chunkStart > ringSize - L)
+        {
+            // Fell so far behind that the input was overwritten; skip to the newest chunk. The
+            // output skipped over still holds a lap-old tail, so it is silenced before the ready
+            // end moves past it.
+            uint64_t skipEnd = (written / L - 1) * L + m_headLength;
+            uint64_t skipStart = chunkStart + m_headLength;
+            if (skipEnd + L > ringSize) // Only the last lap of the ring short of the new chunk
+                skipStart = std::max(skipStart, skipEnd + L - ringSize);
+            for (unsigned int c = 0; c < m_channels; c++)
+                for (uint64_t p = skipStart; p < skipEnd; p++)
+                    m_tailOutputRing[c][p & m_ringMask] = 0.0f;
+            chunkStart = (written / L - 1) * L;
+            m_tailMisses.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int n = 0; n < L; n++)
+            m_tailChunkIn[n] = m_tailInputRing[(chunkStart + n) & m_ringMask];
+        m_tail.Process(m_tailChunkIn.data(), chunkOut);
+
+        uint64_t outputStart = chunkStart + m_headLength;
+        for (unsigned int c = 0; c < m_channels; c++)
+            for (unsigned int n = 0; n < L; n++)
+                m_tailOutputRing[c][(outputStart + n) & m_ringMask] = chunkOut[c][n];
+        m_tailReadyEnd.store(outputStart + L, std::memory_order_release);
+        chunkStart += L;
+
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - start;
+        double average = m_tailAverageMs.load(std::memory_order_relaxed);
+        m_tailAverageMs.store(average + (elapsed.count() - average) * 0.1,
+                              std::memory_order_relaxed);
+    }
+}
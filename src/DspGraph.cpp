@@ -0,0 +1,472 @@
+#include "DspGraph.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+constexpr double GRAPH_PI = 3.14159265358979323846;
+constexpr unsigned int FILTER_CONTROL_INTERVAL = 16; // Samples between cutoff updates
+constexpr unsigned int ZERO_SLOT = 0;
+
+class VoiceBusNode : public DspNode
+{
+public:
+    void Process(const GraphContext& context, const float* const*, float* const* ppOutputs) override
+    {
+        std::memcpy(ppOutputs[0], context.voiceLeft, context.nFrames * sizeof(float));
+        std::memcpy(ppOutputs[1], context.voiceRight, context.nFrames * sizeof(float));
+    }
+};
+
+class OscillatorNode : public DspNode
+{
+public:
+    OscillatorNode(const float* params, double sampleRate)
+        : m_wave((int)params[0]), m_increment(params[1] / sampleRate), m_amplitude(params[2]),
+          m_offset(params[3])
+    {
+    }
+
+    void Process(const GraphContext& context, const float* const*, float* const* ppOutputs) override
+    {
+        float* pOut = ppOutputs[0];
+        for (unsigned int n = 0; n < context.nFrames; n++)
+        {
+            float value;
+            if (m_wave == 1)
+                value = m_phase < 0.5 ? 1.0f : -1.0f;
+            else if (m_wave == 2)
+                value = (float)(2.0 * m_phase - 1.0);
+            else
+                value = (float)sin(2.0 * GRAPH_PI * m_phase);
+            pOut[n] = value * m_amplitude + m_offset;
+            m_phase += m_increment;
+            m_phase -= floor(m_phase);
+        }
+    }
+
+private:
+    int m_wave;
+    double m_increment;
+    float m_amplitude;
+    float m_offset;
+    double m_phase = 0.0;
+};
+
+class EnvelopeNode : public DspNode
+{
+public:
+    EnvelopeNode(const float* params, double sampleRate)
+        : m_attack(OnePole(params[0], sampleRate)), m_release(OnePole(params[1], sampleRate))
+    {
+    }
+
+    void Process(const GraphContext& context, const float* const*, float* const* ppOutputs) override
+    {
+        float target = context.gate ? 1.0f : 0.0f;
+        float coeff = context.gate ? m_attack : m_release;
+        float* pOut = ppOutputs[0];
+        for (unsigned int n = 0; n < context.nFrames; n++)
+        {
+            m_level += (target - m_level) * coeff;
+            pOut[n] = m_level;
+        }
+    }
+
+private:
+    static float OnePole(float ms, double sampleRate)
+    {
+        return (float)(1.0 - exp(-1.0 / (std::max(ms, 0.1f) * 0.001 * sampleRate)));
+    }
+
+    float m_attack;
+    float m_release;
+    float m_level = 0.0f;
+};
+
+// Scalar TPT state-variable filter; the cutoff input is in octaves, scaled by the depth param
+class FilterNode : public DspNode
+{
+public:
+    FilterNode(const float* params, double sampleRate)
+        : m_mode((int)params[0]), m_cutoff(params[1]), m_resonance(params[2]),
+          m_depth(params[3]), m_sampleRate(sampleRate)
+    {
+    }
+
+    void Process(const GraphContext& context, const float* const* ppInputs,
+                 float* const* ppOutputs) override
+    {
+        const float* pIn = ppInputs[0];
+        const float* pMod = ppInputs[1];
+        float* pOut = ppOutputs[0];
+        double k = 2.0 - 2.0 * std::clamp(m_resonance, 0.0f, 0.98f);
+        for (unsigned int start = 0; start < context.nFrames; start += FILTER_CONTROL_INTERVAL)
+        {
+            double cutoff = m_cutoff * exp2(pMod[start] * m_depth);
+            cutoff = std::clamp(cutoff, 10.0, m_sampleRate * 0.49);
+            double g = tan(GRAPH_PI * cutoff / m_sampleRate);
+            float a1 = (float)(1.0 / (1.0 + g * (g + k)));
+            float a2 = (float)g * a1;
+            float a3 = (float)g * a2;
+
+            unsigned int end = std::min(start + FILTER_CONTROL_INTERVAL, context.nFrames);
+            for (unsigned int n = start; n < end; n++)
+            {
+                float v3 = pIn[n] - m_ic2;
+                float v1 = a1 * m_ic1 + a2 * v3;
+                float v2 = m_ic2 + a2 * m_ic1 + a3 * v3;
+                m_ic1 = 2.0f * v1 - m_ic1;
+                m_ic2 = 2.0f * v2 - m_ic2;
+                if (m_mode == 1)
+                    pOut[n] = v1;
+                else if (m_mode == 2)
+                    pOut[n] = pIn[n] - (float)k * v1 - v2;
+                else
+                    pOut[n] = v2;
+            }
+        }
+    }
+
+private:
+    int m_mode;
+    float m_cutoff;
+    float m_resonance;
+    float m_depth;
+    double m_sampleRate;
+    float m_ic1 = 0.0f;
+    float m_ic2 = 0.0f;
+};
+
+class MixerNode : public DspNode
+{
+public:
+    explicit MixerNode(const float* params)
+    {
+        std::copy(params, params + DspGraph::MAX_INPUTS, m_gains);
+    }
+
+    void Process(const GraphContext& context, const float* const* ppInputs,
+                 float* const* ppOutputs) override
+    {
+        float* pOut = ppOutputs[0];
+        for (unsigned int n = 0; n < context.nFrames; n++)
+            pOut[n] = ppInputs[0][n] * m_gains[0] + ppInputs[1][n] * m_gains[1] +
+                      ppInputs[2][n] * m_gains[2] + ppInputs[3][n] * m_gains[3];
+    }
+
+private:
+    float m_gains[DspGraph::MAX_INPUTS];
+};
+
+class MultiplyNode : public DspNode
+{
+public:
+    void Process(const GraphContext& context, const float* const* ppInputs,
+                 float* const* ppOutputs) override
+    {
+        for (unsigned int n = 0; n < context.nFrames; n++)
+            ppOutputs[0][n] = ppInputs[0][n] * ppInputs[1][n];
+    }
+};
+
+class EffectsNode : public DspNode
+{
+public:
+    void Process(const GraphContext& context, const float* const* ppInputs,
+                 float* const* ppOutputs) override
+    {
+        std::memcpy(ppOutputs[0], ppInputs[0], context.nFrames * sizeof(float));
+        std::memcpy(ppOutputs[1], ppInputs[1], context.nFrames * sizeof(float));
+        context.effectsChain->Process(ppOutputs[0], ppOutputs[1], context.nFrames,
+                                      *context.effects);
+    }
+};
+
+class OutputNode : public DspNode
+{
+public:
+    void Process(const GraphContext& context, const float* const* ppInputs, float* const*) override
+    {
+        std::memmove(context.outputLeft, ppInputs[0], context.nFrames * sizeof(float));
+        std::memmove(context.outputRight, ppInputs[1], context.nFrames * sizeof(float));
+    }
+};
+
+std::unique_ptr<DspNode> CreateNode(const DspGraph::Node& node, double sampleRate)
+{
+    switch (node.type)
+    {
+    case DspGraph::NodeType::VoiceBus:
+        return std::make_unique<VoiceBusNode>();
+    case DspGraph::NodeType::Oscillator:
+        return std::make_unique<OscillatorNode>(node.params, sampleRate);
+    case DspGraph::NodeType::Envelope:
+        return std::make_unique<EnvelopeNode>(node.params, sampleRate);
+    case DspGraph::NodeType::Filter:
+        return std::make_unique<FilterNode>(node.params, sampleRate);
+    case DspGraph::NodeType::Mixer:
+        return std::make_unique<MixerNode>(node.params);
+    case DspGraph::NodeType::Multiply:
+        return std::make_unique<MultiplyNode>();
+    case DspGraph::NodeType::Effects:
+        return std::make_unique<EffectsNode>();
+    case DspGraph::NodeType::Output:
+        return std::make_unique<OutputNode>();
+    }
+    return nullptr;
+}
+} // namespace
+
+int DspGraph::AddNode(NodeType type, std::initializer_list<float> params)
+{
+    Node node;
+    node.type = type;
+    unsigned int n = 0;
+    for (float param : params)
+        if (n < MAX_PARAMS)
+            node.params[n++] = param;
+    m_nodes.push_back(node);
+    return (int)m_nodes.size() - 1;
+}
+
+bool DspGraph::Connect(int fromNode, unsigned int fromPort, int toNode, unsigned int toPort)
+{
+    if (fromNode < 0 || toNode < 0 || fromNode >= (int)m_nodes.size() ||
+        toNode >= (int)m_nodes.size())
+        return false;
+    if (fromPort >= GetOutputCount(m_nodes[fromNode].type) ||
+        toPort >= GetInputCount(m_nodes[toNode].type))
+        return false;
+    m_nodes[toNode].inputs[toPort] = PortRef{fromNode, fromPort};
+    return true;
+}
+
+unsigned int DspGraph::GetInputCount(NodeType type)
+{
+    switch (type)
+    {
+    case NodeType::Filter:
+    case NodeType::Multiply:
+    case NodeType::Effects:
+    case NodeType::Output:
+        return 2;
+    case NodeType::Mixer:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+unsigned int DspGraph::GetOutputCount(NodeType type)
+{
+    switch (type)
+    {
+    case NodeType::VoiceBus:
+    case NodeType::Effects:
+        return 2;
+    case NodeType::Output:
+        return 0;
+    default:
+        return 1;
+    }
+}
+
+DspGraph MakeDirectGraph()
+{
+    DspGraph graph;
+    int voices = graph.AddNode(DspGraph::NodeType::VoiceBus);
+    int effects = graph.AddNode(DspGraph::NodeType::Effects);
+    int output = graph.AddNode(DspGraph::NodeType::Output);
+    graph.Connect(voices, 0, effects, 0);
+    graph.Connect(voices, 1, effects, 1);
+    graph.Connect(effects, 0, output, 0);
+    graph.Connect(effects, 1, output, 1);
+    return graph;
+}
+
+DspGraph MakeEnvelopeFilterGraph()
+{
+    DspGraph graph;
+    int voices = graph.AddNode(DspGraph::NodeType::VoiceBus);
+    int envelope = graph.AddNode(DspGraph::NodeType::Envelope, {300.0f, 600.0f});
+    int filterL = graph.AddNode(DspGraph::NodeType::Filter, {0.0f, 300.0f, 0.6f, 4.0f});
+    int filterR = graph.AddNode(DspGraph::NodeType::Filter, {0.0f, 300.0f, 0.6f, 4.0f});
+    int effects = graph.AddNode(DspGraph::NodeType::Effects);
+    int output = graph.AddNode(DspGraph::NodeType::Output);
+    graph.Connect(voices, 0, filterL, 0);
+    graph.Connect(voices, 1, filterR, 0);
+    graph.Connect(envelope, 0, filterL, 1);
+    graph.Connect(envelope, 0, filterR, 1);
+    graph.Connect(filterL, 0, effects, 0);
+    graph.Connect(filterR, 0, effects, 1);
+    graph.Connect(effects, 0, output, 0);
+    graph.Connect(effects, 1, output, 1);
+    return graph;
+}
+
+DspGraph MakeTremoloGraph()
+{
+    DspGraph graph;
+    int voices = graph.AddNode(DspGraph::NodeType::VoiceBus);
+    int lfo = graph.AddNode(DspGraph::NodeType::Oscillator, {0.0f, 5.0f, 0.4f, 0.6f});
+    int vcaL = graph.AddNode(DspGraph::NodeType::Multiply);
+    int vcaR = graph.AddNode(DspGraph::NodeType::Multiply);
+    int effects = graph.AddNode(DspGraph::NodeType::Effects);
+    int output = graph.AddNode(DspGraph::NodeType::Output);
+    graph.Connect(voices, 0, vcaL, 0);
+    graph.Connect(voices, 1, vcaR, 0);
+    graph.Connect(lfo, 0, vcaL, 1);
+    graph.Connect(lfo, 0, vcaR, 1);
+    graph.Connect(vcaL, 0, effects, 0);
+    graph.Connect(vcaR, 0, effects, 1);
+    graph.Connect(effects, 0, output, 0);
+    graph.Connect(effects, 1, output, 1);
+    return graph;
+}
+
+void CompiledGraph::Process(const GraphContext& context)
+{
+    for (Step& step : m_steps)
+        step.node->Process(context, step.inputs, step.outputs);
+}
+
+std::unique_ptr<CompiledGraph> CompileGraph(const DspGraph& graph, double sampleRate,
+                                            unsigned int maxFrames, std::string* error)
+{
+    const std::vector<DspGraph::Node>& nodes = graph.GetNodes();
+    const size_t count = nodes.size();
+    auto fail = [error](const char* message) {
+        if (error)
+            *error = message;
+        return std::unique_ptr<CompiledGraph>();
+    };
+
+    int outputNode = -1;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (nodes[i].type != DspGraph::NodeType::Output)
+            continue;
+        if (outputNode >= 0)
+            return fail("Graph has more than one Output node");
+        outputNode = (int)i;
+    }
+    if (outputNode < 0)
+        return fail("Graph has no Output node");
+
+    // Kahn's algorithm; the Output node is held back so it always runs last, which lets it
+    // write over the voice buffers that VoiceBus nodes read from
+    std::vector<unsigned int> indegree(count, 0);
+    std::vector<std::vector<int>> readers(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (unsigned int p = 0; p < DspGraph::GetInputCount(nodes[i].type); p++)
+        {
+            int source = nodes[i].inputs[p].node;
+            if (source < 0)
+                continue;
+            indegree[i]++;
+            readers[source].push_back((int)i);
+        }
+    }
+    std::vector<int> order;
+    std::vector<int> ready;
+    for (size_t i = 0; i < count; i++)
+        if (indegree[i] == 0 && (int)i != outputNode)
+            ready.push_back((int)i);
+    while (!ready.empty())
+    {
+        int node = ready.back();
+        ready.pop_back();
+        order.push_back(node);
+        for (int reader : readers[node])
+            if (--indegree[reader] == 0 && reader != outputNode)
+                ready.push_back(reader);
+    }
+    if (indegree[outputNode] != 0 || order.size() != count - 1)
+        return fail("Graph contains a cycle");
+    order.push_back(outputNode);
+
+    // Last step that reads each output port
+    std::vector<int> position(count);
+    for (size_t s = 0; s < order.size(); s++)
+        position[order[s]] = (int)s;
+    std::vector<int> lastUse(count * DspGraph::MAX_OUTPUTS, -1);
+    for (size_t i = 0; i < count; i++)
+    {
+        for (unsigned int p = 0; p < DspGraph::GetInputCount(nodes[i].type); p++)
+        {
+            const DspGraph::PortRef& ref = nodes[i].inputs[p];
+            if (ref.node < 0)
+                continue;
+            int& last = lastUse[ref.node * DspGraph::MAX_OUTPUTS + ref.port];
+            last = std::max(last, position[i]);
+        }
+    }
+
+    // Linear-scan slot assignment. Outputs are allocated before the step's dead inputs are
+    // released, so no node ever reads and writes the same slot.
+    std::vector<unsigned int> slotOf(count * DspGraph::MAX_OUTPUTS, ZERO_SLOT);
+    std::vector<unsigned int> freeSlots;
+    unsigned int slotCount = 1; // Slot 0 stays zeroed for unconnected inputs
+    for (size_t s = 0; s < order.size(); s++)
+    {
+        int node = order[s];
+        for (unsigned int p = 0; p < DspGraph::GetOutputCount(nodes[node].type); p++)
+        {
+            unsigned int slot;
+            if (!freeSlots.empty())
+            {
+                slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+            {
+                slot = slotCount++;
+            }
+            slotOf[node * DspGraph::MAX_OUTPUTS + p] = slot;
+        }
+        for (unsigned int p = 0; p < DspGraph::GetInputCount(nodes[node].type); p++)
+        {
+            const DspGraph::PortRef& ref = nodes[node].inputs[p];
+            unsigned int key = ref.node * DspGraph::MAX_OUTPUTS + ref.port;
+            if (ref.node >= 0 && lastUse[key] == (int)s)
+            {
+                freeSlots.push_back(slotOf[key]);
+                lastUse[key] = -1; // A node reading the same port twice frees it once
+            }
+        }
+        for (unsigned int p = 0; p < DspGraph::GetOutputCount(nodes[node].type); p++)
+            if (lastUse[node * DspGraph::MAX_OUTPUTS + p] < 0)
+                freeSlots.push_back(slotOf[node * DspGraph::MAX_OUTPUTS + p]);
+    }
+
+    auto compiled = std::make_unique<CompiledGraph>();
+    // Slots are padded to a multiple of 16 floats so each starts on a 64-byte boundary
+    const size_t stride = (maxFrames + 15) & ~(size_t)15;
+    compiled->m_slotCount = slotCount;
+    compiled->m_arena.assign(stride * slotCount + 16, 0.0f);
+    float* base = compiled->m_arena.data();
+    base += (16 - ((uintptr_t)base / sizeof(float)) % 16) % 16;
+
+    compiled->m_steps.reserve(order.size());
+    for (int node : order)
+    {
+        CompiledGraph::Step step;
+        step.node = CreateNode(nodes[node], sampleRate);
+        for (unsigned int p = 0; p < DspGraph::GetInputCount(nodes[node].type); p++)
+        {
+            const DspGraph::PortRef& ref = nodes[node].inputs[p];
+            unsigned int slot =
+                ref.node < 0 ? ZERO_SLOT : slotOf[ref.node * DspGraph::MAX_OUTPUTS + ref.port];
+            step.inputs[p] = base + slot * stride;
+        }
+        for (unsigned int p = 0; p < DspGraph::GetOutputCount(nodes[node].type); p++)
+            step.outputs[p] = base + slotOf[node * DspGraph::MAX_OUTPUTS + p] * stride;
+        compiled->m_steps.push_back(std::move(step));
+    }
+    return compiled;
+}
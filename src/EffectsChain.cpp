@@ -0,0 +1,188 @@
+#include "EffectsChain.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Mutually prime-ish line lengths in milliseconds at size 1.0
+constexpr float FDN_LENGTHS_MS[FdnReverb::LINE_COUNT] = {29.7f, 37.1f, 41.1f, 43.7f,
+                                                         53.3f, 59.1f, 67.9f, 73.3f};
+constexpr float FDN_MIN_SCALE = 0.5f;
+constexpr float FDN_MAX_SCALE = 1.5f;
+constexpr float DELAY_GLIDE = 0.0005f;
+
+unsigned int NextPowerOfTwo(unsigned int n)
+{
+    unsigned int p = 1;
+    while (p < n)
+        p <<= 1;
+    return p;
+}
+} // namespace
+
+void DelayLine::Prepare(unsigned int maxDelaySamples)
+{
+    unsigned int capacity = NextPowerOfTwo(maxDelaySamples + 2);
+    m_buffer.assign(capacity, 0.0f);
+    m_mask = capacity - 1;
+    m_write = 0;
+}
+
+void DelayLine::Clear()
+{
+    std::fill(m_buffer.begin(), m_buffer.end(), 0.0f);
+}
+
+float DelayLine::ReadFractional(float delay) const
+{
+    unsigned int whole = (unsigned int)delay;
+    float frac = delay - (float)whole;
+    float a = Read(whole);
+    float b = Read(whole + 1);
+    return a + (b - a) * frac;
+}
+
+void StereoDelay::Prepare(double sampleRate)
+{
+    m_sampleRate = sampleRate;
+    for (DelayLine& line : m_lines)
+        line.Prepare((unsigned int)(MAX_DELAY_SECONDS * sampleRate));
+}
+
+void StereoDelay::Clear()
+{
+    for (DelayLine& line : m_lines)
+        line.Clear();
+}
+
+void StereoDelay::Process(float* pLeft, float* pRight, unsigned int nFrames,
+                          const EffectsSettings& settings)
+{
+    float seconds = settings.delaySync ? settings.delayBeats * 60.0f / settings.tempoBpm
+                                       : settings.delayMs * 0.001f;
+    float target = std::clamp(seconds, 0.001f, MAX_DELAY_SECONDS) * (float)m_sampleRate;
+    if (m_currentDelay <= 0.0f)
+        m_currentDelay = target;
+
+    float feedback = std::clamp(settings.delayFeedback, 0.0f, 0.95f);
+    float cross = std::clamp(settings.delayPingPong, 0.0f, 1.0f);
+    for (unsigned int n = 0; n < nFrames; n++)
+    {
+        m_currentDelay += (target - m_currentDelay) * DELAY_GLIDE;
+        float wetL = m_lines[0].ReadFractional(m_currentDelay);
+        float wetR = m_lines[1].ReadFractional(m_currentDelay);
+
+        float feedL = wetL * (1.0f - cross) + wetR * cross;
+        float feedR = wetR * (1.0f - cross) + wetL * cross;
+        m_lines[0].Write(pLeft[n] + feedL * feedback);
+        m_lines[1].Write(pRight[n] + feedR * feedback);
+
+        pLeft[n] += wetL * settings.delayMix;
+        pRight[n] += wetR * settings.delayMix;
+    }
+}
+
+void FdnReverb::Prepare(double sampleRate)
+{
+    m_sampleRate = sampleRate;
+    for (unsigned int i = 0; i < LINE_COUNT; i++)
+        m_lines[i].Prepare((unsigned int)(FDN_LENGTHS_MS[i] * 0.001f * FDN_MAX_SCALE * sampleRate));
+    m_size = -1.0f;
+}
+
+void FdnReverb::Clear()
+{
+    for (unsigned int i = 0; i < LINE_COUNT; i++)
+    {
+        m_lines[i].Clear();
+        m_damping[i] = 0.0f;
+    }
+}
+
+void FdnReverb::UpdateCoefficients(const EffectsSettings& settings)
+{
+    if (settings.reverbSize == m_size && settings.reverbDecay == m_decay &&
+        settings.reverbDamping == m_dampingSetting)
+        return;
+
+    m_size = settings.reverbSize;
+    m_decay = settings.reverbDecay;
+    m_dampingSetting = settings.reverbDamping;
+
+    float scale = FDN_MIN_SCALE + std::clamp(m_size, 0.0f, 1.0f) * (FDN_MAX_SCALE - FDN_MIN_SCALE);
+    float rt60 = std::max(m_decay, 0.05f);
+    for (unsigned int i = 0; i < LINE_COUNT; i++)
+    {
+        double length = FDN_LENGTHS_MS[i] * 0.001 * scale * m_sampleRate;
+        m_lengths[i] = std::max(1u, (unsigned int)length);
+        // Per-pass gain that reaches -60 dB after rt60 seconds
+        m_gains[i] = (float)pow(10.0, -3.0 * m_lengths[i] / (rt60 * m_sampleRate));
+    }
+    m_dampCoeff = std::clamp(m_dampingSetting, 0.0f, 1.0f) * 0.7f;
+}
+
+void FdnReverb::Process(float* pLeft, float* pRight, unsigned int nFrames,
+                        const EffectsSettings& settings)
+{
+    UpdateCoefficients(settings);
+
+    constexpr float householder = 2.0f / LINE_COUNT;
+    constexpr float outputGain = 0.5f; // 1 / sqrt(LINE_COUNT / 2)
+    float taps[LINE_COUNT];
+    for (unsigned int n = 0; n < nFrames; n++)
+    {
+        float input = 0.5f * (pLeft[n] + pRight[n]);
+        float sum = 0.0f;
+        float wetL = 0.0f;
+        float wetR = 0.0f;
+        for (unsigned int i = 0; i < LINE_COUNT; i++)
+        {
+            float tap = m_lines[i].Read(m_lengths[i]);
+            m_damping[i] = tap + (m_damping[i] - tap) * m_dampCoeff;
+            taps[i] = m_damping[i];
+            sum += taps[i];
+            if (i % 2 == 0)
+                wetL += taps[i];
+            else
+                wetR += taps[i];
+        }
+
+        // Householder reflection: lossless mixing, every line feeds every other
+        sum *= householder;
+        for (unsigned int i = 0; i < LINE_COUNT; i++)
+        {
+            float sign = (i & 1) ? -1.0f : 1.0f;
+            m_lines[i].Write(input * sign + (taps[i] - sum) * m_gains[i]);
+        }
+
+        pLeft[n] += wetL * outputGain * settings.reverbMix;
+        pRight[n] += wetR * outputGain * settings.reverbMix;
+    }
+}
+
+void EffectsChain::Prepare(double sampleRate)
+{
+    m_delay.Prepare(sampleRate);
+    m_reverb.Prepare(sampleRate);
+}
+
+void EffectsChain::Process(float* pLeft, float* pRight, unsigned int nFrames,
+                           const EffectsSettings& settings)
+{
+    // Stale tails are cleared when an effect is switched back on rather than played out
+    if (settings.delayEnabled)
+    {
+        if (!m_delayWasEnabled)
+            m_delay.Clear();
+        m_delay.Process(pLeft, pRight, nFrames, settings);
+    }
+    if (settings.reverbEnabled)
+    {
+        if (!m_reverbWasEnabled)
+            m_reverb.Clear();
+        m_reverb.Process(pLeft, pRight, nFrames, settings);
+    }
+    m_delayWasEnabled = settings.delayEnabled;
+    m_reverbWasEnabled = settings.reverbEnabled;
+}
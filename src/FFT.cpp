@@ -0,0 +1,135 @@
+#include "FFT.h"
+
+#include <cmath>
+#include <utility>
+
+namespace
+{
+constexpr double FFT_PI = 3.14159265358979323846;
+}
+
+void FFT::Prepare(unsigned int size)
+{
+    m_size = size;
+    m_half = size / 2;
+
+    m_twiddleRe.resize(m_half / 2);
+    m_twiddleIm.resize(m_half / 2);
+    for (unsigned int k = 0; k < m_half / 2; k++)
+    {
+        m_twiddleRe[k] = (float)cos(-2.0 * FFT_PI * k / m_half);
+        m_twiddleIm[k] = (float)sin(-2.0 * FFT_PI * k / m_half);
+    }
+
+    m_splitRe.resize(m_half + 1);
+    m_splitIm.resize(m_half + 1);
+    for (unsigned int k = 0; k <= m_half; k++)
+    {
+        m_splitRe[k] = (float)cos(-2.0 * FFT_PI * k / m_size);
+        m_splitIm[k] = (float)sin(-2.0 * FFT_PI * k / m_size);
+    }
+
+    unsigned int bits = 0;
+    while ((1u << bits) < m_half)
+        bits++;
+    m_bitReverse.resize(m_half);
+    for (unsigned int i = 0; i < m_half; i++)
+    {
+        unsigned int r = 0;
+        for (unsigned int b = 0; b < bits; b++)
+            r |= ((i >> b) & 1u) << (bits - 1 - b);
+        m_bitReverse[i] = r;
+    }
+
+    m_workRe.assign(m_half, 0.0f);
+    m_workIm.assign(m_half, 0.0f);
+}
+
+void FFT::Transform(float* pRe, float* pIm, bool inverse)
+{
+    for (unsigned int i = 0; i < m_half; i++)
+    {
+        unsigned int r = m_bitReverse[i];
+        if (r > i)
+        {
+            std::swap(pRe[i], pRe[r]);
+            std::swap(pIm[i], pIm[r]);
+        }
+    }
+
+    float sign = inverse ? -1.0f : 1.0f;
+    for (unsigned int len = 2; len <= m_half; len <<= 1)
+    {
+        unsigned int halfLen = len / 2;
+        unsigned int step = m_half / len;
+        for (unsigned int start = 0; start < m_half; start += len)
+        {
+            for (unsigned int j = 0; j < halfLen; j++)
+            {
+                float wr = m_twiddleRe[j * step];
+                float wi = sign * m_twiddleIm[j * step];
+                unsigned int a = start + j;
+                unsigned int b = a + halfLen;
+                float tr = pRe[b] * wr - pIm[b] * wi;
+                float ti = pRe[b] * wi + pIm[b] * wr;
+                pRe[b] = pRe[a] - tr;
+                pIm[b] = pIm[a] - ti;
+                pRe[a] += tr;
+                pIm[a] += ti;
+            }
+        }
+    }
+}
+
+void FFT::Forward(const float* pIn, float* pRe, float* pIm)
+{
+    float* zr = m_workRe.data();
+    float* zi = m_workIm.data();
+    for (unsigned int n = 0; n < m_half; n++)
+    {
+        zr[n] = pIn[2 * n];
+        zi[n] = pIn[2 * n + 1];
+    }
+    Transform(zr, zi, false);
+
+    // Z = E + iO, with E and O the spectra of the even and odd samples; X[k] = E + W^k O
+    for (unsigned int k = 0; k <= m_half; k++)
+    {
+        unsigned int a = k % m_half;
+        unsigned int b = (m_half - k) % m_half;
+        float er = 0.5f * (zr[a] + zr[b]);
+        float ei = 0.5f * (zi[a] - zi[b]);
+        float or_ = 0.5f * (zi[a] + zi[b]);
+        float oi = -0.5f * (zr[a] - zr[b]);
+        pRe[k] = er + m_splitRe[k] * or_ - m_splitIm[k] * oi;
+        pIm[k] = ei + m_splitRe[k] * oi + m_splitIm[k] * or_;
+    }
+}
+
+void FFT::Inverse(const float* pRe, const float* pIm, float* pOut)
+{
+    float* zr = m_workRe.data();
+    float* zi = m_workIm.data();
+    for (unsigned int k = 0; k < m_half; k++)
+    {
+        unsigned int b = m_half - k;
+        float er = 0.5f * (pRe[k] + pRe[b]);
+        float ei = 0.5f * (pIm[k] - pIm[b]);
+        // O = (X[k] - conj(X[M-k])) / (2 W^k); dividing by a unit twiddle is multiplying by
+        // its conjugate
+        float dr = 0.5f * (pRe[k] - pRe[b]);
+        float di = 0.5f * (pIm[k] + pIm[b]);
+        float or_ = dr * m_splitRe[k] + di * m_splitIm[k];
+        float oi = di * m_splitRe[k] - dr * m_splitIm[k];
+        zr[k] = er - oi;
+        zi[k] = ei + or_;
+    }
+    Transform(zr, zi, true);
+
+    float scale = 1.0f / (float)m_half;
+    for (unsigned int n = 0; n < m_half; n++)
+    {
+        pOut[2 * n] = zr[n] * scale;
+        pOut[2 * n + 1] = zi[n] * scale;
+    }
+}
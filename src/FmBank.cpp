@@ -0,0 +1,308 @@
+#include "FmBank.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+using namespace simd;
+
+constexpr float MODULATION_DEPTH = 2.0f; // Cycles of phase shift per unit of modulator output
+constexpr float FEEDBACK_DEPTH = 0.25f;  // Cycles, at full feedback
+constexpr float ENVELOPE_FLOOR = 0.001f; // -60 dB, where decay and release times are measured
+constexpr float SILENCE_LEVEL = 1e-4f;   // A releasing envelope below this has finished
+constexpr float SETTLED_LEVEL = 1e-6f;   // Decay counts as having reached sustain
+
+struct FmAlgorithm
+{
+    uint8_t modulators[FM_OPERATORS]; // Bit j set: operator j modulates this one; always j > i
+    uint8_t carriers;                 // Operators summed into the output
+};
+
+constexpr FmAlgorithm ALGORITHMS[FM_ALGORITHMS] = {
+    {{0x02, 0x04, 0x08, 0x10, 0x20, 0x00}, 0x01},
+    {{0x02, 0x04, 0x00, 0x10, 0x20, 0x00}, 0x09},
+    {{0x02, 0x00, 0x08, 0x00, 0x20, 0x00}, 0x15},
+    {{0x02, 0x00, 0x08, 0x10, 0x20, 0x00}, 0x05},
+    {{0x0E, 0x00, 0x00, 0x10, 0x20, 0x00}, 0x01},
+    {{0x20, 0x20, 0x20, 0x20, 0x20, 0x00}, 0x1F},
+    {{0x08, 0x08, 0x08, 0x00, 0x20, 0x00}, 0x17},
+    {{0x00, 0x00, 0x00, 0x00, 0x00, 0x00}, 0x3F},
+};
+
+// A lane group's operators, held in registers across one envelope stretch
+struct OperatorLanes
+{
+    Lanes phase[FM_OPERATORS];
+    Lanes increment[FM_OPERATORS];
+    Lanes amplitude[FM_OPERATORS];
+    Lanes step[FM_OPERATORS]; // Amplitude ramp per sample
+    Lanes feedback1[FM_OPERATORS];
+    Lanes feedback2[FM_OPERATORS];
+    Lanes feedbackDepth[FM_OPERATORS]; // Zero for operators without feedback
+};
+
+// The routing is a template argument so that each algorithm compiles to straight-line code,
+// with no per-sample branching on which operator feeds which
+template <unsigned int ALGORITHM>
+void RenderStretch(OperatorLanes& lanes, float* pOut, unsigned int stride, unsigned int nFrames,
+                   Lanes gain)
+{
+    constexpr FmAlgorithm algorithm = ALGORITHMS[ALGORITHM];
+    const Lanes depth = Splat(MODULATION_DEPTH);
+    OperatorLanes s = lanes;
+    for (unsigned int n = 0; n < nFrames; n++)
+    {
+        Lanes out[FM_OPERATORS];
+        Lanes mix = Splat(0.0f);
+        for (int op = FM_OPERATORS - 1; op >= 0; op--)
+        {
+            // Averaging the last two outputs keeps heavy feedback from oscillating at Nyquist
+            Lanes argument =
+                Add(s.phase[op], Mul(Add(s.feedback1[op], s.feedback2[op]), s.feedbackDepth[op]));
+            if (algorithm.modulators[op])
+            {
+                Lanes modulation = Splat(0.0f);
+                for (unsigned int j = op + 1; j < FM_OPERATORS; j++)
+                {
+                    if ((algorithm.modulators[op] >> j) & 1)
+                        modulation = Add(modulation, out[j]);
+                }
+                argument = Add(argument, Mul(modulation, depth));
+            }
+            Lanes y = Mul(Sine(argument), s.amplitude[op]);
+            s.feedback2[op] = s.feedback1[op];
+            s.feedback1[op] = y;
+            out[op] = y;
+            if ((algorithm.carriers >> op) & 1)
+                mix = Add(mix, y);
+
+            Lanes next = Add(s.phase[op], s.increment[op]);
+            s.phase[op] = Sub(next, Round(next));
+            s.amplitude[op] = Add(s.amplitude[op], s.step[op]);
+        }
+        StoreUnaligned(pOut + (size_t)n * stride, Mul(mix, gain));
+    }
+    lanes = s;
+}
+
+using StretchFunction = void (*)(OperatorLanes&, float*, unsigned int, unsigned int, Lanes);
+constexpr StretchFunction STRETCH_FUNCTIONS[FM_ALGORITHMS] = {
+    RenderStretch<0>, RenderStretch<1>, RenderStretch<2>, RenderStretch<3>,
+    RenderStretch<4>, RenderStretch<5>, RenderStretch<6>, RenderStretch<7>,
+};
+
+float SamplesFor(float ms, double sampleRate)
+{
+    return (float)std::max(1.0, ms * 0.001 * sampleRate);
+}
+} // namespace
+
+const char* const FM_ALGORITHM_NAMES[FM_ALGORITHMS] = {
+    "6>5>4>3>2>1",   "3>2>1 + 6>5>4", "2>1 + 4>3 + 6>5", "2>1 + 6>5>4>3",
+    "(2+3+6>5>4)>1", "6>(1+2+3+4+5)", "4>(1+2+3) + 6>5", "1+2+3+4+5+6",
+};
+
+const char* const FM_PRESET_NAMES[FM_PRESETS] = {"Electric piano", "Bell", "Bass"};
+
+FmPatch MakeFmPreset(unsigned int index)
+{
+    // ratio, level, feedback, attack, decay, sustain, release
+    switch (index)
+    {
+    case 1:
+        return FmPatch{1,
+                       {{1.0f, 0.9f, 0.0f, 1.0f, 5000.0f, 0.0f, 2500.0f},
+                        {3.5f, 0.35f, 0.0f, 1.0f, 3500.0f, 0.0f, 2500.0f},
+                        {1.0f, 0.2f, 0.0f, 1.0f, 2500.0f, 0.0f, 2500.0f},
+                        {2.0f, 0.6f, 0.0f, 1.0f, 4000.0f, 0.0f, 2500.0f},
+                        {5.19f, 0.3f, 0.0f, 1.0f, 2000.0f, 0.0f, 2000.0f},
+                        {1.0f, 0.1f, 0.3f, 1.0f, 1500.0f, 0.0f, 2000.0f}}};
+    case 2:
+        return FmPatch{3,
+                       {{0.5f, 1.0f, 0.0f, 1.0f, 800.0f, 0.6f, 120.0f},
+                        {0.5f, 0.45f, 0.4f, 1.0f, 400.0f, 0.25f, 120.0f},
+                        {1.0f, 0.3f, 0.0f, 1.0f, 300.0f, 0.0f, 100.0f},
+                        {1.0f, 0.2f, 0.0f, 1.0f, 250.0f, 0.0f, 100.0f},
+                        {3.0f, 0.1f, 0.0f, 1.0f, 150.0f, 0.0f, 100.0f},
+                        {1.0f, 0.0f, 0.0f, 1.0f, 100.0f, 0.0f, 100.0f}}};
+    default:
+        return FmPatch{2,
+                       {{1.0f, 0.9f, 0.0f, 2.0f, 2500.0f, 0.0f, 400.0f},
+                        {1.0f, 0.3f, 0.0f, 2.0f, 1500.0f, 0.1f, 400.0f},
+                        {1.0f, 0.5f, 0.0f, 2.0f, 1500.0f, 0.0f, 300.0f},
+                        {14.0f, 0.15f, 0.0f, 1.0f, 250.0f, 0.0f, 200.0f},
+                        {1.003f, 0.4f, 0.0f, 2.0f, 2000.0f, 0.0f, 400.0f},
+                        {1.0f, 0.2f, 0.2f, 2.0f, 1200.0f, 0.1f, 400.0f}}};
+    }
+}
+
+void FmBank::NoteOn(unsigned int voice, double freq)
+{
+    m_freq[voice] = freq;
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+    {
+        m_phase[op][voice] = 0.0f;
+        m_feedback1[op][voice] = 0.0f;
+        m_feedback2[op][voice] = 0.0f;
+        m_stage[op][voice] = Stage::Attack;
+    }
+    m_soundingMask |= 1u << voice;
+}
+
+void FmBank::NoteOff(unsigned int voice)
+{
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+    {
+        if (m_stage[op][voice] != Stage::Idle)
+            m_stage[op][voice] = Stage::Release;
+    }
+}
+
+void FmBank::Silence()
+{
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+    {
+        for (unsigned int v = 0; v < MAX_VOICES; v++)
+        {
+            m_stage[op][v] = Stage::Idle;
+            m_envelope[op][v] = 0.0f;
+            m_amplitude[op][v] = 0.0f;
+        }
+    }
+    m_soundingMask = 0;
+}
+
+bool FmBank::AdvanceEnvelope(unsigned int op, unsigned int voice, const FmOperator& settings,
+                             const Rates& rates, unsigned int nSamples)
+{
+    float& envelope = m_envelope[op][voice];
+    Stage& stage = m_stage[op][voice];
+    if (stage == Stage::Attack)
+    {
+        envelope += rates.attackStep[op] * nSamples;
+        if (envelope >= 1.0f)
+        {
+            envelope = 1.0f;
+            stage = Stage::Decay;
+        }
+    }
+    else if (stage == Stage::Decay)
+    {
+        float sustain = std::clamp(settings.sustain, 0.0f, 1.0f);
+        envelope = sustain + (envelope - sustain) * powf(rates.decayCoeff[op], (float)nSamples);
+        if (fabsf(envelope - sustain) < SETTLED_LEVEL)
+            envelope = sustain;
+    }
+    else if (stage == Stage::Release)
+    {
+        envelope *= powf(rates.releaseCoeff[op], (float)nSamples);
+        if (envelope < SILENCE_LEVEL)
+        {
+            envelope = 0.0f;
+            stage = Stage::Idle;
+        }
+    }
+    return stage != Stage::Idle;
+}
+
+unsigned int FmBank::Render(const FmPatch& patch, float* pVoices, unsigned int nFrames,
+                            double sampleRate, float gain)
+{
+    const unsigned int written = m_soundingMask;
+    if (written == 0)
+        return 0;
+
+    Rates rates;
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+    {
+        const FmOperator& settings = patch.operators[op];
+        rates.attackStep[op] = 1.0f / SamplesFor(settings.attackMs, sampleRate);
+        rates.decayCoeff[op] =
+            powf(ENVELOPE_FLOOR, 1.0f / SamplesFor(settings.decayMs, sampleRate));
+        rates.releaseCoeff[op] =
+            powf(ENVELOPE_FLOOR, 1.0f / SamplesFor(settings.releaseMs, sampleRate));
+    }
+
+    const unsigned int groupMask = (1u << LANE_WIDTH) - 1;
+    for (unsigned int group = 0; group < GROUP_COUNT; group++)
+    {
+        unsigned int first = group * LANE_WIDTH;
+        if (((written >> first) & groupMask) != 0)
+            RenderGroup(patch, rates, pVoices, nFrames, sampleRate, gain, first);
+    }
+    return written;
+}
+
+void FmBank::RenderGroup(const FmPatch& patch, const Rates& rates, float* pVoices,
+                         unsigned int nFrames, double sampleRate, float gain, unsigned int first)
+{
+    const unsigned int algorithmIndex = std::min(patch.algorithm, FM_ALGORITHMS - 1);
+    const FmAlgorithm& algorithm = ALGORITHMS[algorithmIndex];
+    unsigned int carrierCount = 0;
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+        carrierCount += (algorithm.carriers >> op) & 1;
+    const Lanes vGain = Splat(gain / (float)std::max(carrierCount, 1u));
+
+    alignas(32) float increments[FM_OPERATORS][LANE_WIDTH];
+    alignas(32) float targets[FM_OPERATORS][LANE_WIDTH];
+    OperatorLanes lanes;
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+    {
+        for (unsigned int lane = 0; lane < LANE_WIDTH; lane++)
+        {
+            // Kept within +-0.5 cycles, as the phases are
+            double cycles = m_freq[first + lane] * patch.operators[op].ratio / sampleRate;
+            increments[op][lane] = (float)(cycles - floor(cycles + 0.5));
+        }
+        lanes.phase[op] = Load(m_phase[op] + first);
+        lanes.increment[op] = Load(increments[op]);
+        lanes.feedback1[op] = Load(m_feedback1[op] + first);
+        lanes.feedback2[op] = Load(m_feedback2[op] + first);
+        lanes.feedbackDepth[op] =
+            Splat(std::clamp(patch.operators[op].feedback, 0.0f, 1.0f) * FEEDBACK_DEPTH * 0.5f);
+    }
+
+    for (unsigned int start = 0; start < nFrames; start += ENVELOPE_INTERVAL)
+    {
+        const unsigned int length = std::min(ENVELOPE_INTERVAL, nFrames - start);
+
+        // Control rate: step every envelope to the end of this stretch, then ramp towards it
+        unsigned int carriersSounding = 0;
+        for (unsigned int op = 0; op < FM_OPERATORS; op++)
+        {
+            const FmOperator& settings = patch.operators[op];
+            for (unsigned int lane = 0; lane < LANE_WIDTH; lane++)
+            {
+                unsigned int v = first + lane;
+                bool sounding = (m_soundingMask >> v) & 1;
+                if (sounding && AdvanceEnvelope(op, v, settings, rates, length) &&
+                    ((algorithm.carriers >> op) & 1))
+                    carriersSounding |= 1u << lane;
+                targets[op][lane] = m_envelope[op][v] * std::clamp(settings.level, 0.0f, 1.0f);
+            }
+            lanes.amplitude[op] = Load(m_amplitude[op] + first);
+            Lanes target = Load(targets[op]);
+            lanes.step[op] = Mul(Sub(target, lanes.amplitude[op]), Splat(1.0f / length));
+            Store(m_amplitude[op] + first, target);
+        }
+
+        STRETCH_FUNCTIONS[algorithmIndex](lanes, pVoices + (size_t)start * MAX_VOICES + first,
+                                          MAX_VOICES, length, vGain);
+
+        // A voice has finished once every carrier has released; its modulators are inaudible
+        for (unsigned int lane = 0; lane < LANE_WIDTH; lane++)
+        {
+            if (!((carriersSounding >> lane) & 1))
+                m_soundingMask &= ~(1u << (first + lane));
+        }
+    }
+
+    for (unsigned int op = 0; op < FM_OPERATORS; op++)
+    {
+        Store(m_phase[op] + first, lanes.phase[op]);
+        Store(m_feedback1[op] + first, lanes.feedback1[op]);
+        Store(m_feedback2[op] + first, lanes.feedback2[op]);
+    }
+}
@@ -0,0 +1,121 @@
+#include "KeyboardInput.h"
+
+#include "AudioManager.h"
+#include "LatencyTracer.h"
+#include "Trace.h"
+
+namespace
+{
+constexpr wchar_t WINDOW_CLASS[] = L"SynthKeyboardInput";
+constexpr USHORT HID_USAGE_PAGE_GENERIC = 0x01;
+constexpr USHORT HID_USAGE_GENERIC_KEYBOARD = 0x06;
+constexpr USHORT VKEY_UNMAPPED = 0xFF; // Sent for the prefix half of some extended keys
+} // namespace
+
+KeyboardInput::~KeyboardInput()
+{
+    Stop();
+}
+
+bool KeyboardInput::Start(AudioManager* audio, HWND focusWindow)
+{
+    Stop();
+    m_audio = audio;
+    m_focusWindow = focusWindow;
+    m_keysDown.reset();
+
+    std::promise<bool> ready;
+    std::future<bool> started = ready.get_future();
+    m_thread = std::thread(&KeyboardInput::ThreadMain, this, &ready);
+    if (!started.get())
+    {
+        m_thread.join();
+        return false;
+    }
+    return true;
+}
+
+void KeyboardInput::Stop()
+{
+    if (!m_thread.joinable())
+        return;
+    ::PostThreadMessageW(m_threadId, WM_QUIT, 0, 0);
+    m_thread.join();
+}
+
+void KeyboardInput::ThreadMain(std::promise<bool>* pReady)
+{
+    // Input is stamped on arrival, so this thread should never wait behind the GUI
+    ::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+    m_threadId = ::GetCurrentThreadId();
+    SYNTH_TRACE_THREAD("Keyboard");
+
+    HINSTANCE hInstance = ::GetModuleHandleW(nullptr);
+    WNDCLASSEXW wc = {};
+    wc.cbSize = sizeof(wc);
+    wc.lpfnWndProc = ::DefWindowProcW;
+    wc.hInstance = hInstance;
+    wc.lpszClassName = WINDOW_CLASS;
+    ::RegisterClassExW(&wc);
+
+    // A message-only window gives the thread its own queue for WM_INPUT
+    HWND hWnd = ::CreateWindowExW(0, WINDOW_CLASS, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr,
+                                  hInstance, nullptr);
+    RAWINPUTDEVICE device = {HID_USAGE_PAGE_GENERIC, HID_USAGE_GENERIC_KEYBOARD, RIDEV_INPUTSINK,
+                             hWnd};
+    if (!hWnd || !::RegisterRawInputDevices(&device, 1, sizeof(device)))
+    {
+        if (hWnd)
+            ::DestroyWindow(hWnd);
+        ::UnregisterClassW(WINDOW_CLASS, hInstance);
+        pReady->set_value(false);
+        return;
+    }
+    pReady->set_value(true);
+
+    MSG msg;
+    while (::GetMessageW(&msg, nullptr, 0, 0) > 0)
+    {
+        if (msg.message == WM_INPUT)
+            HandleInput((HRAWINPUT)msg.lParam);
+        // DefWindowProc releases the WM_INPUT data
+        ::DispatchMessageW(&msg);
+    }
+
+    device.dwFlags = RIDEV_REMOVE;
+    device.hwndTarget = nullptr;
+    ::RegisterRawInputDevices(&device, 1, sizeof(device));
+    ::DestroyWindow(hWnd);
+    ::UnregisterClassW(WINDOW_CLASS, hInstance);
+}
+
+void KeyboardInput::HandleInput(HRAWINPUT hInput)
+{
+    int64_t timestamp = LatencyTracer::Now();
+
+    RAWINPUT input;
+    UINT size = sizeof(input);
+    if (::GetRawInputData(hInput, RID_INPUT, &input, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1 ||
+        input.header.dwType != RIM_TYPEKEYBOARD)
+        return;
+
+    const RAWKEYBOARD& keyboard = input.data.keyboard;
+    if (keyboard.VKey >= m_keysDown.size() || keyboard.VKey == VKEY_UNMAPPED)
+        return;
+
+    if (keyboard.Flags & RI_KEY_BREAK)
+    {
+        if (!m_keysDown.test(keyboard.VKey))
+            return;
+        m_keysDown.reset(keyboard.VKey);
+        m_audio->HandleKeyUp(keyboard.VKey, timestamp);
+    }
+    else
+    {
+        // Auto-repeat arrives as further downs for a key that is already held
+        if (m_keysDown.test(keyboard.VKey) || ::GetForegroundWindow() != m_focusWindow)
+            return;
+        m_keysDown.set(keyboard.VKey);
+        m_audio->HandleKeyDown(keyboard.VKey, timestamp);
+    }
+}
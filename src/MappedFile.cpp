@@ -0,0 +1,105 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+constexpr uint64_t PREFAULT_STRIDE = 4096; // Smallest page size on every supported target
+} // namespace
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+bool MappedFile::Open(const std::filesystem::path& path)
+{
+    Close();
+#if defined(_WIN32)
+    m_file = ::CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                           OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    LARGE_INTEGER size = {};
+    // An empty file can't be mapped
+    if (m_file == INVALID_HANDLE_VALUE || !::GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+    {
+        Close();
+        return false;
+    }
+
+    m_mapping = ::CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    m_data = m_mapping ? static_cast<const unsigned char*>(
+                             ::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0))
+                       : nullptr;
+    if (!m_data)
+    {
+        Close();
+        return false;
+    }
+    m_size = (uint64_t)size.QuadPart;
+    return true;
+#else
+    int file = ::open(path.c_str(), O_RDONLY);
+    struct stat status = {};
+    // An empty file can't be mapped
+    if (file < 0 || ::fstat(file, &status) != 0 || status.st_size == 0)
+    {
+        if (file >= 0)
+            ::close(file);
+        return false;
+    }
+    void* data = ::mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // The mapping keeps the file open
+    ::close(file);
+    if (data == MAP_FAILED)
+        return false;
+    m_data = static_cast<const unsigned char*>(data);
+    m_size = (uint64_t)status.st_size;
+    return true;
+#endif
+}
+
+void MappedFile::Close()
+{
+#if defined(_WIN32)
+    if (m_data)
+    {
+        ::UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping)
+    {
+        ::CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        ::CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+#else
+    if (m_data)
+    {
+        ::munmap(const_cast<unsigned char*>(m_data), (size_t)m_size);
+        m_data = nullptr;
+    }
+#endif
+    m_size = 0;
+}
+
+void MappedFile::Prefault(uint64_t offset, uint64_t size) const
+{
+    if (offset >= m_size)
+        return;
+    uint64_t end = offset + std::min(size, m_size - offset);
+    const volatile unsigned char* bytes = m_data;
+    for (uint64_t at = offset; at < end; at += PREFAULT_STRIDE)
+        (void)bytes[at];
+    (void)bytes[end - 1];
+}
@@ -0,0 +1,98 @@
+#include "MetricsSegment.h"
+
+#include <cstring>
+
+MetricsSegment::~MetricsSegment()
+{
+    Close();
+}
+
+bool MetricsSegment::Create()
+{
+    Close();
+#if defined(_WIN32)
+    m_mapping = ::CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+                                     sizeof(Block), METRICS_SEGMENT_NAME);
+    if (m_mapping && ::GetLastError() == ERROR_ALREADY_EXISTS)
+    {
+        Close();
+        return false;
+    }
+    m_block = m_mapping ? static_cast<Block*>(
+                              ::MapViewOfFile(m_mapping, FILE_MAP_WRITE, 0, 0, sizeof(Block)))
+                        : nullptr;
+    if (!m_block)
+    {
+        Close();
+        return false;
+    }
+    // A fresh mapping is zeroed, so readers see version 0 until the header is written
+    m_block->size = sizeof(Block);
+    m_block->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_block->version = METRICS_VERSION;
+    m_writer = true;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool MetricsSegment::Open()
+{
+    Close();
+#if defined(_WIN32)
+    m_mapping = ::OpenFileMappingW(FILE_MAP_READ, FALSE, METRICS_SEGMENT_NAME);
+    m_block = m_mapping ? static_cast<Block*>(
+                              ::MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, sizeof(Block)))
+                        : nullptr;
+    if (!m_block || m_block->version != METRICS_VERSION || m_block->size != sizeof(Block))
+    {
+        Close();
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+void MetricsSegment::Close()
+{
+#if defined(_WIN32)
+    if (m_block)
+    {
+        ::UnmapViewOfFile(m_block);
+        m_block = nullptr;
+    }
+    if (m_mapping)
+    {
+        ::CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+#endif
+    m_writer = false;
+}
+
+void MetricsSegment::Publish(const EngineMetrics& metrics)
+{
+    if (!m_writer)
+        return;
+    // Sequence lock, as ParameterStore::SetAll
+    uint32_t sequence = m_block->sequence.load(std::memory_order_relaxed);
+    m_block->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&m_block->metrics, &metrics, sizeof(metrics));
+    m_block->sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool MetricsSegment::Read(EngineMetrics& out) const
+{
+    if (!m_block)
+        return false;
+    uint32_t before = m_block->sequence.load(std::memory_order_acquire);
+    memcpy(&out, &m_block->metrics, sizeof(out));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (before & 1) == 0 &&
+           m_block->sequence.load(std::memory_order_relaxed) == before;
+}
@@ -0,0 +1,141 @@
+#include "Oversampler.h"
+
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr double OS_PI = 3.14159265358979323846;
+constexpr unsigned int FINAL_STAGE_HALF_LENGTH = 12; // 47 taps
+constexpr unsigned int EARLY_STAGE_HALF_LENGTH = 4;  // 15 taps
+
+double BlackmanHarris(double x)
+{
+    return 0.35875 - 0.48829 * cos(2.0 * OS_PI * x) + 0.14128 * cos(4.0 * OS_PI * x) -
+           0.01168 * cos(6.0 * OS_PI * x);
+}
+} // namespace
+
+void HalfBandDecimator::Prepare(unsigned int halfLength, unsigned int maxInputFrames)
+{
+    m_halfLength = halfLength;
+    m_history = 2 * halfLength - 1;
+
+    // Windowed sinc at a quarter of the input rate. Tap j sits 2j+1 samples from the centre,
+    // where sinc reduces to (-1)^j / (pi * (2j+1) / 2).
+    unsigned int taps = 4 * halfLength - 1;
+    unsigned int centre = 2 * halfLength - 1;
+    m_coeffs.resize(halfLength);
+    double sum = 0.0;
+    for (unsigned int j = 0; j < halfLength; j++)
+    {
+        double offset = 2.0 * j + 1.0;
+        double sinc = ((j % 2 == 0) ? 1.0 : -1.0) / (OS_PI * offset);
+        double window = BlackmanHarris((centre - offset + 1.0) / (taps + 1.0));
+        m_coeffs[j] = (float)(sinc * window);
+        sum += 2.0 * sinc * window;
+    }
+    // Side taps sum to 0.5 so that, with the 0.5 centre tap, DC passes at unity gain
+    for (float& c : m_coeffs)
+        c = (float)(c * 0.5 / sum);
+
+    m_even.assign(m_history + maxInputFrames / 2, 0.0f);
+    m_odd.assign(m_history + maxInputFrames / 2, 0.0f);
+}
+
+void HalfBandDecimator::Reset()
+{
+    std::fill(m_even.begin(), m_even.end(), 0.0f);
+    std::fill(m_odd.begin(), m_odd.end(), 0.0f);
+}
+
+void HalfBandDecimator::Process(const float* pIn, unsigned int nInputFrames, float* pOut)
+{
+    unsigned int nOutputFrames = nInputFrames / 2;
+    float* pEven = m_even.data() + m_history;
+    float* pOdd = m_odd.data() + m_history;
+    for (unsigned int k = 0; k < nOutputFrames; k++)
+    {
+        pEven[k] = pIn[2 * k];
+        pOdd[k] = pIn[2 * k + 1];
+    }
+
+    // y[m] = 0.5 * even[m-K+1] + sum_j c_j * (odd[m-K+1+j] + odd[m-K-j])
+    const int K = (int)m_halfLength;
+    const float* pCentre = pEven - (K - 1);
+    const float* pInner = pOdd - (K - 1);
+    const float* pOuter = pOdd - K;
+    unsigned int m = 0;
+
+#if SYNTH_HAS_SSE2
+    const __m128 vHalf = _mm_set1_ps(0.5f);
+    for (; m + 4 <= nOutputFrames; m += 4)
+    {
+        __m128 vAcc = _mm_mul_ps(vHalf, _mm_loadu_ps(pCentre + m));
+        for (int j = 0; j < K; j++)
+        {
+            __m128 vPair = _mm_add_ps(_mm_loadu_ps(pInner + m + j), _mm_loadu_ps(pOuter + m - j));
+            vAcc = _mm_add_ps(vAcc, _mm_mul_ps(_mm_set1_ps(m_coeffs[j]), vPair));
+        }
+        _mm_storeu_ps(pOut + m, vAcc);
+    }
+#endif
+
+    for (; m < nOutputFrames; m++)
+    {
+        float acc = 0.5f * pCentre[m];
+        // Signed, since the outer taps reach back into the history before m = 0
+        for (int j = 0; j < K; j++)
+            acc += m_coeffs[j] * (pInner[m + j] + pOuter[(int)m - j]);
+        pOut[m] = acc;
+    }
+
+    std::memmove(m_even.data(), m_even.data() + nOutputFrames, m_history * sizeof(float));
+    std::memmove(m_odd.data(), m_odd.data() + nOutputFrames, m_history * sizeof(float));
+}
+
+void Oversampler::Prepare(unsigned int maxOutputFrames)
+{
+    m_stages[0].Prepare(FINAL_STAGE_HALF_LENGTH, maxOutputFrames * 2);
+    m_stages[1].Prepare(EARLY_STAGE_HALF_LENGTH, maxOutputFrames * 4);
+    m_stages[2].Prepare(EARLY_STAGE_HALF_LENGTH, maxOutputFrames * 8);
+    m_scratch[0].assign(maxOutputFrames * MAX_FACTOR / 2, 0.0f);
+    m_scratch[1].assign(maxOutputFrames * MAX_FACTOR / 2, 0.0f);
+}
+
+void Oversampler::SetFactor(unsigned int factor)
+{
+    if (factor == m_factor)
+        return;
+    m_factor = factor;
+    Reset();
+}
+
+void Oversampler::Reset()
+{
+    for (HalfBandDecimator& stage : m_stages)
+        stage.Reset();
+}
+
+void Oversampler::Decimate(const float* pIn, unsigned int nOutputFrames, float* pOut)
+{
+    unsigned int stageCount = m_factor >= 8 ? 3 : (m_factor >= 4 ? 2 : (m_factor >= 2 ? 1 : 0));
+    if (stageCount == 0)
+    {
+        std::copy(pIn, pIn + nOutputFrames, pOut);
+        return;
+    }
+
+    const float* pSource = pIn;
+    unsigned int nFrames = nOutputFrames << stageCount;
+    for (unsigned int s = stageCount; s-- > 0;)
+    {
+        float* pDest = (s == 0) ? pOut : m_scratch[(stageCount - 1 - s) % 2].data();
+        m_stages[s].Process(pSource, nFrames, pDest);
+        pSource = pDest;
+        nFrames /= 2;
+    }
+}
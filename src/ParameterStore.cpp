@@ -0,0 +1,132 @@
+#include "ParameterStore.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+// Indexed by ParamId
+constexpr ParamInfo PARAM_INFO[] = {
+    {"wave_type", "Wave type", 0.0f, 0.0f, 5.0f, Smoothing::None, 0.0f},
+    // Applied at note on
+    {"stereo_spread", "Stereo spread", 0.0f, 0.0f, 1.0f, Smoothing::None, 0.0f},
+    {"oversampling", "Oversampling", 1.0f, 1.0f, 8.0f, Smoothing::None, 0.0f},
+    {"drive", "Drive", 0.0f, 0.0f, 1.0f, Smoothing::Linear, 30.0f},
+    {"filter_mode", "Filter mode", 0.0f, 0.0f, 3.0f, Smoothing::None, 0.0f},
+    {"filter_cutoff", "Cutoff", 2000.0f, 20.0f, 20000.0f, Smoothing::OnePole, 20.0f},
+    {"filter_resonance", "Resonance", 0.0f, 0.0f, 1.0f, Smoothing::OnePole, 20.0f},
+    {"delay_enabled", "Delay", 0.0f, 0.0f, 1.0f, Smoothing::None, 0.0f},
+    {"delay_sync", "Delay sync", 0.0f, 0.0f, 1.0f, Smoothing::None, 0.0f},
+    // The delay glides itself
+    {"delay_ms", "Delay time", 350.0f, 1.0f, 2000.0f, Smoothing::None, 0.0f},
+    {"delay_beats", "Delay beats", 0.75f, 0.125f, 2.0f, Smoothing::None, 0.0f},
+    {"tempo_bpm", "Tempo", 120.0f, 40.0f, 240.0f, Smoothing::None, 0.0f},
+    {"delay_feedback", "Feedback", 0.35f, 0.0f, 0.95f, Smoothing::OnePole, 20.0f},
+    {"delay_ping_pong", "Ping-pong", 0.0f, 0.0f, 1.0f, Smoothing::OnePole, 20.0f},
+    {"delay_mix", "Delay mix", 0.3f, 0.0f, 1.0f, Smoothing::OnePole, 20.0f},
+    {"reverb_enabled", "Reverb", 0.0f, 0.0f, 1.0f, Smoothing::None, 0.0f},
+    // Rebuilds the FDN, so never ramped
+    {"reverb_size", "Size", 0.5f, 0.0f, 1.0f, Smoothing::None, 0.0f},
+    {"reverb_decay", "Decay", 2.0f, 0.1f, 10.0f, Smoothing::None, 0.0f},
+    {"reverb_damping", "Damping", 0.4f, 0.0f, 1.0f, Smoothing::None, 0.0f},
+    {"reverb_mix", "Reverb mix", 0.25f, 0.0f, 1.0f, Smoothing::OnePole, 20.0f},
+    {"convolution_enabled", "Convolution", 0.0f, 0.0f, 1.0f, Smoothing::None, 0.0f},
+    {"convolution_mix", "IR mix", 0.3f, 0.0f, 1.0f, Smoothing::OnePole, 20.0f},
+    {"sampler_interpolation", "Interpolation", 0.0f, 0.0f, 3.0f, Smoothing::None, 0.0f},
+};
+static_assert(sizeof(PARAM_INFO) / sizeof(PARAM_INFO[0]) == (size_t)ParamId::Count,
+              "Every parameter needs an entry in PARAM_INFO");
+} // namespace
+
+ParameterStore::ParameterStore()
+{
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+        m_slots[i].value.store(PARAM_INFO[i].defaultValue, std::memory_order_relaxed);
+}
+
+void ParameterStore::Set(ParamId id, float value)
+{
+    const ParamInfo& info = GetInfo(id);
+    m_slots[(size_t)id].value.store(std::clamp(value, info.minValue, info.maxValue),
+                                    std::memory_order_relaxed);
+}
+
+void ParameterStore::SetAll(const float* pValues)
+{
+    // Sequence lock: odd while the batch is being written
+    uint32_t sequence = m_sequence.load(std::memory_order_relaxed);
+    m_sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+        Set((ParamId)i, pValues[i]);
+    m_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+bool ParameterStore::GetAll(float* pValues) const
+{
+    uint32_t before = m_sequence.load(std::memory_order_acquire);
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+        pValues[i] = Get((ParamId)i);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (before & 1) == 0 && m_sequence.load(std::memory_order_relaxed) == before;
+}
+
+ParamId ParameterStore::FindKey(std::string_view key)
+{
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+        if (key == PARAM_INFO[i].key)
+            return (ParamId)i;
+    return ParamId::Count;
+}
+
+const ParamInfo& ParameterStore::GetInfo(ParamId id)
+{
+    return PARAM_INFO[(size_t)id];
+}
+
+void ParameterSnapshot::Reset(const ParameterStore& store)
+{
+    store.GetAll(m_target);
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+    {
+        m_end[i] = m_target[i];
+        m_start[i] = m_end[i];
+    }
+}
+
+void ParameterSnapshot::Update(const ParameterStore& store, unsigned int nFrames,
+                               double sampleRate)
+{
+    // A batch caught half written keeps last block's targets; it lands whole next block
+    float targets[(size_t)ParamId::Count];
+    if (store.GetAll(targets))
+        std::copy(targets, targets + (size_t)ParamId::Count, m_target);
+
+    double blockMs = 1000.0 * nFrames / sampleRate;
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+    {
+        const ParamInfo& info = PARAM_INFO[i];
+        float target = m_target[i];
+        float current = m_end[i];
+        m_start[i] = current;
+
+        if (info.smoothing == Smoothing::Linear && info.smoothingMs > 0.0f)
+        {
+            float step = (float)((info.maxValue - info.minValue) * blockMs / info.smoothingMs);
+            m_end[i] = target > current ? std::min(current + step, target)
+                                        : std::max(current - step, target);
+        }
+        else if (info.smoothing == Smoothing::OnePole && info.smoothingMs > 0.0f)
+        {
+            float coeff = (float)(1.0 - exp(-blockMs / info.smoothingMs));
+            float next = current + (target - current) * coeff;
+            // Snap once the remaining distance is inaudible so the ramp actually ends
+            float epsilon = (info.maxValue - info.minValue) * 1e-5f;
+            m_end[i] = fabsf(target - next) < epsilon ? target : next;
+        }
+        else
+        {
+            m_end[i] = target;
+        }
+    }
+}
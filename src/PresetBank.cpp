@@ -0,0 +1,237 @@
+#include "PresetBank.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+namespace
+{
+void SetError(std::string* error, std::string message)
+{
+    if (error)
+        *error = std::move(message);
+}
+
+void SetName(PresetPatch& patch, const char* name)
+{
+    strncpy(patch.name, name, PRESET_NAME_LENGTH - 1);
+    patch.name[PRESET_NAME_LENGTH - 1] = '\0';
+}
+
+std::string Trim(const std::string& text)
+{
+    size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+        return std::string();
+    size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+} // namespace
+
+PresetPatch MakeDefaultPatch(const char* name)
+{
+    PresetPatch patch = {};
+    SetName(patch, name);
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+        patch.values[i] = ParameterStore::GetInfo((ParamId)i).defaultValue;
+    return patch;
+}
+
+PresetPatch CapturePatch(const ParameterStore& store, const char* name)
+{
+    PresetPatch patch = {};
+    SetName(patch, name);
+    // Called on the thread that writes patches, so no batch can be half written
+    store.GetAll(patch.values);
+    return patch;
+}
+
+PresetBank::~PresetBank()
+{
+    Close();
+}
+
+bool PresetBank::Open(const std::filesystem::path& path, std::string* error)
+{
+    Close();
+    if (!m_file.Open(path))
+    {
+        SetError(error, "could not open " + path.string());
+        return false;
+    }
+
+    const PresetBankHeader* header = reinterpret_cast<const PresetBankHeader*>(m_file.GetData());
+    if (m_file.GetSize() < sizeof(PresetBankHeader) ||
+        memcmp(header->magic, PRESET_BANK_MAGIC, sizeof(PRESET_BANK_MAGIC)) != 0)
+    {
+        SetError(error, path.string() + " is not a preset bank");
+        Close();
+        return false;
+    }
+    if (header->version != PRESET_BANK_VERSION ||
+        header->headerSize != sizeof(PresetBankHeader) ||
+        header->patchSize != sizeof(PresetPatch) || header->paramCount > PRESET_MAX_PARAMS)
+    {
+        SetError(error, path.string() + " has unsupported bank version " +
+                            std::to_string(header->version));
+        Close();
+        return false;
+    }
+    if (m_file.GetSize() <
+        sizeof(PresetBankHeader) + (uint64_t)header->patchCount * sizeof(PresetPatch))
+    {
+        SetError(error, path.string() + " is truncated");
+        Close();
+        return false;
+    }
+
+    // Fault the whole bank in now rather than on the first switch to each patch
+    m_file.Prefault();
+
+    const PresetPatch* patches = reinterpret_cast<const PresetPatch*>(header + 1);
+    for (uint32_t p = 0; p < header->patchCount; p++)
+    {
+        if (!memchr(patches[p].name, '\0', PRESET_NAME_LENGTH))
+        {
+            SetError(error, path.string() + " has a corrupt name in patch " + std::to_string(p));
+            Close();
+            return false;
+        }
+    }
+
+    m_header = header;
+    m_patches = patches;
+    return true;
+}
+
+void PresetBank::Close()
+{
+    m_header = nullptr;
+    m_patches = nullptr;
+    m_file.Close();
+}
+
+float PresetBank::GetValue(unsigned int index, ParamId id) const
+{
+    float value = m_patches[index].values[(size_t)id];
+    if ((uint32_t)id >= m_header->paramCount || !std::isfinite(value))
+        return ParameterStore::GetInfo(id).defaultValue;
+    return value;
+}
+
+void PresetBank::Load(unsigned int index, PresetPatch& out) const
+{
+    out = m_patches[index];
+    for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+        out.values[i] = GetValue(index, (ParamId)i);
+}
+
+bool SavePresetBank(const std::filesystem::path& path, const std::vector<PresetPatch>& patches,
+                    std::string* error)
+{
+    PresetBankHeader header = {};
+    memcpy(header.magic, PRESET_BANK_MAGIC, sizeof(header.magic));
+    header.version = PRESET_BANK_VERSION;
+    header.headerSize = sizeof(PresetBankHeader);
+    header.patchSize = sizeof(PresetPatch);
+    header.paramCount = (uint32_t)ParamId::Count;
+    header.patchCount = (uint32_t)patches.size();
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)patches.data(),
+               (std::streamsize)(patches.size() * sizeof(PresetPatch)));
+    // Closing flushes, and a full disk may only show up then
+    file.close();
+    if (!file)
+    {
+        SetError(error, "could not write " + path.string());
+        return false;
+    }
+    return true;
+}
+
+bool ImportPresetText(const std::filesystem::path& path, std::vector<PresetPatch>& out,
+                      std::string* error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        SetError(error, "could not open " + path.string());
+        return false;
+    }
+
+    std::vector<PresetPatch> patches;
+    std::string line;
+    for (unsigned int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        std::string where = path.filename().string() + ":" + std::to_string(lineNumber) + ": ";
+        line = Trim(line);
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        if (line[0] == '[')
+        {
+            size_t close = line.rfind(']');
+            if (close == std::string::npos)
+            {
+                SetError(error, where + "missing ']'");
+                return false;
+            }
+            patches.push_back(MakeDefaultPatch(Trim(line.substr(1, close - 1)).c_str()));
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (equals == std::string::npos)
+        {
+            SetError(error, where + "expected 'key = value'");
+            return false;
+        }
+        if (patches.empty())
+        {
+            SetError(error, where + "value before the first [patch]");
+            return false;
+        }
+        std::string key = Trim(line.substr(0, equals));
+        ParamId id = ParameterStore::FindKey(key);
+        if (id == ParamId::Count)
+        {
+            SetError(error, where + "unknown parameter '" + key + "'");
+            return false;
+        }
+        std::string text = Trim(line.substr(equals + 1));
+        char* end = nullptr;
+        float value = strtof(text.c_str(), &end);
+        if (text.empty() || *end != '\0' || !std::isfinite(value))
+        {
+            SetError(error, where + "bad value '" + text + "'");
+            return false;
+        }
+        patches.back().values[(size_t)id] = value;
+    }
+
+    out = std::move(patches);
+    return true;
+}
+
+bool ExportPresetText(const std::filesystem::path& path, const PresetBank& bank)
+{
+    std::ofstream file(path, std::ios::trunc);
+    file << "# winsynth preset bank, version " << PRESET_BANK_VERSION << "\n";
+    for (unsigned int p = 0; p < bank.GetCount(); p++)
+    {
+        file << "\n[" << bank.GetPatch(p).name << "]\n";
+        for (size_t i = 0; i < (size_t)ParamId::Count; i++)
+        {
+            // %.9g round-trips every float exactly
+            char value[32];
+            snprintf(value, sizeof(value), "%.9g", bank.GetValue(p, (ParamId)i));
+            file << ParameterStore::GetInfo((ParamId)i).key << " = " << value << "\n";
+        }
+    }
+    return (bool)file;
+}
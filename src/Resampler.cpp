@@ -0,0 +1,197 @@
+#include "Resampler.h"
+
+#include "Simd.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr double RS_PI = 3.14159265358979323846;
+constexpr double FIXED_ONE = 4294967296.0; // 1.0 in 32.32 fixed point
+constexpr float FRACTION_SCALE = 1.0f / 4294967296.0f;
+constexpr size_t SIGNAL_CHUNK_FRAMES = 4096;
+
+struct QualitySpec
+{
+    unsigned int taps;
+    double beta;   // Kaiser window shape: higher trades a wider transition for more rejection
+    double cutoff; // Of the lower Nyquist frequency; the transition band straddles it
+};
+
+constexpr QualitySpec QUALITY_SPECS[] = {
+    {8, 4.0, 0.75},
+    {24, 7.0, 0.86},
+    {64, 9.5, 0.92},
+};
+static_assert(sizeof(QUALITY_SPECS) / sizeof(QUALITY_SPECS[0]) == (size_t)ResampleQuality::Count);
+
+// Zeroth-order modified Bessel function of the first kind, by its power series
+double BesselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+} // namespace
+
+void ResampleKernel::Prepare(ResampleQuality quality, double ratio)
+{
+    // Downsampling narrows the passband, so the kernel widens by the same factor to keep its
+    // transition band the same fraction of the output rate
+    const QualitySpec& spec = QUALITY_SPECS[(size_t)quality];
+    const double scale = std::clamp(ratio, (double)spec.taps / RESAMPLE_MAX_TAPS, 1.0);
+    m_taps = std::min((unsigned int)ceil(spec.taps / scale / 4.0) * 4, RESAMPLE_MAX_TAPS);
+    const double half = m_taps / 2;
+    const double cutoff = spec.cutoff * std::min(ratio, 1.0);
+    const double windowScale = 1.0 / BesselI0(spec.beta);
+
+    m_coeffs.assign((size_t)(PHASES + 1) * m_taps, 0.0f);
+    m_deltas.assign((size_t)(PHASES + 1) * m_taps, 0.0f);
+    std::vector<double> row(m_taps);
+    for (unsigned int p = 0; p <= PHASES; p++)
+    {
+        // Tap j of phase p sits (half - 1 - j + p / PHASES) input frames before the output
+        double sum = 0.0;
+        for (unsigned int j = 0; j < m_taps; j++)
+        {
+            double x = half - 1.0 - j + (double)p / PHASES;
+            double sinc = x == 0.0 ? 1.0 : sin(RS_PI * cutoff * x) / (RS_PI * cutoff * x);
+            double u = x / half;
+            double window = u * u < 1.0 ? BesselI0(spec.beta * sqrt(1.0 - u * u)) * windowScale
+                                        : 0.0;
+            row[j] = sinc * window;
+            sum += row[j];
+        }
+        // Unity gain at DC for every phase, or slow sweeps pick up a ripple
+        for (unsigned int j = 0; j < m_taps; j++)
+            m_coeffs[(size_t)p * m_taps + j] = (float)(row[j] / sum);
+    }
+    for (unsigned int p = 0; p < PHASES; p++)
+    {
+        for (unsigned int j = 0; j < m_taps; j++)
+        {
+            size_t i = (size_t)p * m_taps + j;
+            m_deltas[i] = m_coeffs[i + m_taps] - m_coeffs[i];
+        }
+    }
+}
+
+float ResampleKernel::Interpolate(const float* pTaps, float fraction) const
+{
+    float position = fraction * PHASES;
+    unsigned int phase = std::min((unsigned int)position, PHASES - 1);
+    float blend = position - (float)phase;
+    const float* pCoeffs = m_coeffs.data() + (size_t)phase * m_taps;
+    const float* pDeltas = m_deltas.data() + (size_t)phase * m_taps;
+
+    unsigned int j = 0;
+    float sum = 0.0f;
+#if SYNTH_HAS_SSE2
+    // Tap counts are always a multiple of four
+    const __m128 vBlend = _mm_set1_ps(blend);
+    __m128 vAcc = _mm_setzero_ps();
+    for (; j + 4 <= m_taps; j += 4)
+    {
+        __m128 vCoeff = _mm_add_ps(_mm_loadu_ps(pCoeffs + j),
+                                   _mm_mul_ps(vBlend, _mm_loadu_ps(pDeltas + j)));
+        vAcc = _mm_add_ps(vAcc, _mm_mul_ps(_mm_loadu_ps(pTaps + j), vCoeff));
+    }
+    vAcc = _mm_add_ps(vAcc, _mm_movehl_ps(vAcc, vAcc));
+    vAcc = _mm_add_ss(vAcc, _mm_shuffle_ps(vAcc, vAcc, 1));
+    sum = _mm_cvtss_f32(vAcc);
+#endif
+    for (; j < m_taps; j++)
+        sum += pTaps[j] * (pCoeffs[j] + blend * pDeltas[j]);
+    return sum;
+}
+
+void Resampler::Prepare(double inRate, double outRate, unsigned int channels,
+                        ResampleQuality quality, size_t maxPushFrames)
+{
+    m_kernel.Prepare(quality, outRate / inRate);
+    m_step = (uint64_t)llround(inRate / outRate * FIXED_ONE);
+    // Pull leaves fewer than `taps` frames behind, so a push always fits after it
+    m_buffers.assign(channels, std::vector<float>(m_kernel.GetTaps() + maxPushFrames, 0.0f));
+    Reset();
+}
+
+void Resampler::Reset()
+{
+    // Silence before the first input, so output frame 0 is centred on input frame 0
+    for (std::vector<float>& buffer : m_buffers)
+        std::fill(buffer.begin(), buffer.end(), 0.0f);
+    m_buffered = m_kernel.GetHalfTaps() - 1;
+    m_position = 0;
+}
+
+void Resampler::Push(const float* const* ppIn, size_t frames)
+{
+    if (m_buffers.empty())
+        return;
+    frames = std::min(frames, m_buffers[0].size() - m_buffered);
+    for (size_t c = 0; c < m_buffers.size(); c++)
+        memcpy(m_buffers[c].data() + m_buffered, ppIn[c], frames * sizeof(float));
+    m_buffered += frames;
+}
+
+size_t Resampler::Pull(float* const* ppOut, size_t offset, size_t frames)
+{
+    const size_t taps = m_kernel.GetTaps();
+    size_t done = 0;
+    for (; done < frames; done++)
+    {
+        size_t start = (size_t)(m_position >> 32);
+        if (start + taps > m_buffered)
+            break;
+        float fraction = (float)(uint32_t)m_position * FRACTION_SCALE;
+        for (size_t c = 0; c < m_buffers.size(); c++)
+            ppOut[c][offset + done] = m_kernel.Interpolate(m_buffers[c].data() + start, fraction);
+        m_position += m_step;
+    }
+
+    // Drop the input no later output can reach
+    size_t consumed = std::min((size_t)(m_position >> 32), m_buffered);
+    if (consumed > 0)
+    {
+        for (std::vector<float>& buffer : m_buffers)
+            memmove(buffer.data(), buffer.data() + consumed,
+                    (m_buffered - consumed) * sizeof(float));
+        m_buffered -= consumed;
+        m_position -= (uint64_t)consumed << 32;
+    }
+    return done;
+}
+
+std::vector<float> ResampleSignal(const std::vector<float>& in, double inRate, double outRate,
+                                  ResampleQuality quality)
+{
+    std::vector<float> out((size_t)llround(in.size() * outRate / inRate));
+    Resampler resampler;
+    resampler.Prepare(inRate, outRate, 1, quality, SIGNAL_CHUNK_FRAMES);
+
+    const std::vector<float> silence(SIGNAL_CHUNK_FRAMES, 0.0f);
+    float* pOut = out.data();
+    size_t done = 0;
+    size_t pushed = 0;
+    for (;;)
+    {
+        done += resampler.Pull(&pOut, done, out.size() - done);
+        if (done == out.size())
+            break;
+        // Past the end, silence flushes out the kernel's look-ahead
+        size_t count = std::min(SIGNAL_CHUNK_FRAMES, in.size() - pushed);
+        const float* pIn = count > 0 ? in.data() + pushed : silence.data();
+        resampler.Push(&pIn, count > 0 ? count : SIGNAL_CHUNK_FRAMES);
+        pushed += count;
+    }
+    return out;
+}
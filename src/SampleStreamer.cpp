@@ -0,0 +1,231 @@
+#include "SampleStreamer.h"
+
+#include "Trace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+constexpr uint64_t FRAME_MASK = (1ull << 48) - 1;
+constexpr uint32_t GENERATION_MASK = 0xFFFF;
+
+uint64_t PackFilled(uint32_t generation, uint64_t frames)
+{
+    return ((uint64_t)generation << 48) | (frames & FRAME_MASK);
+}
+} // namespace
+
+SampleStreamer::SampleStreamer(unsigned int slots)
+    : m_slots(std::make_unique<Slot[]>(slots)), m_slotCount(slots)
+{
+    for (unsigned int s = 0; s < slots; s++)
+        m_slots[s].ring = std::make_unique<float[]>(RING_FRAMES);
+    ResetStats();
+    m_thread = std::thread(&SampleStreamer::PrefetchLoop, this);
+}
+
+SampleStreamer::~SampleStreamer()
+{
+    m_running.store(false, std::memory_order_release);
+    m_wake.fetch_add(1, std::memory_order_release);
+    m_wake.notify_all();
+    m_thread.join();
+}
+
+void SampleStreamer::BeginVoice(unsigned int slot, const SampleZone* zone)
+{
+    Slot& s = m_slots[slot];
+    s.readerZone = zone;
+    s.readerGeneration = (s.readerGeneration + 1) & GENERATION_MASK;
+    s.released.store(0, std::memory_order_relaxed);
+    s.zone.store(zone, std::memory_order_relaxed);
+    s.generation.store(s.readerGeneration, std::memory_order_release);
+    Wake();
+}
+
+void SampleStreamer::EndVoice(unsigned int slot)
+{
+    BeginVoice(slot, nullptr);
+}
+
+void SampleStreamer::Read(unsigned int slot, int64_t first, size_t count, float* pOut)
+{
+    Slot& s = m_slots[slot];
+    const SampleZone* zone = s.readerZone;
+    if (!zone)
+    {
+        std::fill(pOut, pOut + count, 0.0f);
+        return;
+    }
+
+    // The head is resident and read in place
+    const int64_t head = (int64_t)SAMPLER_RESIDENT_FRAMES;
+    int64_t frame = first;
+    size_t done = 0;
+    if (frame < head)
+    {
+        done = (size_t)std::min<int64_t>(head - frame, (int64_t)count);
+        ReadSampleFrames(zone->wav, frame, done, pOut);
+        frame += (int64_t)done;
+    }
+
+    // Past the end of a one-shot sample is silence, not starvation
+    const int64_t end = (int64_t)std::min<uint64_t>(GetStreamEnd(zone), INT64_MAX);
+    const int64_t needed = std::min(first + (int64_t)count, end);
+    bool starved = false;
+    if (frame < needed)
+    {
+        uint64_t state = s.filled.load(std::memory_order_acquire);
+        int64_t filled = (uint32_t)(state >> 48) == s.readerGeneration
+                             ? (int64_t)(state & FRAME_MASK)
+                             : head;
+        int64_t available = std::min(needed, filled);
+        while (frame < available)
+        {
+            size_t index = (size_t)frame & (RING_FRAMES - 1);
+            size_t run = std::min(RING_FRAMES - index, (size_t)(available - frame));
+            memcpy(pOut + done, s.ring.get() + index, run * sizeof(float));
+            done += run;
+            frame += (int64_t)run;
+        }
+
+        starved = available < needed;
+        if (!starved && filled < end)
+        {
+            double leadMs = (filled - needed) * 1000.0 / zone->wav.GetSampleRate();
+            // Only this thread writes these, so load-then-store can't lose an update
+            m_leadSumMs.store(m_leadSumMs.load(std::memory_order_relaxed) + leadMs,
+                              std::memory_order_relaxed);
+            m_leadSamples.fetch_add(1, std::memory_order_relaxed);
+            if (leadMs < m_minLeadMs.load(std::memory_order_relaxed))
+                m_minLeadMs.store(leadMs, std::memory_order_relaxed);
+        }
+    }
+    std::fill(pOut + done, pOut + count, 0.0f);
+
+    m_reads.fetch_add(1, std::memory_order_relaxed);
+    if (starved)
+        m_starvations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SampleStreamer::Release(unsigned int slot, int64_t first)
+{
+    m_slots[slot].released.store(std::max<int64_t>(first, 0), std::memory_order_release);
+    Wake();
+}
+
+void SampleStreamer::WaitUntilFilled()
+{
+    Wake();
+    for (unsigned int i = 0; i < m_slotCount; i++)
+    {
+        const Slot& s = m_slots[i];
+        if (!s.readerZone)
+            continue;
+        const uint64_t limit = GetFillLimit(s, s.readerZone);
+        for (;;)
+        {
+            uint64_t state = s.filled.load(std::memory_order_acquire);
+            if ((uint32_t)(state >> 48) == s.readerGeneration && (state & FRAME_MASK) >= limit)
+                break;
+            std::this_thread::yield();
+        }
+    }
+}
+
+double SampleStreamer::GetHitRate() const
+{
+    uint64_t reads = GetReads();
+    return reads ? 1.0 - (double)GetStarvations() / reads : 1.0;
+}
+
+double SampleStreamer::GetAverageLeadMs() const
+{
+    uint64_t samples = m_leadSamples.load(std::memory_order_relaxed);
+    return samples ? m_leadSumMs.load(std::memory_order_relaxed) / samples : INFINITY;
+}
+
+void SampleStreamer::ResetStats()
+{
+    // Racy against a render in progress, which can only skew one block's figures
+    m_reads.store(0, std::memory_order_relaxed);
+    m_starvations.store(0, std::memory_order_relaxed);
+    m_leadSamples.store(0, std::memory_order_relaxed);
+    m_leadSumMs.store(0.0, std::memory_order_relaxed);
+    m_minLeadMs.store(INFINITY, std::memory_order_relaxed);
+}
+
+uint64_t SampleStreamer::GetStreamEnd(const SampleZone* zone)
+{
+    return zone->wav.HasLoop() ? UINT64_MAX : zone->wav.GetFrameCount();
+}
+
+uint64_t SampleStreamer::GetFillLimit(const Slot& slot, const SampleZone* zone) const
+{
+    // Everything from the oldest frame the voice still needs to a ring's length past it
+    uint64_t base = std::max<uint64_t>(slot.released.load(std::memory_order_acquire),
+                                       SAMPLER_RESIDENT_FRAMES);
+    return std::min(GetStreamEnd(zone), base + RING_FRAMES);
+}
+
+void SampleStreamer::PrefetchLoop()
+{
+    SYNTH_TRACE_THREAD("Streamer");
+    while (m_running.load(std::memory_order_acquire))
+    {
+        uint32_t wake = m_wake.load(std::memory_order_acquire);
+        // One chunk per slot per pass, so a voice far behind can't starve the others
+        bool worked = false;
+        for (unsigned int s = 0; s < m_slotCount; s++)
+            worked = FillSlot(m_slots[s]) || worked;
+        if (!worked)
+            m_wake.wait(wake, std::memory_order_acquire);
+    }
+}
+
+bool SampleStreamer::FillSlot(Slot& slot)
+{
+    uint32_t generation = slot.generation.load(std::memory_order_acquire);
+    if (generation != slot.writerGeneration)
+    {
+        // A new note. The zone may already be from a later one, in which case the data is
+        // tagged with a stale generation, ignored, and refilled on the next pass.
+        slot.writerGeneration = generation;
+        slot.writerZone = slot.zone.load(std::memory_order_relaxed);
+        slot.writerFilled = SAMPLER_RESIDENT_FRAMES;
+        slot.filled.store(PackFilled(generation, slot.writerFilled), std::memory_order_release);
+    }
+    const SampleZone* zone = slot.writerZone;
+    if (!zone)
+        return false;
+    const uint64_t limit = GetFillLimit(slot, zone);
+    if (slot.writerFilled >= limit)
+        return false;
+
+    double delayMs = m_diskDelayMs.load(std::memory_order_relaxed);
+    if (delayMs > 0.0)
+        std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(delayMs));
+
+    SYNTH_TRACE_SCOPE("FillSlot");
+    // Page faults on the mapping happen here, off the render thread
+    size_t count = (size_t)std::min<uint64_t>(CHUNK_FRAMES, limit - slot.writerFilled);
+    size_t index = (size_t)slot.writerFilled & (RING_FRAMES - 1);
+    size_t run = std::min(count, RING_FRAMES - index);
+    float* pRing = slot.ring.get();
+    ReadSampleFrames(zone->wav, (int64_t)slot.writerFilled, run, pRing + index);
+    if (run < count)
+        ReadSampleFrames(zone->wav, (int64_t)(slot.writerFilled + run), count - run, pRing);
+
+    slot.writerFilled += count;
+    slot.filled.store(PackFilled(generation, slot.writerFilled), std::memory_order_release);
+    return true;
+}
+
+void SampleStreamer::Wake()
+{
+    m_wake.fetch_add(1, std::memory_order_release);
+    m_wake.notify_one();
+}
@@ -0,0 +1,517 @@
+#include "Sampler.h"
+
+#include "SampleStreamer.h"
+#include "Simd.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace
+{
+constexpr uint16_t FORMAT_PCM = 1;
+constexpr uint16_t FORMAT_FLOAT = 3;
+constexpr uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+constexpr double FIXED_ONE = 4294967296.0; // 1.0 in 32.32 fixed point
+constexpr float FRACTION_SCALE = 1.0f / 4294967296.0f;
+
+uint32_t ReadU32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint16_t ReadU16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+void SetError(std::string* error, std::string message)
+{
+    if (error)
+        *error = std::move(message);
+}
+
+// MIDI note from a name such as "C4", "F#3" or "Bb2", with C4 as 60
+double ParseNoteName(const std::string& name)
+{
+    static const int SEMITONES[] = {9, 11, 0, 2, 4, 5, 7}; // A to G
+    if (name.size() < 2)
+        return -1.0;
+    char letter = (char)std::toupper((unsigned char)name[0]);
+    if (letter < 'A' || letter > 'G')
+        return -1.0;
+    int semitone = SEMITONES[letter - 'A'];
+    size_t i = 1;
+    if (name[i] == '#')
+        semitone++, i++;
+    else if (name[i] == 'b')
+        semitone--, i++;
+
+    char* end = nullptr;
+    long octave = strtol(name.c_str() + i, &end, 10);
+    if (end == name.c_str() + i || *end != '\0')
+        return -1.0;
+    return (double)((octave + 1) * 12 + semitone);
+}
+
+// Root note from the last separated part of a file name that reads as a note, so both
+// "Piano_F#3" and "Bass-A-1" work; negative if there is none
+double ParseRootNote(const std::string& stem)
+{
+    for (size_t separator = stem.size(); separator-- > 0;)
+    {
+        if (stem[separator] != '_' && stem[separator] != '-' && stem[separator] != ' ')
+            continue;
+        double note = ParseNoteName(stem.substr(separator + 1));
+        if (note >= 0.0)
+            return note;
+    }
+    return ParseNoteName(stem);
+}
+
+// Catmull-Rom spline between x0 and x1, t in [0, 1)
+inline float Hermite(float xm1, float x0, float x1, float x2, float t)
+{
+    float c1 = 0.5f * (x1 - xm1);
+    float c2 = xm1 - 2.5f * x0 + 2.0f * x1 - 0.5f * x2;
+    float c3 = 0.5f * (x2 - xm1) + 1.5f * (x0 - x1);
+    return ((c3 * t + c2) * t + c1) * t + x0;
+}
+} // namespace
+
+bool MappedWav::Open(const std::filesystem::path& path, std::string* error)
+{
+    const std::string name = path.filename().string();
+    if (!m_file.Open(path))
+    {
+        SetError(error, "could not open " + name);
+        return false;
+    }
+    const unsigned char* pFile = m_file.GetData();
+    const uint64_t size = m_file.GetSize();
+    if (size < 12 || memcmp(pFile, "RIFF", 4) != 0 || memcmp(pFile + 8, "WAVE", 4) != 0)
+    {
+        SetError(error, name + " is not a WAV file");
+        return false;
+    }
+
+    uint16_t format = 0;
+    uint16_t bits = 0;
+    uint64_t dataOffset = 0;
+    uint64_t dataBytes = 0;
+    bool haveFormat = false;
+    for (uint64_t offset = 12; offset + 8 <= size;)
+    {
+        const unsigned char* pChunk = pFile + offset;
+        uint64_t body = offset + 8;
+        uint64_t chunkBytes = std::min<uint64_t>(ReadU32(pChunk + 4), size - body);
+        if (memcmp(pChunk, "fmt ", 4) == 0 && chunkBytes >= 16)
+        {
+            format = ReadU16(pFile + body);
+            m_channels = ReadU16(pFile + body + 2);
+            m_sampleRate = ReadU32(pFile + body + 4);
+            bits = ReadU16(pFile + body + 14);
+            // The sub-format GUID starts with the plain format tag
+            if (format == FORMAT_EXTENSIBLE && chunkBytes >= 26)
+                format = ReadU16(pFile + body + 24);
+            haveFormat = true;
+        }
+        else if (memcmp(pChunk, "data", 4) == 0)
+        {
+            dataOffset = body;
+            dataBytes = chunkBytes;
+        }
+        else if (memcmp(pChunk, "smpl", 4) == 0 && chunkBytes >= 36)
+        {
+            const unsigned char* pSmpl = pFile + body;
+            m_rootNote = ReadU32(pSmpl + 12) + ReadU32(pSmpl + 16) / FIXED_ONE;
+            // First loop only; its end frame is inclusive
+            if (ReadU32(pSmpl + 28) > 0 && chunkBytes >= 36 + 24)
+            {
+                m_loopStart = ReadU32(pSmpl + 36 + 8);
+                m_loopEnd = (size_t)ReadU32(pSmpl + 36 + 12) + 1;
+            }
+        }
+        // Chunks are padded to an even size
+        offset = body + chunkBytes + (chunkBytes & 1);
+    }
+
+    if (!haveFormat || dataBytes == 0 || m_channels == 0 || m_sampleRate == 0)
+    {
+        SetError(error, name + " has no audio");
+        return false;
+    }
+    if (format == FORMAT_FLOAT && bits == 32)
+        m_encoding = Encoding::Float32;
+    else if (format == FORMAT_PCM && (bits == 16 || bits == 24 || bits == 32))
+        m_encoding = bits == 16 ? Encoding::Int16 : bits == 24 ? Encoding::Int24 : Encoding::Int32;
+    else
+    {
+        SetError(error, name + " uses an unsupported sample format");
+        return false;
+    }
+
+    m_frameBytes = m_channels * bits / 8;
+    m_dataOffset = dataOffset;
+    m_frames = (size_t)(dataBytes / m_frameBytes);
+    m_pFrames = pFile + dataOffset;
+    if (m_frames == 0)
+    {
+        SetError(error, name + " has no audio");
+        return false;
+    }
+    m_loopEnd = std::min(m_loopEnd, m_frames);
+    if (m_loopEnd <= m_loopStart)
+        m_loopStart = m_loopEnd = 0;
+    return true;
+}
+
+void MappedWav::Prefault(size_t first, size_t count) const
+{
+    m_file.Prefault(m_dataOffset + (uint64_t)first * m_frameBytes, (uint64_t)count * m_frameBytes);
+}
+
+void MappedWav::DecodeMono(size_t first, size_t count, float* pOut) const
+{
+    size_t n = 0;
+#if SYNTH_HAS_SSE2
+    const unsigned char* p = m_pFrames + first * m_frameBytes;
+    if (m_encoding == Encoding::Int16 && m_channels == 1)
+    {
+        const __m128 vScale = _mm_set1_ps(1.0f / 32768.0f);
+        for (; n + 8 <= count; n += 8)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + n * 2));
+            // Duplicate each sample into both halves of a 32-bit lane, then sign-extend
+            __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+            __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+            _mm_storeu_ps(pOut + n, _mm_mul_ps(_mm_cvtepi32_ps(lo), vScale));
+            _mm_storeu_ps(pOut + n + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), vScale));
+        }
+    }
+    else if (m_encoding == Encoding::Int16 && m_channels == 2)
+    {
+        // madd against ones sums each L, R pair into one 32-bit lane
+        const __m128i vOnes = _mm_set1_epi16(1);
+        const __m128 vScale = _mm_set1_ps(0.5f / 32768.0f);
+        for (; n + 4 <= count; n += 4)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)(p + n * 4));
+            __m128 sum = _mm_cvtepi32_ps(_mm_madd_epi16(v, vOnes));
+            _mm_storeu_ps(pOut + n, _mm_mul_ps(sum, vScale));
+        }
+    }
+    else if (m_encoding == Encoding::Float32 && m_channels == 1)
+    {
+        memcpy(pOut, p, count * sizeof(float));
+        return;
+    }
+    else if (m_encoding == Encoding::Float32 && m_channels == 2)
+    {
+        const __m128 vHalf = _mm_set1_ps(0.5f);
+        const float* pIn = (const float*)p;
+        for (; n + 4 <= count; n += 4)
+        {
+            __m128 a = _mm_loadu_ps(pIn + n * 2);
+            __m128 b = _mm_loadu_ps(pIn + n * 2 + 4);
+            __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+            __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            _mm_storeu_ps(pOut + n, _mm_mul_ps(_mm_add_ps(left, right), vHalf));
+        }
+    }
+#endif
+    DecodeMonoScalar(first + n, count - n, pOut + n);
+}
+
+void MappedWav::DecodeMonoScalar(size_t first, size_t count, float* pOut) const
+{
+    const float channelScale = 1.0f / m_channels;
+    const unsigned int sampleBytes = m_frameBytes / m_channels;
+    const unsigned char* p = m_pFrames + first * m_frameBytes;
+    for (size_t n = 0; n < count; n++)
+    {
+        float sum = 0.0f;
+        for (unsigned int c = 0; c < m_channels; c++, p += sampleBytes)
+        {
+            switch (m_encoding)
+            {
+            case Encoding::Int16:
+                sum += (float)(int16_t)ReadU16(p) / 32768.0f;
+                break;
+            case Encoding::Int24:
+                sum += (float)((int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+                                         ((uint32_t)p[2] << 24)) >>
+                               8) /
+                       8388608.0f;
+                break;
+            case Encoding::Int32:
+                sum += (float)((double)(int32_t)ReadU32(p) / 2147483648.0);
+                break;
+            case Encoding::Float32:
+            {
+                float value;
+                memcpy(&value, p, sizeof(value));
+                sum += value;
+                break;
+            }
+            }
+        }
+        pOut[n] = sum * channelScale;
+    }
+}
+
+void ReadSampleFrames(const MappedWav& wav, int64_t first, size_t count, float* pOut)
+{
+    const bool loop = wav.HasLoop();
+    const int64_t limit = (int64_t)(loop ? wav.GetLoopEnd() : wav.GetFrameCount());
+    const int64_t loopStart = (int64_t)wav.GetLoopStart();
+    const int64_t loopLength = limit - loopStart;
+
+    int64_t frame = first;
+    size_t done = 0;
+    while (done < count)
+    {
+        size_t remaining = count - done;
+        if (frame < 0)
+        {
+            size_t run = (size_t)std::min<int64_t>(-frame, (int64_t)remaining);
+            std::fill(pOut + done, pOut + done + run, 0.0f);
+            done += run;
+            frame += (int64_t)run;
+            continue;
+        }
+        int64_t source = frame;
+        if (source >= limit)
+        {
+            if (!loop)
+            {
+                std::fill(pOut + done, pOut + count, 0.0f);
+                return;
+            }
+            source = loopStart + (source - limit) % loopLength;
+        }
+        size_t run = (size_t)std::min<int64_t>(limit - source, (int64_t)remaining);
+        wav.DecodeMono((size_t)source, run, pOut + done);
+        done += run;
+        frame += (int64_t)run;
+    }
+}
+
+SampleInstrument::SampleInstrument() = default;
+
+SampleInstrument::~SampleInstrument() = default;
+
+bool SampleInstrument::Load(const std::filesystem::path& directory, double renderRate,
+                            unsigned int voices, std::string* error)
+{
+    m_streamer.reset();
+    m_zones.clear();
+    m_kernels.clear();
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        std::string extension = entry.path().extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return (char)std::tolower(c); });
+        if (!entry.is_regular_file() || extension != ".wav")
+            continue;
+
+        auto zone = std::make_unique<SampleZone>();
+        if (!zone->wav.Open(entry.path(), error))
+            return false;
+        double root = zone->wav.GetRootNote();
+        if (root < 0.0)
+            root = ParseRootNote(entry.path().stem().string());
+        if (root < 0.0)
+        {
+            SetError(error, "no root note for " + entry.path().filename().string() +
+                                "; add a smpl chunk or end the name with a note, e.g. _C4");
+            return false;
+        }
+        zone->rootFreq = 440.0 * pow(2.0, (root - 69.0) / 12.0);
+
+        unsigned int rate = zone->wav.GetSampleRate();
+        auto kernels = m_kernels.find(rate);
+        if (kernels == m_kernels.end())
+        {
+            kernels = m_kernels.emplace(rate, KernelSet()).first;
+            for (size_t q = 0; q < kernels->second.size(); q++)
+                kernels->second[q].Prepare((ResampleQuality)q, renderRate / rate);
+        }
+        zone->kernels = kernels->second.data();
+
+        // Page in everything a voice can read before the streamer has caught up, so the
+        // render thread never waits on the disk for it
+        const MappedWav& wav = zone->wav;
+        size_t playedFrames = wav.HasLoop() ? wav.GetLoopEnd() : wav.GetFrameCount();
+        zone->streamed = playedFrames > SAMPLER_RESIDENT_FRAMES;
+        wav.Prefault(0, std::min(playedFrames, SAMPLER_RESIDENT_FRAMES));
+        m_zones.push_back(std::move(zone));
+    }
+    if (ec || m_zones.empty())
+    {
+        SetError(error, "no WAV files in " + directory.string());
+        return false;
+    }
+
+    std::sort(m_zones.begin(), m_zones.end(),
+              [](const std::unique_ptr<SampleZone>& a, const std::unique_ptr<SampleZone>& b) {
+                  return a->rootFreq < b->rootFreq;
+              });
+    if (GetStreamedZoneCount() > 0)
+        m_streamer = std::make_unique<SampleStreamer>(voices);
+    return true;
+}
+
+const SampleZone* SampleInstrument::FindZone(double freq) const
+{
+    const SampleZone* best = nullptr;
+    double bestDistance = INFINITY;
+    for (const std::unique_ptr<SampleZone>& zone : m_zones)
+    {
+        double distance = fabs(log2(freq / zone->rootFreq));
+        if (distance < bestDistance)
+        {
+            best = zone.get();
+            bestDistance = distance;
+        }
+    }
+    return best;
+}
+
+size_t SampleInstrument::GetMappedBytes() const
+{
+    size_t bytes = 0;
+    for (const std::unique_ptr<SampleZone>& zone : m_zones)
+        bytes += zone->wav.GetDataBytes();
+    return bytes;
+}
+
+size_t SampleInstrument::GetStreamedZoneCount() const
+{
+    return (size_t)std::count_if(m_zones.begin(), m_zones.end(),
+                                 [](const std::unique_ptr<SampleZone>& zone) {
+                                     return zone->streamed;
+                                 });
+}
+
+void RenderSampler(SamplerVoice& voice, SampleStreamer* pStreamer,
+                   SamplerInterpolation interpolation, double freq, double sampleRate, float gain,
+                   float* pOut, unsigned int stride, unsigned int nFrames, float* pDecode)
+{
+    if (!voice.zone)
+    {
+        for (unsigned int n = 0; n < nFrames; n++)
+            pOut[n * stride] = 0.0f;
+        return;
+    }
+
+    const MappedWav& wav = voice.zone->wav;
+    double step = freq / voice.zone->rootFreq * wav.GetSampleRate() / sampleRate;
+    const uint64_t fixedStep = (uint64_t)(std::min(step, SAMPLER_MAX_STEP) * FIXED_ONE);
+
+    const size_t sinc = (size_t)interpolation - (size_t)SamplerInterpolation::SincDraft;
+    const ResampleKernel* pKernel =
+        interpolation == SamplerInterpolation::Cubic ? nullptr : &voice.zone->kernels[sinc];
+    const unsigned int half = pKernel ? pKernel->GetHalfTaps() : 2;
+
+    // Decode from `half - 1` frames before the first read position to `half` after the last,
+    // so every output frame finds its taps at pDecode[i - half + 1] .. pDecode[i + half]
+    const int64_t first = (int64_t)(voice.position >> 32) - (half - 1);
+    const uint64_t start = (voice.position & 0xFFFFFFFFull) + ((uint64_t)(half - 1) << 32);
+    const size_t span = (size_t)((start + fixedStep * (nFrames - 1)) >> 32) + half + 1;
+    const bool streamed = voice.zone->streamed && pStreamer;
+    if (streamed)
+        pStreamer->Read(voice.slot, first, span, pDecode);
+    else
+        ReadSampleFrames(wav, first, span, pDecode);
+
+    unsigned int n = 0;
+    if (pKernel)
+    {
+        for (; n < nFrames; n++)
+        {
+            uint64_t position = start + fixedStep * n;
+            const float* pTaps = pDecode + (position >> 32) - (half - 1);
+            float t = (float)(uint32_t)position * FRACTION_SCALE;
+            pOut[n * stride] = pKernel->Interpolate(pTaps, t) * gain;
+        }
+    }
+#if SYNTH_HAS_SSE2
+    const __m128 vHalf = _mm_set1_ps(0.5f);
+    const __m128 vOneHalf = _mm_set1_ps(1.5f);
+    const __m128 vTwo = _mm_set1_ps(2.0f);
+    const __m128 vTwoHalf = _mm_set1_ps(2.5f);
+    const __m128 vGain = _mm_set1_ps(gain);
+    for (; n + 4 <= nFrames; n += 4)
+    {
+        // The taps are a gather, so they're loaded per lane; the cubic runs four wide
+        alignas(16) float taps[4][4];
+        alignas(16) float fractions[4];
+        for (unsigned int k = 0; k < 4; k++)
+        {
+            uint64_t position = start + fixedStep * (n + k);
+            const float* pTap = pDecode + (position >> 32) - 1;
+            for (unsigned int t = 0; t < 4; t++)
+                taps[t][k] = pTap[t];
+            fractions[k] = (float)(uint32_t)position * FRACTION_SCALE;
+        }
+        __m128 xm1 = _mm_load_ps(taps[0]);
+        __m128 x0 = _mm_load_ps(taps[1]);
+        __m128 x1 = _mm_load_ps(taps[2]);
+        __m128 x2 = _mm_load_ps(taps[3]);
+        __m128 t = _mm_load_ps(fractions);
+        __m128 c1 = _mm_mul_ps(vHalf, _mm_sub_ps(x1, xm1));
+        __m128 c2 = _mm_sub_ps(_mm_add_ps(xm1, _mm_mul_ps(vTwo, x1)),
+                               _mm_add_ps(_mm_mul_ps(vTwoHalf, x0), _mm_mul_ps(vHalf, x2)));
+        __m128 c3 = _mm_add_ps(_mm_mul_ps(vHalf, _mm_sub_ps(x2, xm1)),
+                               _mm_mul_ps(vOneHalf, _mm_sub_ps(x0, x1)));
+        __m128 y = _mm_add_ps(_mm_mul_ps(_mm_add_ps(_mm_mul_ps(c3, t), c2), t), c1);
+        y = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(y, t), x0), vGain);
+
+        alignas(16) float out[4];
+        _mm_store_ps(out, y);
+        for (unsigned int k = 0; k < 4; k++)
+            pOut[(n + k) * stride] = out[k];
+    }
+#endif
+    for (; n < nFrames; n++)
+    {
+        uint64_t position = start + fixedStep * n;
+        const float* pTap = pDecode + (position >> 32) - 1;
+        float t = (float)(uint32_t)position * FRACTION_SCALE;
+        pOut[n * stride] = Hermite(pTap[0], pTap[1], pTap[2], pTap[3], t) * gain;
+    }
+
+    voice.position += fixedStep * nFrames;
+    uint64_t frame = voice.position >> 32;
+    if (streamed)
+    {
+        // Keep what the widest interpolation reads before the new position
+        if (!wav.HasLoop() && frame >= wav.GetFrameCount())
+        {
+            pStreamer->EndVoice(voice.slot);
+            voice.zone = nullptr;
+        }
+        else
+        {
+            pStreamer->Release(voice.slot, (int64_t)frame - (int64_t)SAMPLER_MAX_HALF_TAPS);
+        }
+    }
+    else if (wav.HasLoop())
+    {
+        if (frame >= wav.GetLoopEnd())
+        {
+            uint64_t length = wav.GetLoopEnd() - wav.GetLoopStart();
+            uint64_t wrapped = wav.GetLoopStart() + (frame - wav.GetLoopEnd()) % length;
+            voice.position = (wrapped << 32) | (voice.position & 0xFFFFFFFFull);
+        }
+    }
+    else if (frame >= wav.GetFrameCount())
+    {
+        voice.zone = nullptr;
+    }
+}
@@ -0,0 +1,368 @@
+#include "SpectralBank.h"
+#include "SimdLanes.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+using namespace simd;
+
+constexpr double SPECTRAL_TWO_PI = 6.28318530717958647692;
+constexpr float ENVELOPE_FLOOR = 0.001f; // -60 dB, where release time is measured
+constexpr float SILENCE_LEVEL = 1e-4f;   // A releasing envelope below this has finished
+// Four-term Blackman-Harris: sidelobes 92 dB down, main lobe four bins either side
+constexpr double WINDOW_TERMS[4] = {0.35875, 0.48829, 0.14128, 0.01168};
+constexpr unsigned int KERNEL_LEFT = 3; // Bins of the kernel below the partial's own
+
+// Detuned copies of a harmonic series, interleaved so a shorter patch loses its top
+// harmonics from every copy alike
+struct SpectralSeries
+{
+    unsigned int copies;
+    float detuneCents; // Of the outermost copies
+    float slope;       // Harmonic k has level / k^slope
+    float level;
+    float attackMs;
+    float releaseMs;
+};
+
+constexpr SpectralSeries SPECTRAL_SERIES[SPECTRAL_PRESETS] = {
+    {1, 0.0f, 1.0f, 0.55f, 5.0f, 300.0f},
+    {7, 12.0f, 1.0f, 0.15f, 300.0f, 1200.0f},
+    {12, 30.0f, 0.7f, 0.06f, 800.0f, 2500.0f},
+};
+
+float SamplesFor(float ms, double sampleRate)
+{
+    return (float)std::max(1.0, ms * 0.001 * sampleRate);
+}
+
+// Centred on m = 0, for m in [-FRAME_SIZE / 2, FRAME_SIZE / 2]
+double Window(double m)
+{
+    double x = SPECTRAL_TWO_PI * m / SpectralBank::FRAME_SIZE;
+    return WINDOW_TERMS[0] + WINDOW_TERMS[1] * cos(x) + WINDOW_TERMS[2] * cos(2.0 * x) +
+           WINDOW_TERMS[3] * cos(3.0 * x);
+}
+
+// The window's spectrum, real and even, at an offset of nu bins
+double WindowSpectrum(double nu)
+{
+    const int half = (int)SpectralBank::FRAME_SIZE / 2;
+    double sum = Window(0.0) + Window(-half) * cos(SPECTRAL_TWO_PI * nu * 0.5);
+    for (int m = 1; m < half; m++)
+        sum += 2.0 * Window(m) * cos(SPECTRAL_TWO_PI * nu * m / SpectralBank::FRAME_SIZE);
+    return sum;
+}
+} // namespace
+
+const char* const SPECTRAL_PRESET_NAMES[SPECTRAL_PRESETS] = {"Sawtooth", "Detuned saws",
+                                                             "Bright cluster"};
+
+SpectralPatch MakeSpectralPreset(unsigned int index, unsigned int partialCount)
+{
+    const SpectralSeries& series = SPECTRAL_SERIES[std::min(index, SPECTRAL_PRESETS - 1)];
+    SpectralPatch patch = {};
+    patch.partialCount = std::min(partialCount, SPECTRAL_MAX_PARTIALS);
+    patch.attackMs = series.attackMs;
+    patch.releaseMs = series.releaseMs;
+    for (unsigned int i = 0; i < patch.partialCount; i++)
+    {
+        float harmonic = (float)(i / series.copies + 1);
+        unsigned int copy = i % series.copies;
+        float cents = series.copies > 1
+                          ? series.detuneCents * (2.0f * copy / (series.copies - 1) - 1.0f)
+                          : 0.0f;
+        patch.ratios[i] = harmonic * exp2f(cents / 1200.0f);
+        patch.amplitudes[i] = series.level / powf(harmonic, series.slope);
+    }
+    return patch;
+}
+
+SpectralBank::SpectralBank()
+    : m_partials(std::make_unique<Partials[]>(MAX_VOICES)),
+      m_output(std::make_unique<Output[]>(MAX_VOICES))
+{
+    // The window's spectrum at KERNEL_STEPS offsets per bin, laid out by row so a partial
+    // reads its whole kernel contiguously
+    static_assert(KERNEL_BINS % LANES == 0, "The kernel is added a lane group at a time");
+    for (unsigned int row = 0; row <= KERNEL_STEPS; row++)
+    {
+        for (unsigned int j = 0; j < KERNEL_BINS; j++)
+        {
+            double offset = (double)j - KERNEL_LEFT - (double)row / KERNEL_STEPS;
+            double value = WindowSpectrum(offset);
+            m_kernel[row][j] = (float)(j & 1 ? -value : value);
+        }
+    }
+    // The triangle of the middle half of frame j overlaps the triangles of frames j - 1 and
+    // j + 1 to sum to one; dividing by the window leaves plain partials under it
+    for (unsigned int t = 0; t < 2 * HOP; t++)
+    {
+        double triangle = 1.0 - fabs((double)t - HOP) / HOP;
+        m_synthesis[t] = (float)(triangle / Window((double)t - HOP));
+    }
+    m_fft.Prepare(FRAME_SIZE);
+}
+
+void SpectralBank::NoteOn(unsigned int voice, double freq)
+{
+    m_freq[voice] = freq;
+    m_stage[voice] = Stage::Attack;
+    m_partials[voice].stale = true;
+    m_partials[voice].restart = true;
+    m_soundingMask |= 1u << voice;
+    m_finishingMask &= ~(1u << voice);
+}
+
+void SpectralBank::NoteOff(unsigned int voice)
+{
+    if (m_stage[voice] != Stage::Idle)
+        m_stage[voice] = Stage::Release;
+}
+
+void SpectralBank::Silence()
+{
+    for (unsigned int v = 0; v < MAX_VOICES; v++)
+    {
+        m_stage[v] = Stage::Idle;
+        m_envelope[v] = 0.0f;
+        Output& out = m_output[v];
+        std::fill(std::begin(out.hop), std::end(out.hop), 0.0f);
+        std::fill(std::begin(out.tail), std::end(out.tail), 0.0f);
+    }
+    m_soundingMask = 0;
+    m_finishingMask = 0;
+}
+
+void SpectralBank::PatchChanged()
+{
+    for (unsigned int v = 0; v < MAX_VOICES; v++)
+        m_partials[v].stale = true;
+}
+
+unsigned int SpectralBank::GetPartialCount(unsigned int voice) const
+{
+    return m_partials[voice].count;
+}
+
+void SpectralBank::Tune(unsigned int voice, const SpectralPatch& patch, double sampleRate)
+{
+    Partials& p = m_partials[voice];
+    // Where each patch partial sits now, so survivors keep their phase
+    int16_t slotOf[SPECTRAL_MAX_PARTIALS];
+    std::fill(std::begin(slotOf), std::end(slotOf), (int16_t)-1);
+    if (!p.restart)
+    {
+        for (unsigned int i = 0; i < p.count; i++)
+            slotOf[p.partial[i]] = (int16_t)i;
+    }
+
+    float previousCos[SPECTRAL_MAX_PARTIALS];
+    float previousSin[SPECTRAL_MAX_PARTIALS];
+    std::copy(p.cos, p.cos + p.count, previousCos);
+    std::copy(p.sin, p.sin + p.count, previousSin);
+
+    const unsigned int partials = std::min(patch.partialCount, SPECTRAL_MAX_PARTIALS);
+    // The kernel of the highest partial must end below the Nyquist bin
+    const double topBin = (double)(FRAME_SIZE / 2 - (KERNEL_BINS - KERNEL_LEFT - 1));
+    const double binsPerHz = FRAME_SIZE / sampleRate;
+    unsigned int count = 0;
+    for (unsigned int k = 0; k < partials; k++)
+    {
+        double freq = m_freq[voice] * patch.ratios[k];
+        double bin = freq * binsPerHz;
+        if (freq <= 0.0 || bin >= topBin)
+            continue;
+        int slot = slotOf[k];
+        if (slot >= 0)
+        {
+            p.cos[count] = previousCos[slot];
+            p.sin[count] = previousSin[slot];
+        }
+        else
+        {
+            // Sine phase zero at the frame centre: a cosine a quarter cycle behind
+            p.cos[count] = 0.0f;
+            p.sin[count] = -1.0f;
+        }
+        double omega = SPECTRAL_TWO_PI * freq / sampleRate * HOP;
+        p.rotationCos[count] = (float)cos(omega);
+        p.rotationSin[count] = (float)sin(omega);
+        p.bin[count] = (float)bin;
+        p.partial[count] = (uint16_t)k;
+        count++;
+    }
+    p.count = count;
+    p.stale = false;
+    p.restart = false;
+}
+
+bool SpectralBank::AdvanceEnvelope(unsigned int voice, const SpectralPatch& patch,
+                                   double sampleRate)
+{
+    float& envelope = m_envelope[voice];
+    Stage& stage = m_stage[voice];
+    if (stage == Stage::Attack)
+    {
+        envelope += HOP / SamplesFor(patch.attackMs, sampleRate);
+        if (envelope >= 1.0f)
+        {
+            envelope = 1.0f;
+            stage = Stage::Hold;
+        }
+    }
+    else if (stage == Stage::Release)
+    {
+        envelope *= powf(ENVELOPE_FLOOR, HOP / SamplesFor(patch.releaseMs, sampleRate));
+        if (envelope < SILENCE_LEVEL)
+        {
+            envelope = 0.0f;
+            stage = Stage::Idle;
+        }
+    }
+    return stage != Stage::Idle;
+}
+
+void SpectralBank::SynthesiseFrame(unsigned int voice, const SpectralPatch& patch, float scale)
+{
+    Partials& p = m_partials[voice];
+    std::fill(std::begin(m_spectrumRe), std::end(m_spectrumRe), 0.0f);
+    std::fill(std::begin(m_spectrumIm), std::end(m_spectrumIm), 0.0f);
+
+    // A real partial is half its amplitude at its own frequency and half at the mirror image
+    const float halfScale = 0.5f * scale;
+    for (unsigned int i = 0; i < p.count; i++)
+    {
+        float amplitude = patch.amplitudes[p.partial[i]] * halfScale;
+        float re = amplitude * p.cos[i];
+        float im = amplitude * p.sin[i];
+
+        float whole = floorf(p.bin[i]);
+        float position = (p.bin[i] - whole) * KERNEL_STEPS;
+        unsigned int row = std::min((unsigned int)position, KERNEL_STEPS - 1);
+        float blend = position - row;
+        int first = (int)whole - (int)KERNEL_LEFT;
+        // Centring the frame on FRAME_SIZE / 2 negates every odd bin
+        float sign = first & 1 ? -1.0f : 1.0f;
+        float weightA = (1.0f - blend) * sign;
+        float weightB = blend * sign;
+
+        if (first > 0)
+        {
+            const Lanes reA = Splat(re * weightA);
+            const Lanes reB = Splat(re * weightB);
+            const Lanes imA = Splat(im * weightA);
+            const Lanes imB = Splat(im * weightB);
+            for (unsigned int j = 0; j < KERNEL_BINS; j += LANES)
+            {
+                Lanes a = Load(m_kernel[row] + j);
+                Lanes b = Load(m_kernel[row + 1] + j);
+                float* pRe = m_spectrumRe + first + j;
+                float* pIm = m_spectrumIm + first + j;
+                StoreUnaligned(pRe, Add(LoadUnaligned(pRe), Add(Mul(a, reA), Mul(b, reB))));
+                StoreUnaligned(pIm, Add(LoadUnaligned(pIm), Add(Mul(a, imA), Mul(b, imB))));
+            }
+        }
+        else
+        {
+            // Near DC the kernel overlaps its mirror image: bins below zero fold back
+            // conjugated, and the DC bin takes both halves, which leaves it real
+            for (unsigned int j = 0; j < KERNEL_BINS; j++)
+            {
+                float kernel = m_kernel[row][j] * weightA + m_kernel[row + 1][j] * weightB;
+                int bin = first + (int)j;
+                if (bin > 0)
+                {
+                    m_spectrumRe[bin] += re * kernel;
+                    m_spectrumIm[bin] += im * kernel;
+                }
+                else if (bin == 0)
+                    m_spectrumRe[0] += 2.0f * re * kernel;
+                else
+                {
+                    m_spectrumRe[-bin] += re * kernel;
+                    m_spectrumIm[-bin] -= im * kernel;
+                }
+            }
+        }
+
+        // On to the centre of the next frame; rounding slowly changes the magnitude, so pull
+        // it back towards 1
+        float c = p.cos[i] * p.rotationCos[i] - p.sin[i] * p.rotationSin[i];
+        float s = p.cos[i] * p.rotationSin[i] + p.sin[i] * p.rotationCos[i];
+        float correction = 1.5f - 0.5f * (c * c + s * s);
+        p.cos[i] = c * correction;
+        p.sin[i] = s * correction;
+    }
+    m_fft.Inverse(m_spectrumRe, m_spectrumIm, m_frame);
+}
+
+unsigned int SpectralBank::Render(const SpectralPatch& patch, float* pVoices,
+                                  unsigned int nFrames, double sampleRate, float gain)
+{
+    if (sampleRate != m_sampleRate)
+    {
+        m_sampleRate = sampleRate;
+        PatchChanged();
+    }
+    const unsigned int written = m_soundingMask;
+    unsigned int done = 0;
+    while (done < nFrames)
+    {
+        if (m_hopPosition == HOP)
+        {
+            for (unsigned int v = 0; v < MAX_VOICES; v++)
+            {
+                if (!((m_soundingMask >> v) & 1))
+                    continue;
+                Output& out = m_output[v];
+                if ((m_finishingMask >> v) & 1)
+                {
+                    // The last tail has played out; leave the buffers silent for the next note
+                    std::fill(std::begin(out.hop), std::end(out.hop), 0.0f);
+                    std::fill(std::begin(out.tail), std::end(out.tail), 0.0f);
+                    m_soundingMask &= ~(1u << v);
+                    m_finishingMask &= ~(1u << v);
+                    continue;
+                }
+                if (m_partials[v].stale)
+                    Tune(v, patch, sampleRate);
+                if (!AdvanceEnvelope(v, patch, sampleRate))
+                    m_finishingMask |= 1u << v;
+
+                float scale = m_envelope[v] * gain;
+                if (scale > 0.0f && m_partials[v].count > 0)
+                {
+                    SynthesiseFrame(v, patch, scale);
+                    const float* pMiddle = m_frame + FRAME_SIZE / 4;
+                    for (unsigned int t = 0; t < HOP; t++)
+                    {
+                        out.hop[t] = out.tail[t] + pMiddle[t] * m_synthesis[t];
+                        out.tail[t] = pMiddle[HOP + t] * m_synthesis[HOP + t];
+                    }
+                }
+                else
+                {
+                    std::copy(std::begin(out.tail), std::end(out.tail), out.hop);
+                    std::fill(std::begin(out.tail), std::end(out.tail), 0.0f);
+                }
+            }
+            m_hopPosition = 0;
+        }
+
+        const unsigned int length = std::min(HOP - m_hopPosition, nFrames - done);
+        for (unsigned int v = 0; v < MAX_VOICES; v++)
+        {
+            if (!((written >> v) & 1))
+                continue;
+            const float* pHop = m_output[v].hop + m_hopPosition;
+            for (unsigned int n = 0; n < length; n++)
+                pVoices[(size_t)(done + n) * MAX_VOICES + v] = pHop[n];
+        }
+        m_hopPosition += length;
+        done += length;
+    }
+    return written;
+}
@@ -0,0 +1,127 @@
+#include "SvfBank.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr double SVF_PI = 3.14159265358979323846;
+constexpr float MAX_RESONANCE = 0.98f;
+} // namespace
+
+void SvfBank::UpdateVoice(unsigned int voice, Mode mode, float cutoffHz, float resonance,
+                          double sampleRate)
+{
+    // Keep the cutoff clear of Nyquist, where tan() blows up
+    double cutoff = std::clamp((double)cutoffHz, 10.0, sampleRate * 0.49);
+    double g = tan(SVF_PI * cutoff / sampleRate);
+    double k = 2.0 - 2.0 * std::clamp(resonance, 0.0f, MAX_RESONANCE);
+    double a1 = 1.0 / (1.0 + g * (g + k));
+    double a2 = g * a1;
+
+    m_a1[voice] = (float)a1;
+    m_a2[voice] = (float)a2;
+    m_a3[voice] = (float)(g * a2);
+    m_k[voice] = (float)k;
+    m_lowGain[voice] = mode == Mode::Lowpass ? 1.0f : 0.0f;
+    m_bandGain[voice] = mode == Mode::Bandpass ? 1.0f : 0.0f;
+    m_highGain[voice] = mode == Mode::Highpass ? 1.0f : 0.0f;
+}
+
+void SvfBank::ResetVoice(unsigned int voice)
+{
+    m_ic1[voice] = 0.0f;
+    m_ic2[voice] = 0.0f;
+}
+
+void SvfBank::ProcessGroupScalar(float* pVoices, unsigned int nFrames, unsigned int first,
+                                 unsigned int count)
+{
+    for (unsigned int v = first; v < first + count; v++)
+    {
+        float ic1 = m_ic1[v];
+        float ic2 = m_ic2[v];
+        for (unsigned int n = 0; n < nFrames; n++)
+        {
+            float& sample = pVoices[n * MAX_VOICES + v];
+            float v3 = sample - ic2;
+            float v1 = m_a1[v] * ic1 + m_a2[v] * v3;
+            float v2 = ic2 + m_a2[v] * ic1 + m_a3[v] * v3;
+            ic1 = 2.0f * v1 - ic1;
+            ic2 = 2.0f * v2 - ic2;
+            float high = sample - m_k[v] * v1 - v2;
+            sample = m_lowGain[v] * v2 + m_bandGain[v] * v1 + m_highGain[v] * high;
+        }
+        m_ic1[v] = ic1;
+        m_ic2[v] = ic2;
+    }
+}
+
+void SvfBank::Process(float* pVoices, unsigned int nFrames, unsigned int voiceMask)
+{
+    const unsigned int groupMask = (1u << LANE_WIDTH) - 1;
+    for (unsigned int group = 0; group < GROUP_COUNT; group++)
+    {
+        unsigned int first = group * LANE_WIDTH;
+        if (((voiceMask >> first) & groupMask) == 0)
+            continue;
+
+#if SYNTH_HAS_AVX
+        __m256 vIc1 = _mm256_load_ps(m_ic1 + first);
+        __m256 vIc2 = _mm256_load_ps(m_ic2 + first);
+        const __m256 vA1 = _mm256_load_ps(m_a1 + first);
+        const __m256 vA2 = _mm256_load_ps(m_a2 + first);
+        const __m256 vA3 = _mm256_load_ps(m_a3 + first);
+        const __m256 vK = _mm256_load_ps(m_k + first);
+        const __m256 vLow = _mm256_load_ps(m_lowGain + first);
+        const __m256 vBand = _mm256_load_ps(m_bandGain + first);
+        const __m256 vHigh = _mm256_load_ps(m_highGain + first);
+        for (unsigned int n = 0; n < nFrames; n++)
+        {
+            float* pFrame = pVoices + n * MAX_VOICES + first;
+            __m256 vIn = _mm256_loadu_ps(pFrame);
+            __m256 v3 = _mm256_sub_ps(vIn, vIc2);
+            __m256 v1 = _mm256_add_ps(_mm256_mul_ps(vA1, vIc1), _mm256_mul_ps(vA2, v3));
+            __m256 v2 = _mm256_add_ps(
+                vIc2, _mm256_add_ps(_mm256_mul_ps(vA2, vIc1), _mm256_mul_ps(vA3, v3)));
+            vIc1 = _mm256_sub_ps(_mm256_add_ps(v1, v1), vIc1);
+            vIc2 = _mm256_sub_ps(_mm256_add_ps(v2, v2), vIc2);
+            __m256 vHp = _mm256_sub_ps(_mm256_sub_ps(vIn, _mm256_mul_ps(vK, v1)), v2);
+            __m256 vOut = _mm256_add_ps(_mm256_mul_ps(vLow, v2),
+                                        _mm256_add_ps(_mm256_mul_ps(vBand, v1),
+                                                      _mm256_mul_ps(vHigh, vHp)));
+            _mm256_storeu_ps(pFrame, vOut);
+        }
+        _mm256_store_ps(m_ic1 + first, vIc1);
+        _mm256_store_ps(m_ic2 + first, vIc2);
+#elif SYNTH_HAS_SSE2
+        __m128 vIc1 = _mm_load_ps(m_ic1 + first);
+        __m128 vIc2 = _mm_load_ps(m_ic2 + first);
+        const __m128 vA1 = _mm_load_ps(m_a1 + first);
+        const __m128 vA2 = _mm_load_ps(m_a2 + first);
+        const __m128 vA3 = _mm_load_ps(m_a3 + first);
+        const __m128 vK = _mm_load_ps(m_k + first);
+        const __m128 vLow = _mm_load_ps(m_lowGain + first);
+        const __m128 vBand = _mm_load_ps(m_bandGain + first);
+        const __m128 vHigh = _mm_load_ps(m_highGain + first);
+        for (unsigned int n = 0; n < nFrames; n++)
+        {
+            float* pFrame = pVoices + n * MAX_VOICES + first;
+            __m128 vIn = _mm_loadu_ps(pFrame);
+            __m128 v3 = _mm_sub_ps(vIn, vIc2);
+            __m128 v1 = _mm_add_ps(_mm_mul_ps(vA1, vIc1), _mm_mul_ps(vA2, v3));
+            __m128 v2 = _mm_add_ps(vIc2, _mm_add_ps(_mm_mul_ps(vA2, vIc1), _mm_mul_ps(vA3, v3)));
+            vIc1 = _mm_sub_ps(_mm_add_ps(v1, v1), vIc1);
+            vIc2 = _mm_sub_ps(_mm_add_ps(v2, v2), vIc2);
+            __m128 vHp = _mm_sub_ps(_mm_sub_ps(vIn, _mm_mul_ps(vK, v1)), v2);
+            __m128 vOut = _mm_add_ps(_mm_mul_ps(vLow, v2),
+                                     _mm_add_ps(_mm_mul_ps(vBand, v1), _mm_mul_ps(vHigh, vHp)));
+            _mm_storeu_ps(pFrame, vOut);
+        }
+        _mm_store_ps(m_ic1 + first, vIc1);
+        _mm_store_ps(m_ic2 + first, vIc2);
+#else
+        ProcessGroupScalar(pVoices, nFrames, first, LANE_WIDTH);
+#endif
+    }
+}
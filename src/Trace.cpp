@@ -0,0 +1,118 @@
+#include "Trace.h"
+
+#if SYNTH_TRACE
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+// Buffers are never freed, so a thread's events can still be exported after it exits
+std::atomic<TraceBuffer*> s_buffers[TraceBuffer::MAX_THREADS];
+std::atomic<unsigned int> s_bufferCount{0};
+} // namespace
+
+TraceBuffer* TraceBuffer::Register()
+{
+    TraceBuffer* buffer = new TraceBuffer();
+    unsigned int slot = s_bufferCount.fetch_add(1, std::memory_order_relaxed);
+    if (slot < MAX_THREADS)
+        s_buffers[slot].store(buffer, std::memory_order_release);
+    return buffer;
+}
+
+size_t TraceBuffer::CopyEvents(TraceEvent* pOut) const
+{
+    const uint64_t end = m_written.load(std::memory_order_acquire);
+    const uint64_t begin = end > CAPACITY ? end - CAPACITY : 0;
+    for (uint64_t i = begin; i < end; i++)
+        pOut[i - begin] = m_events[i & (CAPACITY - 1)];
+
+    // The owner may have lapped the oldest events, and be writing one more, during the copy
+    std::atomic_thread_fence(std::memory_order_acquire);
+    const uint64_t written = m_written.load(std::memory_order_relaxed);
+    const uint64_t firstIntact = written + 1 > CAPACITY ? written + 1 - CAPACITY : 0;
+    const size_t skip = (size_t)std::min(firstIntact > begin ? firstIntact - begin : 0,
+                                         end - begin);
+    std::copy(pOut + skip, pOut + (end - begin), pOut);
+    return (size_t)(end - begin) - skip;
+}
+
+bool TraceBuffer::WriteChromeJson(const std::filesystem::path& path, std::string* error)
+{
+    struct ThreadEvents
+    {
+        const char* name;
+        std::vector<TraceEvent> events;
+    };
+    const unsigned int threads =
+        std::min(s_bufferCount.load(std::memory_order_acquire), MAX_THREADS);
+    std::vector<ThreadEvents> copies;
+    int64_t originNs = INT64_MAX;
+    for (unsigned int t = 0; t < threads; t++)
+    {
+        const TraceBuffer* buffer = s_buffers[t].load(std::memory_order_acquire);
+        if (!buffer) // Registered but not yet published
+            continue;
+        ThreadEvents copy{buffer->m_name.load(std::memory_order_acquire),
+                          std::vector<TraceEvent>(CAPACITY)};
+        copy.events.resize(buffer->CopyEvents(copy.events.data()));
+        if (!copy.events.empty())
+            originNs = std::min(originNs, copy.events.front().beginNs);
+        copies.push_back(std::move(copy));
+    }
+
+    std::ofstream file(path, std::ios::trunc);
+    if (!file)
+    {
+        if (error)
+            *error = "could not create " + path.string();
+        return false;
+    }
+    // Times in microseconds from the oldest event, which the viewers expect
+    char line[256];
+    bool first = true;
+    file << "{\"traceEvents\":[\n";
+    for (size_t t = 0; t < copies.size(); t++)
+    {
+        const ThreadEvents& copy = copies[t];
+        if (copy.name)
+        {
+            snprintf(line, sizeof(line),
+                     "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,"
+                     "\"args\":{\"name\":\"%s\"}}",
+                     first ? "" : ",\n", t + 1, copy.name);
+            file << line;
+            first = false;
+        }
+        for (const TraceEvent& event : copy.events)
+        {
+            double ts = (event.beginNs - originNs) * 1e-3;
+            if (event.durationNs < 0)
+                snprintf(line, sizeof(line),
+                         "%s{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%zu,"
+                         "\"ts\":%.3f}",
+                         first ? "" : ",\n", event.name, t + 1, ts);
+            else
+                snprintf(line, sizeof(line),
+                         "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%zu,\"ts\":%.3f,"
+                         "\"dur\":%.3f}",
+                         first ? "" : ",\n", event.name, t + 1, ts, event.durationNs * 1e-3);
+            file << line;
+            first = false;
+        }
+    }
+    file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    file.close();
+    if (file.fail())
+    {
+        if (error)
+            *error = "could not write " + path.string();
+        return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,181 @@
+#include "WavFile.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+
+namespace
+{
+constexpr uint16_t FORMAT_PCM = 1;
+constexpr uint16_t FORMAT_FLOAT = 3;
+constexpr uint16_t FORMAT_EXTENSIBLE = 0xFFFE;
+
+uint32_t ReadU32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+uint16_t ReadU16(const unsigned char* p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+void WriteU32(std::ostream& out, uint32_t value)
+{
+    unsigned char bytes[4] = {(unsigned char)value, (unsigned char)(value >> 8),
+                              (unsigned char)(value >> 16), (unsigned char)(value >> 24)};
+    out.write((const char*)bytes, sizeof(bytes));
+}
+
+void WriteU16(std::ostream& out, uint16_t value)
+{
+    unsigned char bytes[2] = {(unsigned char)value, (unsigned char)(value >> 8)};
+    out.write((const char*)bytes, sizeof(bytes));
+}
+
+float DecodeSample(const unsigned char* p, uint16_t format, uint16_t bits)
+{
+    if (format == FORMAT_FLOAT)
+    {
+        float value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+    switch (bits)
+    {
+    case 16:
+        return (float)(int16_t)ReadU16(p) / 32768.0f;
+    case 24:
+    {
+        int32_t value = (int32_t)(((uint32_t)p[0] << 8) | ((uint32_t)p[1] << 16) |
+                                  ((uint32_t)p[2] << 24)) >> 8;
+        return (float)value / 8388608.0f;
+    }
+    case 32:
+        return (float)((double)(int32_t)ReadU32(p) / 2147483648.0);
+    }
+    return 0.0f;
+}
+} // namespace
+
+bool LoadWav(const std::filesystem::path& path, WavData& out)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    unsigned char riff[12];
+    if (!file.read((char*)riff, sizeof(riff)) || std::memcmp(riff, "RIFF", 4) != 0 ||
+        std::memcmp(riff + 8, "WAVE", 4) != 0)
+        return false;
+
+    uint16_t format = 0;
+    uint16_t channels = 0;
+    uint16_t bits = 0;
+    uint32_t sampleRate = 0;
+    bool haveFormat = false;
+
+    unsigned char header[8];
+    while (file.read((char*)header, sizeof(header)))
+    {
+        uint32_t size = ReadU32(header + 4);
+        if (std::memcmp(header, "fmt ", 4) == 0)
+        {
+            std::vector<unsigned char> fmt(size);
+            if (size < 16 || !file.read((char*)fmt.data(), size))
+                return false;
+            format = ReadU16(fmt.data());
+            channels = ReadU16(fmt.data() + 2);
+            sampleRate = ReadU32(fmt.data() + 4);
+            bits = ReadU16(fmt.data() + 14);
+            // The sub-format GUID starts with the plain format tag
+            if (format == FORMAT_EXTENSIBLE && size >= 26)
+                format = ReadU16(fmt.data() + 24);
+            haveFormat = true;
+        }
+        else if (std::memcmp(header, "data", 4) == 0)
+        {
+            if (!haveFormat || channels == 0 || (format != FORMAT_PCM && format != FORMAT_FLOAT))
+                return false;
+            if (format == FORMAT_FLOAT && bits != 32)
+                return false;
+            if (format == FORMAT_PCM && bits != 16 && bits != 24 && bits != 32)
+                return false;
+
+            std::vector<unsigned char> data(size);
+            file.read((char*)data.data(), size);
+            size_t bytesPerSample = bits / 8;
+            size_t frames = (size_t)file.gcount() / (bytesPerSample * channels);
+
+            out.sampleRate = sampleRate;
+            out.channels.assign(channels, std::vector<float>(frames));
+            const unsigned char* p = data.data();
+            for (size_t n = 0; n < frames; n++)
+                for (uint16_t c = 0; c < channels; c++, p += bytesPerSample)
+                    out.channels[c][n] = DecodeSample(p, format, bits);
+            return true;
+        }
+        else
+        {
+            // Chunks are padded to an even size
+            file.seekg(size + (size & 1), std::ios::cur);
+        }
+
+        if (std::memcmp(header, "fmt ", 4) == 0 && (size & 1))
+            file.seekg(1, std::ios::cur);
+    }
+    return false;
+}
+
+bool SaveWav(const std::filesystem::path& path, const WavData& data)
+{
+    if (data.channels.empty())
+        return false;
+    std::ofstream file(path, std::ios::binary);
+    if (!file)
+        return false;
+
+    const uint16_t channels = (uint16_t)data.channels.size();
+    const size_t frames = data.GetFrameCount();
+    WriteWavHeader(file, data.sampleRate, channels, 32, true,
+                   (uint32_t)(frames * channels * sizeof(float)));
+
+    // Little-endian hosts only, like the rest of the engine
+    std::vector<float> frame(channels);
+    for (size_t n = 0; n < frames; n++)
+    {
+        for (uint16_t c = 0; c < channels; c++)
+            frame[c] = data.channels[c][n];
+        file.write((const char*)frame.data(), channels * sizeof(float));
+    }
+    return (bool)file;
+}
+
+void WriteWavHeader(std::ostream& out, unsigned int sampleRate, unsigned int channels,
+                    unsigned int bitsPerSample, bool isFloat, uint32_t dataBytes)
+{
+    const uint32_t blockAlign = channels * (bitsPerSample / 8);
+    out.write("RIFF", 4);
+    WriteU32(out, 36 + dataBytes);
+    out.write("WAVEfmt ", 8);
+    WriteU32(out, 16);
+    WriteU16(out, isFloat ? FORMAT_FLOAT : FORMAT_PCM);
+    WriteU16(out, (uint16_t)channels);
+    WriteU32(out, sampleRate);
+    WriteU32(out, sampleRate * blockAlign);
+    WriteU16(out, (uint16_t)blockAlign);
+    WriteU16(out, (uint16_t)bitsPerSample);
+    out.write("data", 4);
+    WriteU32(out, dataBytes);
+}
+
+bool UpdateWavSizes(std::ostream& out, uint32_t dataBytes)
+{
+    std::streampos end = out.tellp();
+    out.seekp(4);
+    WriteU32(out, 36 + dataBytes);
+    out.seekp(40);
+    WriteU32(out, dataBytes);
+    out.seekp(end);
+    return (bool)out;
+}
@@ -0,0 +1,156 @@
+#include "WavRecorder.h"
+
+#include "WavFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// The RIFF size field is 32 bits; a recording stops growing here and later blocks count as
+// dropped
+constexpr uint64_t MAX_DATA_BYTES = 0xFFFFFFFFull - 36;
+} // namespace
+
+WavRecorder::~WavRecorder()
+{
+    Stop();
+}
+
+bool WavRecorder::Start(const std::filesystem::path& path, unsigned int sampleRate,
+                        unsigned int channels, std::string* error)
+{
+    if (m_thread.joinable())
+    {
+        if (error)
+            *error = "already recording";
+        return false;
+    }
+    m_file.clear();
+    m_file.open(path, std::ios::binary | std::ios::trunc);
+    if (!m_file)
+    {
+        if (error)
+            *error = "could not create " + path.string();
+        return false;
+    }
+    WriteWavHeader(m_file, sampleRate, channels, 32, false, 0);
+
+    // Allocated and zeroed here, so the render thread never touches a fresh page
+    if (!m_ring)
+        m_ring = std::make_unique<int32_t[]>(RING_SAMPLES);
+    m_path = path;
+    m_sampleRate = sampleRate;
+    m_channels = channels;
+    m_dataBytes = 0;
+    m_writeFailed = false;
+    m_head.store(m_tail.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_recordedFrames.store(0, std::memory_order_relaxed);
+    m_droppedBlocks.store(0, std::memory_order_relaxed);
+    m_stopping.store(false, std::memory_order_relaxed);
+    m_thread = std::thread(&WavRecorder::WriterLoop, this);
+    m_recording.store(true);
+    return true;
+}
+
+bool WavRecorder::Stop(std::string* error)
+{
+    if (!m_thread.joinable())
+        return true;
+
+    // Once no Write is in flight, none will touch the ring again until the next Start
+    m_recording.store(false);
+    while (m_activeWrites.load() != 0)
+        std::this_thread::yield();
+    m_stopping.store(true, std::memory_order_release);
+    m_wake.fetch_add(1, std::memory_order_release);
+    m_wake.notify_one();
+    m_thread.join();
+
+    bool ok = !m_writeFailed && UpdateWavSizes(m_file, (uint32_t)m_dataBytes);
+    m_file.close();
+    ok = ok && !m_file.fail();
+    if (!ok && error)
+        *error = "could not write " + m_path.string();
+    return ok;
+}
+
+void WavRecorder::Write(const int32_t* pFrames, unsigned int nChannels, unsigned int nFrames)
+{
+    // Stop waits for calls already in here, so the ring outlives them
+    m_activeWrites.fetch_add(1);
+    if (m_recording.load() && nChannels == m_channels)
+    {
+        const size_t count = (size_t)nFrames * nChannels;
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t buffered = tail - m_head.load(std::memory_order_acquire);
+        const uint64_t frames = m_recordedFrames.load(std::memory_order_relaxed) + nFrames;
+        if (buffered + count > RING_SAMPLES ||
+            frames * nChannels * sizeof(int32_t) > MAX_DATA_BYTES)
+        {
+            m_droppedBlocks.fetch_add(1, std::memory_order_relaxed);
+        }
+        else
+        {
+            size_t index = tail & (RING_SAMPLES - 1);
+            size_t run = std::min(count, RING_SAMPLES - index);
+            memcpy(m_ring.get() + index, pFrames, run * sizeof(int32_t));
+            memcpy(m_ring.get(), pFrames + run, (count - run) * sizeof(int32_t));
+            m_tail.store(tail + count, std::memory_order_release);
+            m_recordedFrames.store(frames, std::memory_order_relaxed);
+
+            // Wake the writer only when a full write's worth becomes ready
+            if (buffered < WRITE_SAMPLES && buffered + count >= WRITE_SAMPLES)
+            {
+                m_wake.fetch_add(1, std::memory_order_release);
+                m_wake.notify_one();
+            }
+        }
+    }
+    m_activeWrites.fetch_sub(1);
+}
+
+double WavRecorder::GetRecordedSeconds() const
+{
+    if (m_sampleRate == 0)
+        return 0.0;
+    return (double)m_recordedFrames.load(std::memory_order_relaxed) / m_sampleRate;
+}
+
+void WavRecorder::WriterLoop()
+{
+    for (;;)
+    {
+        uint32_t wake = m_wake.load(std::memory_order_acquire);
+        // Read before the tail: once stopping, the tail seen after it is final
+        bool stopping = m_stopping.load(std::memory_order_acquire);
+        size_t available =
+            m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_relaxed);
+        if (available >= WRITE_SAMPLES || (stopping && available > 0))
+        {
+            WriteRun(std::min(available, WRITE_SAMPLES));
+            continue;
+        }
+        if (stopping)
+            return;
+        m_wake.wait(wake, std::memory_order_acquire);
+    }
+}
+
+void WavRecorder::WriteRun(size_t count)
+{
+    const size_t head = m_head.load(std::memory_order_relaxed);
+    const size_t index = head & (RING_SAMPLES - 1);
+    count = std::min(count, RING_SAMPLES - index);
+    if (!m_writeFailed)
+    {
+        // Little-endian hosts only, like the rest of the engine
+        m_file.write((const char*)(m_ring.get() + index),
+                     (std::streamsize)(count * sizeof(int32_t)));
+        m_writeFailed = !m_file;
+        m_dataBytes += count * sizeof(int32_t);
+    }
+    // A failed disk still drains the ring, so the render thread doesn't count every block as
+    // dropped
+    m_head.store(head + count, std::memory_order_release);
+}
@@ -0,0 +1,122 @@
+// Times the additive voice bank in partial-samples per second: every partial of every held
+// voice for every sample, counted after Nyquist culling. Sixteen sawtooth voices are held a
+// semitone apart from a low A, so the top voices lose partials to culling as the count grows.
+// For comparison the same partials are also rendered the direct way, one sinf per partial per
+// sample.
+//
+//   additive_bench [seconds]   (default 3, of audio per measurement)
+
+#include "AdditiveBank.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+constexpr double BENCH_TWO_PI = 6.28318530717958647692;
+constexpr double SAMPLE_RATE = 44100.0;
+constexpr unsigned int BLOCK_FRAMES = 512;
+constexpr unsigned int VOICES = AdditiveBank::MAX_VOICES;
+constexpr double LOWEST_NOTE = 27.5;
+constexpr unsigned int PARTIAL_COUNTS[] = {16, 64, 128, 256, 512};
+
+double NoteFrequency(unsigned int voice)
+{
+    return LOWEST_NOTE * pow(2.0, voice / 12.0);
+}
+
+// Wall time to render `frames` of every voice; `partials` is the total rendered per sample
+double TimeBank(const AdditivePatch& patch, size_t frames, unsigned int& partials, float& peak)
+{
+    AdditiveBank bank;
+    for (unsigned int v = 0; v < VOICES; v++)
+        bank.NoteOn(v, NoteFrequency(v));
+    std::vector<float> buffer((size_t)BLOCK_FRAMES * VOICES);
+
+    peak = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < frames; done += BLOCK_FRAMES)
+    {
+        bank.Render(patch, buffer.data(), BLOCK_FRAMES, SAMPLE_RATE, 0.5f);
+        // Reading the output keeps the render from being optimised away
+        for (unsigned int n = 0; n < BLOCK_FRAMES; n += 64)
+            peak = std::max(peak, fabsf(buffer[(size_t)n * VOICES]));
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    partials = 0;
+    for (unsigned int v = 0; v < VOICES; v++)
+        partials += bank.GetPartialCount(v);
+    return elapsed.count();
+}
+
+// The same audible partials with a phase accumulator and sinf each
+double TimeDirect(const AdditivePatch& patch, size_t frames, float& peak)
+{
+    std::vector<double> increments;
+    std::vector<float> amplitudes;
+    for (unsigned int v = 0; v < VOICES; v++)
+    {
+        for (unsigned int k = 0; k < patch.partialCount; k++)
+        {
+            double freq = NoteFrequency(v) * patch.ratios[k];
+            if (freq < 0.5 * SAMPLE_RATE)
+            {
+                increments.push_back(freq / SAMPLE_RATE);
+                amplitudes.push_back(patch.amplitudes[k] * 0.5f);
+            }
+        }
+    }
+    std::vector<double> phases(increments.size(), 0.0);
+
+    peak = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t n = 0; n < frames; n++)
+    {
+        float sum = 0.0f;
+        for (size_t i = 0; i < phases.size(); i++)
+        {
+            sum += amplitudes[i] * sinf((float)(BENCH_TWO_PI * phases[i]));
+            phases[i] += increments[i];
+            phases[i] -= floor(phases[i]);
+        }
+        peak = std::max(peak, fabsf(sum));
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+    if (seconds <= 0.0)
+    {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 2;
+    }
+    const size_t frames = (size_t)(seconds * SAMPLE_RATE);
+    // The direct render is far slower, so it gets a tenth of the audio
+    const size_t directFrames = frames / 10;
+
+    printf("%u voices from %.1f Hz, %.1f s per measurement\n", VOICES, LOWEST_NOTE, seconds);
+    printf("%9s %9s %16s %16s %8s\n", "partials", "rendered", "bank M/s", "direct M/s",
+           "speedup");
+    for (unsigned int count : PARTIAL_COUNTS)
+    {
+        AdditivePatch patch = MakeAdditivePreset(0, count);
+        unsigned int rendered = 0;
+        float bankPeak;
+        float directPeak;
+        double bankSeconds = TimeBank(patch, frames, rendered, bankPeak);
+        double directSeconds = TimeDirect(patch, directFrames, directPeak);
+        double bankRate = (double)rendered * frames / bankSeconds;
+        double directRate = (double)rendered * directFrames / directSeconds;
+        printf("%9u %9u %16.1f %16.1f %7.1fx%s\n", count * VOICES, rendered, bankRate * 1e-6,
+               directRate * 1e-6, bankRate / directRate,
+               bankPeak > 0.0f && directPeak > 0.0f ? "" : "  (silent!)");
+    }
+    return 0;
+}
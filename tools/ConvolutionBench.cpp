@@ -0,0 +1,127 @@
+// Times the convolution reverb's two halves for impulse responses 0.5 to 8 s long at 44.1 and
+// 96 kHz, with the partition sizes ConvolutionReverb picks for 512-frame blocks: the head,
+// convolved on the render thread once per block, and the tail, convolved by the background
+// thread once per tail partition. The worst block is the slowest head call, which is all the
+// render thread ever waits for; "unsplit" adds the slowest tail partition to it, the spike a
+// block would take if the tail ran inline.
+//
+//   convolution_bench [seconds]   (default 5, of audio per measurement)
+
+#include "ConvolutionReverb.h"
+#include "Denormals.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+constexpr unsigned int BLOCK_SAMPLES = 512;
+constexpr unsigned int CHANNELS = 2;
+constexpr double SAMPLE_RATES[] = {44100.0, 96000.0};
+constexpr double IR_SECONDS[] = {0.5, 1.0, 2.0, 4.0, 8.0};
+constexpr double IR_DECAY_SECONDS = 2.0; // To fall 60 dB
+
+struct Timing
+{
+    double averageUs = 0.0;
+    double worstUs = 0.0;
+};
+
+// Decaying white noise, a different sequence per channel
+std::vector<std::vector<float>> MakeIr(size_t length, double sampleRate)
+{
+    std::vector<std::vector<float>> ir(CHANNELS, std::vector<float>(length));
+    uint32_t state = 22222;
+    const double decay = log(0.001) / (IR_DECAY_SECONDS * sampleRate);
+    for (std::vector<float>& channel : ir)
+    {
+        for (size_t n = 0; n < length; n++)
+        {
+            state = state * 1664525u + 1013904223u;
+            float noise = (float)(state >> 8) / (float)(1u << 24) * 2.0f - 1.0f;
+            channel[n] = noise * (float)exp(decay * n);
+        }
+    }
+    return ir;
+}
+
+// Runs `calls` partitions of noise through a convolver over ppIr[c] + offset
+Timing TimeConvolver(const std::vector<std::vector<float>>& ir, size_t offset, size_t length,
+                     unsigned int partition, size_t calls)
+{
+    PartitionedConvolver convolver;
+    const float* ppIr[CHANNELS] = {ir[0].data() + offset, ir[1].data() + offset};
+    convolver.Prepare(ppIr, CHANNELS, length, partition);
+
+    std::vector<float> input(partition);
+    std::vector<std::vector<float>> output(CHANNELS, std::vector<float>(partition));
+    float* ppOut[CHANNELS] = {output[0].data(), output[1].data()};
+    uint32_t state = 1;
+    Timing timing;
+    double totalUs = 0.0;
+    for (size_t call = 0; call < calls; call++)
+    {
+        for (float& s : input)
+        {
+            state = state * 1664525u + 1013904223u;
+            s = (float)(state >> 8) / (float)(1u << 24) - 0.5f;
+        }
+        auto start = std::chrono::steady_clock::now();
+        convolver.Process(input.data(), ppOut);
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        totalUs += elapsed.count();
+        timing.worstUs = std::max(timing.worstUs, elapsed.count());
+    }
+    timing.averageUs = totalUs / std::max<size_t>(calls, 1);
+    return timing;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    if (seconds <= 0.0)
+    {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 2;
+    }
+    ScopedFlushDenormals flushDenormals;
+
+    const unsigned int tailPartition = BLOCK_SAMPLES * ConvolutionReverb::TAIL_FACTOR;
+    const unsigned int headLimit = tailPartition * 2;
+    printf("%u-frame blocks, tail partitions of %u frames, %.1f s per measurement\n",
+           BLOCK_SAMPLES, tailPartition, seconds);
+    printf("%-8s %6s %10s %10s %10s %10s %10s %10s\n", "rate", "IR s", "head us", "worst us",
+           "budget %", "tail us", "tail %", "unsplit us");
+    for (double sampleRate : SAMPLE_RATES)
+    {
+        const double blockUs = 1e6 * BLOCK_SAMPLES / sampleRate;
+        const double partitionUs = 1e6 * tailPartition / sampleRate;
+        for (double irSeconds : IR_SECONDS)
+        {
+            const size_t length = (size_t)(irSeconds * sampleRate);
+            const std::vector<std::vector<float>> ir = MakeIr(length, sampleRate);
+            const size_t headLength = std::min(length, (size_t)headLimit);
+            const size_t blocks = (size_t)(seconds * sampleRate / BLOCK_SAMPLES);
+
+            Timing head = TimeConvolver(ir, 0, headLength, BLOCK_SAMPLES, blocks);
+            Timing tail;
+            if (length > headLength)
+            {
+                tail = TimeConvolver(ir, headLength, length - headLength, tailPartition,
+                                     std::max<size_t>(blocks / ConvolutionReverb::TAIL_FACTOR, 1));
+            }
+            printf("%-8.1f %6.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                   sampleRate / 1000.0, irSeconds, head.averageUs, head.worstUs,
+                   100.0 * head.worstUs / blockUs, tail.averageUs,
+                   100.0 * tail.averageUs / partitionUs, head.worstUs + tail.worstUs);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+// Times the FM voice bank in operator-samples per second: every operator of every held voice
+// for every sample. Each algorithm runs with the electric piano's operators and full sustain,
+// at 4, 8 and 16 voices, in 512-frame blocks as the engine renders them. Also prints how many
+// voices one core could keep up at 44.1 kHz.
+//
+//   fm_bench [seconds]   (default 5, of audio per measurement)
+
+#include "FmBank.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+constexpr double SAMPLE_RATE = 44100.0;
+constexpr unsigned int BLOCK_FRAMES = 512;
+constexpr unsigned int VOICE_COUNTS[] = {4, 8, 16};
+
+// Seconds of wall time to render `frames` of `voices` held notes
+double TimeRender(const FmPatch& patch, unsigned int voices, size_t frames, float& peak)
+{
+    FmBank bank;
+    for (unsigned int v = 0; v < voices; v++)
+        bank.NoteOn(v, 110.0 * pow(2.0, v / 12.0));
+    std::vector<float> buffer((size_t)BLOCK_FRAMES * FmBank::MAX_VOICES);
+
+    peak = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < frames; done += BLOCK_FRAMES)
+    {
+        bank.Render(patch, buffer.data(), BLOCK_FRAMES, SAMPLE_RATE, 0.5f);
+        // Reading the output keeps the render from being optimised away
+        for (unsigned int n = 0; n < BLOCK_FRAMES; n += 64)
+            peak = std::max(peak, fabsf(buffer[(size_t)n * FmBank::MAX_VOICES]));
+    }
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    if (seconds <= 0.0)
+    {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 2;
+    }
+    const size_t frames = (size_t)(seconds * SAMPLE_RATE);
+
+    printf("%u operators, %u-lane SIMD, %.1f s per measurement\n", FM_OPERATORS,
+           FmBank::LANE_WIDTH, seconds);
+    printf("%-18s %6s %14s %14s\n", "algorithm", "voices", "Mop-samples/s", "voices/core");
+    for (unsigned int a = 0; a < FM_ALGORITHMS; a++)
+    {
+        FmPatch patch = MakeFmPreset(0);
+        patch.algorithm = a;
+        for (FmOperator& op : patch.operators)
+            op.sustain = 1.0f; // Held notes stay at full cost
+        for (unsigned int voices : VOICE_COUNTS)
+        {
+            float peak;
+            double elapsed = TimeRender(patch, voices, frames, peak);
+            double operatorSamples = (double)frames * voices * FM_OPERATORS;
+            double rate = operatorSamples / elapsed;
+            printf("%-18s %6u %14.1f %14.0f%s\n", FM_ALGORITHM_NAMES[a], voices, rate * 1e-6,
+                   rate / (FM_OPERATORS * SAMPLE_RATE), peak > 0.0f ? "" : "  (silent!)");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,89 @@
+// Prints the running synth's engine counters once per interval, read from the shared-memory
+// metrics segment: no GUI, no calls into the engine, nothing added to its audio thread. The
+// segment is opened for each read and closed again, so a synth that restarts can recreate it.
+//
+//   metrics_monitor [--interval MS] [--count N]   (default 1000 ms, until interrupted)
+
+#include "MetricsSegment.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+namespace
+{
+constexpr int READ_ATTEMPTS = 100;
+
+// A consistent copy, retrying while the render thread is mid-update
+bool ReadMetrics(EngineMetrics& metrics)
+{
+    MetricsSegment segment;
+    if (!segment.Open())
+        return false;
+    for (int attempt = 0; attempt < READ_ATTEMPTS; attempt++)
+    {
+        if (segment.Read(metrics))
+            return true;
+        std::this_thread::yield();
+    }
+    return false;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    int intervalMs = 1000;
+    long count = -1;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--interval") == 0 && i + 1 < argc)
+            intervalMs = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--count") == 0 && i + 1 < argc)
+            count = atol(argv[++i]);
+        else
+        {
+            fprintf(stderr, "usage: %s [--interval MS] [--count N]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (intervalMs <= 0)
+        intervalMs = 1000;
+
+    printf("%9s %8s %8s %8s %7s %9s %6s %5s %7s\n", "blocks/s", "block ms", "avg ms", "peak ms",
+           "load %", "underruns", "voices", "queue", "dropped");
+    const auto interval = std::chrono::milliseconds(intervalMs);
+    auto deadline = std::chrono::steady_clock::now();
+    EngineMetrics previous = {};
+    bool havePrevious = false;
+    for (long line = 0; count < 0 || line < count; line++)
+    {
+        EngineMetrics metrics;
+        if (!ReadMetrics(metrics))
+        {
+            printf("synth not running\n");
+            havePrevious = false;
+        }
+        else if (havePrevious && metrics.blocks == previous.blocks)
+        {
+            printf("stalled at block %llu\n", (unsigned long long)metrics.blocks);
+        }
+        else
+        {
+            double blocksPerSecond =
+                havePrevious ? (metrics.blocks - previous.blocks) * 1000.0 / intervalMs : 0.0;
+            printf("%9.1f %8.3f %8.3f %8.3f %7.1f %9llu %6u %5u %7u\n", blocksPerSecond,
+                   metrics.blockMs, metrics.averageBlockMs, metrics.peakBlockMs,
+                   metrics.dspLoad * 100.0, (unsigned long long)metrics.underruns,
+                   metrics.activeVoices, metrics.keyQueueDepth, metrics.droppedKeyEvents);
+            previous = metrics;
+            havePrevious = true;
+        }
+        fflush(stdout);
+
+        deadline += interval;
+        std::this_thread::sleep_until(deadline);
+    }
+    return 0;
+}
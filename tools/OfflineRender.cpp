@@ -0,0 +1,269 @@
+// Renders fixed note scripts through the engine without an audio device and prints a hash of
+// each result, so a change to the DSP can be checked for identical output. With --out the
+// renders are written as float WAVs; with --compare they are checked sample by sample against
+// earlier renders, within a tolerance for differences in the maths library or SIMD path.
+// --rate converts the written files to another sample rate; hashes and comparisons always use
+// the engine's own rate. --threads renders that many scripts at once, each on its own thread
+// with its own engine, so state shared between engines shows up as a mismatch. In builds with
+// SYNTH_TRACE, --trace writes the render's trace scopes as Chrome trace JSON.
+//
+//   offline_render [--out DIR] [--compare DIR] [--tolerance VALUE] [--rate HZ] [--threads N]
+//                  [--trace FILE]
+
+#include "AudioManager.h"
+#include "Resampler.h"
+#include "Simd.h"
+#include "Trace.h"
+#include "WavFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+using KeyCode = AudioManager::KeyCode;
+using NoteEvent = AudioManager::NoteEvent;
+
+struct Script
+{
+    const char* name;
+    double seconds;
+    void (*configure)(AudioManager& audio);
+    std::vector<NoteEvent> events; // In time order
+};
+
+std::vector<NoteEvent> Chord(std::initializer_list<KeyCode> keys, double on, double off)
+{
+    std::vector<NoteEvent> events;
+    for (KeyCode key : keys)
+        events.push_back(NoteEvent{on, key, true});
+    for (KeyCode key : keys)
+        events.push_back(NoteEvent{off, key, false});
+    return events;
+}
+
+std::vector<NoteEvent> Arpeggio(const char* keys, double step)
+{
+    std::vector<NoteEvent> events;
+    for (size_t i = 0; keys[i] != '\0'; i++)
+    {
+        events.push_back(NoteEvent{i * step, (KeyCode)keys[i], true});
+        events.push_back(NoteEvent{(i + 0.8) * step, (KeyCode)keys[i], false});
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const NoteEvent& a, const NoteEvent& b) { return a.time < b.time; });
+    return events;
+}
+
+std::vector<Script> MakeScripts()
+{
+    std::vector<Script> scripts;
+    scripts.push_back(Script{"sine_chord", 2.0, [](AudioManager&) {},
+                             Chord({'Z', 'C', 'B'}, 0.0, 1.5)});
+    scripts.push_back(Script{"square_filter_drive", 2.0,
+                             [](AudioManager& audio) {
+                                 audio.SetWaveType(AudioManager::WaveType::Square);
+                                 audio.SetFilter(AudioManager::FilterMode::Lowpass, 1200.0f,
+                                                 0.5f);
+                                 audio.SetDrive(0.5f);
+                                 audio.SetOversampling(4);
+                                 audio.SetStereoSpread(0.5f);
+                             },
+                             Arpeggio("QWERTYUIOP", 0.125)});
+    scripts.push_back(Script{"effects_graph", 4.0,
+                             [](AudioManager& audio) {
+                                 EffectsSettings effects;
+                                 effects.delayEnabled = true;
+                                 effects.reverbEnabled = true;
+                                 audio.SetEffects(effects);
+                                 audio.SetMasterGraph(MakeEnvelopeFilterGraph());
+                             },
+                             Arpeggio("ZXCVBNM", 0.25)});
+    scripts.push_back(Script{"fm_bell_release", 4.0,
+                             [](AudioManager& audio) {
+                                 audio.SetWaveType(AudioManager::WaveType::Fm);
+                                 audio.SetFmPatch(MakeFmPreset(1));
+                                 audio.SetOversampling(2);
+                             },
+                             Arpeggio("ZCBMQETU", 0.2)});
+    scripts.push_back(Script{"additive_saw_chord", 3.0,
+                             [](AudioManager& audio) {
+                                 audio.SetWaveType(AudioManager::WaveType::Additive);
+                                 audio.SetAdditivePatch(MakeAdditivePreset(0));
+                             },
+                             Chord({'Z', 'C', 'B', 'Q'}, 0.0, 2.0)});
+    scripts.push_back(Script{"spectral_pad_release", 4.0,
+                             [](AudioManager& audio) {
+                                 audio.SetWaveType(AudioManager::WaveType::Spectral);
+                                 audio.SetSpectralPatch(MakeSpectralPreset(1));
+                             },
+                             Chord({'Z', 'B', 'E'}, 0.0, 2.0)});
+    return scripts;
+}
+
+// FNV-1a over the raw float bits, channel by channel
+uint64_t HashRender(const WavData& data)
+{
+    uint64_t hash = 1469598103934665603ull;
+    for (const std::vector<float>& channel : data.channels)
+    {
+        const unsigned char* bytes = (const unsigned char*)channel.data();
+        for (size_t i = 0; i < channel.size() * sizeof(float); i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+// Largest absolute sample difference, or infinity if the shapes differ
+double MaxError(const WavData& a, const WavData& b)
+{
+    if (a.sampleRate != b.sampleRate || a.channels.size() != b.channels.size() ||
+        a.GetFrameCount() != b.GetFrameCount())
+        return INFINITY;
+    double error = 0.0;
+    for (size_t c = 0; c < a.channels.size(); c++)
+        for (size_t n = 0; n < a.GetFrameCount(); n++)
+            error = std::max(error, (double)fabsf(a.channels[c][n] - b.channels[c][n]));
+    return error;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+#if SYNTH_HAS_AVX && (defined(__GNUC__) || defined(__clang__))
+    // Rather than die on an illegal instruction; CTest counts this exit code as skipped
+    if (!__builtin_cpu_supports("avx"))
+    {
+        fprintf(stderr, "this build needs a CPU with AVX\n");
+        return 77;
+    }
+#endif
+    std::filesystem::path outDir;
+    std::filesystem::path compareDir;
+    double tolerance = 1e-4;
+    unsigned int fileRate = 0;
+    unsigned int threadCount = 1;
+    std::filesystem::path tracePath;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--out") == 0 && i + 1 < argc)
+            outDir = argv[++i];
+        else if (strcmp(argv[i], "--compare") == 0 && i + 1 < argc)
+            compareDir = argv[++i];
+        else if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else if (strcmp(argv[i], "--rate") == 0 && i + 1 < argc)
+            fileRate = (unsigned int)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            threadCount = (unsigned int)atoi(argv[++i]);
+        else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else
+        {
+            fprintf(stderr,
+                    "usage: %s [--out DIR] [--compare DIR] [--tolerance VALUE] [--rate HZ] "
+                    "[--threads N] [--trace FILE]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (threadCount == 0)
+    {
+        fprintf(stderr, "--threads needs at least 1\n");
+        return 2;
+    }
+#if !SYNTH_TRACE
+    if (!tracePath.empty())
+    {
+        fprintf(stderr, "--trace needs a build configured with SYNTH_TRACE\n");
+        return 2;
+    }
+#endif
+
+    // Each worker takes the next script not yet started until none are left
+    const std::vector<Script> scripts = MakeScripts();
+    std::vector<WavData> renders(scripts.size());
+    std::atomic<size_t> nextScript{0};
+    auto renderScripts = [&]() {
+        for (size_t i = nextScript++; i < scripts.size(); i = nextScript++)
+        {
+            AudioManager audio;
+            if (audio.InitializeOffline())
+            {
+                scripts[i].configure(audio);
+                audio.RenderOffline(scripts[i].events, scripts[i].seconds, renders[i]);
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (unsigned int t = 1; t < std::min<size_t>(threadCount, scripts.size()); t++)
+        workers.emplace_back(renderScripts);
+    renderScripts();
+    for (std::thread& worker : workers)
+        worker.join();
+
+    bool failed = false;
+    for (size_t i = 0; i < scripts.size(); i++)
+    {
+        const Script& script = scripts[i];
+        const WavData& render = renders[i];
+        if (render.channels.empty())
+        {
+            fprintf(stderr, "%s: could not prepare the engine\n", script.name);
+            return 2;
+        }
+        printf("%-22s %016llx", script.name, (unsigned long long)HashRender(render));
+
+        std::string fileName = std::string(script.name) + ".wav";
+        WavData file = render;
+        if (fileRate != 0 && fileRate != render.sampleRate)
+        {
+            for (std::vector<float>& channel : file.channels)
+                channel = ResampleSignal(channel, render.sampleRate, fileRate);
+            file.sampleRate = fileRate;
+        }
+        if (!outDir.empty() && !SaveWav(outDir / fileName, file))
+        {
+            printf("  could not write %s", (outDir / fileName).string().c_str());
+            failed = true;
+        }
+        if (!compareDir.empty())
+        {
+            WavData reference;
+            if (!LoadWav(compareDir / fileName, reference))
+            {
+                printf("  no reference");
+                failed = true;
+            }
+            else
+            {
+                double error = MaxError(render, reference);
+                bool match = error <= tolerance;
+                printf("  max error %.3g %s", error, match ? "ok" : "MISMATCH");
+                failed |= !match;
+            }
+        }
+        printf("\n");
+    }
+#if SYNTH_TRACE
+    std::string traceError;
+    if (!tracePath.empty() && !TraceBuffer::WriteChromeJson(tracePath, &traceError))
+    {
+        fprintf(stderr, "%s\n", traceError.c_str());
+        failed = true;
+    }
+#endif
+    return failed ? 1 : 0;
+}
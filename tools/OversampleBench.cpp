@@ -0,0 +1,108 @@
+// Times the oversampled render mode at 1x, 2x, 4x and 8x, per 512-frame output block. The
+// half-band decimator chain is timed on its own over stereo noise; the engine is then rendered
+// offline holding an eight-note square chord through the saturator, and the voice render and
+// the whole block are reported from its render stats and the wall clock.
+//
+//   oversample_bench [seconds]   (default 5, of audio per measurement)
+
+#include "AudioManager.h"
+#include "Oversampler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace
+{
+constexpr unsigned int BLOCK_SAMPLES = 512;
+constexpr unsigned int CHANNELS = 2;
+constexpr unsigned int FACTORS[] = {1, 2, 4, 8};
+constexpr const char* CHORD_KEYS = "ZXCVQWER";
+
+// Mean wall time in microseconds to decimate one output block of every channel
+double TimeDecimators(unsigned int factor, size_t blocks)
+{
+    std::vector<Oversampler> oversamplers(CHANNELS);
+    std::vector<float> input((size_t)BLOCK_SAMPLES * factor);
+    std::vector<float> output(BLOCK_SAMPLES);
+    uint32_t state = 1;
+    for (float& s : input)
+    {
+        state = state * 1664525u + 1013904223u;
+        s = (float)(state >> 8) / (float)(1u << 24) - 0.5f;
+    }
+    for (Oversampler& oversampler : oversamplers)
+    {
+        oversampler.Prepare(BLOCK_SAMPLES);
+        oversampler.SetFactor(factor);
+    }
+
+    float sum = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < blocks; b++)
+    {
+        for (Oversampler& oversampler : oversamplers)
+        {
+            oversampler.Decimate(input.data(), BLOCK_SAMPLES, output.data());
+            // Reading the output keeps the decimation from being optimised away
+            sum += output[b % BLOCK_SAMPLES];
+        }
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    if (sum != sum)
+        printf("(decimator output is NaN)\n");
+    return elapsed.count() / blocks;
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 5.0;
+    if (seconds <= 0.0)
+    {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 2;
+    }
+
+    AudioManager audio;
+    if (!audio.InitializeOffline(BLOCK_SAMPLES))
+    {
+        fprintf(stderr, "engine failed to initialise\n");
+        return 1;
+    }
+    audio.SetWaveType(AudioManager::WaveType::Square);
+    audio.SetDrive(0.5f);
+    std::vector<AudioManager::NoteEvent> script;
+    for (const char* key = CHORD_KEYS; *key != '\0'; key++)
+        script.push_back(AudioManager::NoteEvent{0.0, (AudioManager::KeyCode)*key, true});
+
+    // The engine's rate is only reported with its output
+    WavData out;
+    audio.RenderOffline(script, 0.1, out);
+    const double blockUs = 1e6 * BLOCK_SAMPLES / out.sampleRate;
+    const size_t blocks = (size_t)(seconds * out.sampleRate / BLOCK_SAMPLES);
+    printf("%u-frame blocks at %u Hz, %zu voices, %.1f s per measurement\n", BLOCK_SAMPLES,
+           out.sampleRate, script.size(), seconds);
+    printf("%7s %12s %12s %12s %10s\n", "factor", "decimate us", "voices us", "block us",
+           "budget %");
+    for (unsigned int factor : FACTORS)
+    {
+        double decimateUs = TimeDecimators(factor, blocks);
+
+        audio.SetOversampling(factor);
+        // The first render settles the parameter smoothing and warms the caches
+        audio.RenderOffline(script, 0.5, out);
+        auto start = std::chrono::steady_clock::now();
+        audio.RenderOffline(script, seconds, out);
+        std::chrono::duration<double, std::micro> elapsed =
+            std::chrono::steady_clock::now() - start;
+        double renderBlocks = (double)out.channels[0].size() / BLOCK_SAMPLES;
+        double blockTimeUs = elapsed.count() / renderBlocks;
+        double voicesUs = 1000.0 * audio.GetRenderStats().GetAverageMs(RenderStage::Voices);
+        printf("%6ux %12.1f %12.1f %12.1f %10.1f\n", factor, decimateUs, voicesUs, blockTimeUs,
+               100.0 * blockTimeUs / blockUs);
+    }
+    return 0;
+}
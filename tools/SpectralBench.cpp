@@ -0,0 +1,122 @@
+// Finds where inverse-FFT synthesis overtakes oscillators: sixteen voices a semitone apart,
+// each holding the same number of partials spread evenly up the spectrum, are rendered by
+// AdditiveBank and by SpectralBank, and the cost of each is reported per voice-sample. Every
+// partial stays below the culling limits of both banks, so both render all of them.
+// AdditiveBank stops at ADDITIVE_MAX_PARTIALS; beyond that only SpectralBank is timed.
+//
+//   spectral_bench [seconds]   (default 3, of audio per measurement)
+
+#include "AdditiveBank.h"
+#include "SpectralBank.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+namespace
+{
+constexpr double SAMPLE_RATE = 44100.0;
+constexpr unsigned int BLOCK_FRAMES = 512;
+constexpr unsigned int VOICES = SpectralBank::MAX_VOICES;
+constexpr double LOWEST_NOTE = 55.0;
+constexpr double HIGHEST_PARTIAL_HZ = 19000.0; // For the highest note
+constexpr unsigned int PARTIAL_COUNTS[] = {8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+
+double NoteFrequency(unsigned int voice)
+{
+    return LOWEST_NOTE * pow(2.0, voice / 12.0);
+}
+
+// Evenly spaced from the note up, at equal levels summing to at most 1
+template <typename Patch> void FillPartials(Patch& patch, unsigned int count)
+{
+    const double topRatio = HIGHEST_PARTIAL_HZ / NoteFrequency(VOICES - 1);
+    patch.partialCount = count;
+    patch.attackMs = 5.0f;
+    patch.releaseMs = 300.0f;
+    for (unsigned int k = 0; k < count; k++)
+    {
+        patch.ratios[k] = (float)(1.0 + (topRatio - 1.0) * k / count);
+        patch.amplitudes[k] = 1.0f / count;
+    }
+}
+
+// Wall time to render `frames` of every voice; `partials` is the total rendered per voice
+template <typename Bank, typename Patch>
+double TimeBank(const Patch& patch, size_t frames, unsigned int& partials, float& peak)
+{
+    std::unique_ptr<Bank> bank = std::make_unique<Bank>();
+    for (unsigned int v = 0; v < VOICES; v++)
+        bank->NoteOn(v, NoteFrequency(v));
+    std::vector<float> buffer((size_t)BLOCK_FRAMES * VOICES);
+
+    peak = 0.0f;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t done = 0; done < frames; done += BLOCK_FRAMES)
+    {
+        bank->Render(patch, buffer.data(), BLOCK_FRAMES, SAMPLE_RATE, 1.0f);
+        // Reading the output keeps the render from being optimised away
+        for (unsigned int n = 0; n < BLOCK_FRAMES; n += 64)
+            peak = std::max(peak, fabsf(buffer[(size_t)n * VOICES]));
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    partials = 0;
+    for (unsigned int v = 0; v < VOICES; v++)
+        partials += bank->GetPartialCount(v);
+    partials /= VOICES;
+    return elapsed.count();
+}
+} // namespace
+
+int main(int argc, char** argv)
+{
+    double seconds = argc > 1 ? atof(argv[1]) : 3.0;
+    if (seconds <= 0.0)
+    {
+        fprintf(stderr, "usage: %s [seconds]\n", argv[0]);
+        return 2;
+    }
+    const size_t frames = (size_t)(seconds * SAMPLE_RATE);
+    const double voiceSamples = (double)frames * VOICES;
+    // The patches are too big to keep on the stack
+    std::unique_ptr<AdditivePatch> additive = std::make_unique<AdditivePatch>();
+    std::unique_ptr<SpectralPatch> spectral = std::make_unique<SpectralPatch>();
+
+    printf("%u voices from %.0f Hz, frame %u, hop %u, %.1f s per measurement\n", VOICES,
+           LOWEST_NOTE, SpectralBank::FRAME_SIZE, SpectralBank::HOP, seconds);
+    printf("%9s %14s %14s %8s\n", "partials", "additive ns", "spectral ns", "ratio");
+    unsigned int crossover = 0;
+    for (unsigned int count : PARTIAL_COUNTS)
+    {
+        unsigned int rendered = 0;
+        float peak;
+        FillPartials(*spectral, count);
+        double spectralSeconds = TimeBank<SpectralBank>(*spectral, frames, rendered, peak);
+        bool silent = peak <= 0.0f || rendered != count;
+        double spectralNs = spectralSeconds / voiceSamples * 1e9;
+        if (count > ADDITIVE_MAX_PARTIALS)
+        {
+            printf("%9u %14s %14.1f %8s%s\n", count, "-", spectralNs, "-",
+                   silent ? "  (missing partials!)" : "");
+            continue;
+        }
+
+        FillPartials(*additive, count);
+        double additiveSeconds = TimeBank<AdditiveBank>(*additive, frames, rendered, peak);
+        silent |= peak <= 0.0f || rendered != count;
+        double additiveNs = additiveSeconds / voiceSamples * 1e9;
+        if (crossover == 0 && spectralNs < additiveNs)
+            crossover = count;
+        printf("%9u %14.1f %14.1f %7.2fx%s\n", count, additiveNs, spectralNs,
+               additiveNs / spectralNs, silent ? "  (missing partials!)" : "");
+    }
+    if (crossover != 0)
+        printf("Spectral synthesis is faster from %u partials per voice\n", crossover);
+    else
+        printf("Spectral synthesis was not faster at any partial count tried\n");
+    return 0;
+}
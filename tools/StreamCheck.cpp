@@ -0,0 +1,226 @@
+// Plays long samples through the SampleStreamer the way the render thread does, one block per
+// device period, and checks every block against the same frames decoded straight from the
+// mapping. Prints the hit rate, prefetch lead and starvations. --disk-delay makes the prefetch
+// thread sleep before each chunk, so a slow disk can be tried on a fast one: it should show up
+// as starved blocks of silence, never as a late block.
+//
+//   stream_check [--dir DIR] [--voices N] [--seconds S] [--disk-delay MS]
+//
+// Without --dir it writes a looped and a one-shot test sample, each longer than the resident
+// head, to a temporary folder and plays those.
+
+#include "SampleStreamer.h"
+#include "Sampler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+constexpr double SAMPLE_RATE = 44100.0;
+constexpr unsigned int BLOCK_SAMPLES = 512;
+constexpr double FIXED_ONE = 4294967296.0;
+
+void WriteU32(std::ofstream& file, uint32_t value)
+{
+    file.write((const char*)&value, 4);
+}
+
+void WriteU16(std::ofstream& file, uint16_t value)
+{
+    file.write((const char*)&value, 2);
+}
+
+// 16-bit stereo noise, so a frame read from the wrong place can't match by accident. A loop
+// is written as a `smpl` chunk with C4 as the root.
+bool WriteTestWav(const std::filesystem::path& path, uint32_t frames, uint32_t loopStart,
+                  uint32_t loopEnd)
+{
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    const bool loop = loopEnd > loopStart;
+    const uint32_t dataBytes = frames * 4;
+    const uint32_t smplBytes = loop ? 36 + 24 : 0;
+    file.write("RIFF", 4);
+    WriteU32(file, 4 + 8 + 16 + 8 + dataBytes + (loop ? 8 + smplBytes : 0));
+    file.write("WAVEfmt ", 8);
+    WriteU32(file, 16);
+    WriteU16(file, 1); // PCM
+    WriteU16(file, 2);
+    WriteU32(file, (uint32_t)SAMPLE_RATE);
+    WriteU32(file, (uint32_t)SAMPLE_RATE * 4);
+    WriteU16(file, 4);
+    WriteU16(file, 16);
+    if (loop)
+    {
+        file.write("smpl", 4);
+        WriteU32(file, smplBytes);
+        const uint32_t header[9] = {0, 0, 0, 60, 0, 0, 0, 1, 0};
+        file.write((const char*)header, sizeof(header));
+        const uint32_t loopRecord[6] = {0, 0, loopStart, loopEnd - 1, 0, 0}; // Inclusive end
+        file.write((const char*)loopRecord, sizeof(loopRecord));
+    }
+    file.write("data", 4);
+    WriteU32(file, dataBytes);
+
+    std::vector<int16_t> samples((size_t)frames * 2);
+    uint32_t state = 0x12345678;
+    for (int16_t& sample : samples)
+    {
+        state = state * 1664525u + 1013904223u;
+        sample = (int16_t)(state >> 16);
+    }
+    file.write((const char*)samples.data(), (std::streamsize)(samples.size() * 2));
+    return (bool)file;
+}
+
+bool WriteTestSamples(const std::filesystem::path& directory)
+{
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    const uint32_t seconds = (uint32_t)SAMPLE_RATE;
+    return WriteTestWav(directory / "Stream_C4.wav", 20 * seconds, 3 * seconds, 17 * seconds) &&
+           WriteTestWav(directory / "Stream_C5.wav", 8 * seconds, 0, 0);
+}
+
+struct CheckVoice
+{
+    const SampleZone* zone = nullptr;
+    double step = 1.0;
+    uint64_t position = 0; // 32.32 source frames, as SamplerVoice
+};
+} // namespace
+
+int main(int argc, char** argv)
+{
+    std::filesystem::path directory;
+    unsigned int voices = 8;
+    double seconds = 10.0;
+    double diskDelayMs = 0.0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc)
+            directory = argv[++i];
+        else if (strcmp(argv[i], "--voices") == 0 && i + 1 < argc)
+            voices = (unsigned int)std::clamp(atoi(argv[++i]), 1, 64);
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+            seconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--disk-delay") == 0 && i + 1 < argc)
+            diskDelayMs = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr,
+                    "usage: %s [--dir DIR] [--voices N] [--seconds S] [--disk-delay MS]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+    if (directory.empty())
+    {
+        directory = std::filesystem::temp_directory_path() / "stream_check";
+        if (!WriteTestSamples(directory))
+        {
+            fprintf(stderr, "could not write test samples to %s\n", directory.string().c_str());
+            return 2;
+        }
+    }
+
+    SampleInstrument instrument;
+    std::string error;
+    if (!instrument.Load(directory, SAMPLE_RATE, voices, &error))
+    {
+        fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    SampleStreamer* streamer = instrument.GetStreamer();
+    if (!streamer)
+    {
+        fprintf(stderr, "no sample in %s is longer than the resident head of %zu frames\n",
+                directory.string().c_str(), SAMPLER_RESIDENT_FRAMES);
+        return 2;
+    }
+    streamer->SetDiskDelayMs(diskDelayMs);
+
+    // Spread the voices a minor third apart up from C3, so they use different zones and read
+    // at different rates
+    std::vector<CheckVoice> checkVoices(voices);
+    for (unsigned int v = 0; v < voices; v++)
+    {
+        double freq = 261.63 * pow(2.0, (v * 3 % 25) / 12.0 - 1.0);
+        CheckVoice& voice = checkVoices[v];
+        voice.zone = instrument.FindZone(freq);
+        voice.step = std::min(freq / voice.zone->rootFreq * voice.zone->wav.GetSampleRate() /
+                                  SAMPLE_RATE,
+                              SAMPLER_MAX_STEP);
+        if (voice.zone->streamed)
+            streamer->BeginVoice(v, voice.zone);
+    }
+
+    const size_t maxSpan = GetSamplerDecodeFrames(BLOCK_SAMPLES);
+    std::vector<float> streamed(maxSpan);
+    std::vector<float> reference(maxSpan);
+    const auto period = std::chrono::duration<double>(BLOCK_SAMPLES / SAMPLE_RATE);
+    const size_t blocks = (size_t)(seconds * SAMPLE_RATE / BLOCK_SAMPLES);
+    size_t mismatches = 0;
+    size_t retriggers = 0;
+    auto deadline = std::chrono::steady_clock::now();
+    for (size_t b = 0; b < blocks; b++)
+    {
+        for (unsigned int v = 0; v < voices; v++)
+        {
+            CheckVoice& voice = checkVoices[v];
+            if (!voice.zone->streamed)
+                continue;
+            // The range RenderSampler reads for this block
+            const uint64_t fixedStep = (uint64_t)(voice.step * FIXED_ONE);
+            const int64_t first = (int64_t)(voice.position >> 32) - 1;
+            const uint64_t start = (voice.position & 0xFFFFFFFFull) + (1ull << 32);
+            const size_t span = (size_t)((start + fixedStep * (BLOCK_SAMPLES - 1)) >> 32) + 3;
+
+            uint64_t starvedBefore = streamer->GetStarvations();
+            streamer->Read(v, first, span, streamed.data());
+            ReadSampleFrames(voice.zone->wav, first, span, reference.data());
+            if (streamer->GetStarvations() == starvedBefore &&
+                memcmp(streamed.data(), reference.data(), span * sizeof(float)) != 0)
+                mismatches++;
+
+            voice.position += fixedStep * BLOCK_SAMPLES;
+            uint64_t frame = voice.position >> 32;
+            if (!voice.zone->wav.HasLoop() && frame >= voice.zone->wav.GetFrameCount())
+            {
+                // Play a finished one-shot again, which restarts the slot
+                voice.position = 0;
+                streamer->BeginVoice(v, voice.zone);
+                retriggers++;
+            }
+            else
+            {
+                streamer->Release(v, (int64_t)frame - 1);
+            }
+        }
+
+        deadline += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+        std::this_thread::sleep_until(deadline);
+    }
+
+    printf("%u voices, %zu of %zu zones streamed, disk delay %.1f ms per %zu-frame chunk\n",
+           voices, instrument.GetStreamedZoneCount(), instrument.GetZoneCount(), diskDelayMs,
+           SampleStreamer::CHUNK_FRAMES);
+    printf("%llu reads, %llu starved, hit rate %.2f%%, %zu retriggers\n",
+           (unsigned long long)streamer->GetReads(),
+           (unsigned long long)streamer->GetStarvations(), streamer->GetHitRate() * 100.0,
+           retriggers);
+    printf("prefetch lead %.0f ms min, %.0f ms average\n", streamer->GetMinLeadMs(),
+           streamer->GetAverageLeadMs());
+    printf("%zu blocks differed from the file %s\n", mismatches, mismatches ? "FAIL" : "ok");
+    return mismatches ? 1 : 0;
+}